@@ -4,9 +4,44 @@
 #include "../world.h"
 #include "components.h"
 
+/**
+ * Where a swept box first hit something.
+ *
+ * @struct SweepHit
+ */
+typedef struct {
+	float time;				/**< The part of the move made before the hit, 1 if nothing was hit. */
+	int normalX;			/**< The contact normal across: -1 if the box ran into something on its right, 1 on its left. */
+	int normalY;			/**< The contact normal down: -1 if the box ran into something below it, 1 above it. */
+	unsigned int type;		/**< COLLISION_WALL, the collision type of the entity hit, or COLLISION_EMPTY. */
+	unsigned int entity;	/**< The entity hit, or MAX_ENTITIES. */
+} SweepHit;
+
+#define TRIGGER_ENTER	0	/**< The entity has just started overlapping the trigger. */
+#define TRIGGER_STAY	1	/**< The entity was overlapping the trigger last step as well. */
+#define TRIGGER_EXIT	2	/**< The entity has just stopped overlapping the trigger. */
+
+#define MAX_TRIGGERS	16	/**< The most triggers one entity can be overlapping at once. */
+
+/**
+ * A change in what an entity is overlapping, from batch_triggers.
+ *
+ * @struct TriggerEvent
+ */
+typedef struct {
+	unsigned int trigger;	/**< The trigger entity, or MAX_ENTITIES if it has been destroyed. */
+	unsigned int type;		/**< The trigger's collision type. */
+	int event;				/**< TRIGGER_ENTER, TRIGGER_STAY or TRIGGER_EXIT. */
+} TriggerEvent;
+
 void collision_system(World *world, unsigned int entity, PositionComponent* temp, unsigned int* entity_number, unsigned int* tile_number, unsigned int* hit_entity);
 void wall_collision(World *world, PositionComponent temp, unsigned int* tile_number);
 void entity_collision(World *world, unsigned int entity, PositionComponent temp, unsigned int* entity_number, unsigned int* hit_entity);
+void batch_collision(World *world, BodyBatch *batch, unsigned int entity, PositionComponent temp, unsigned int* entity_number, unsigned int* hit_entity);
+void sweep_collision(World *world, unsigned int entity, PositionComponent temp, float dx, float dy, BodyBatch *batch, SweepHit *hit);
+bool is_trigger(unsigned int type);
+unsigned int batch_triggers(World *world, BodyBatch *batch, unsigned int entity, PositionComponent temp, TriggerEvent *events);
+unsigned int entity_triggers(World *world, unsigned int entity, PositionComponent temp, TriggerEvent *events);
 
 void rebuild_floor(World * world, int targl);
 int check_tag_collision(World* world, unsigned int currentEntityID);
@@ -15,8 +15,6 @@
 #include <stdio.h>
 #include <math.h>
 
-#define COLLISION_MASK (COMPONENT_COLLISION) /**< Indicates that an entity can collide with other entities. */
-#define LEVEL_MASK (COMPONENT_LEVEL) /**< Indicates that an entity has levels (floors). */
 
 #define DIRECTION_RIGHT	1
 #define DIRECTION_LEFT	2
@@ -24,7 +22,7 @@
 #define DIRECTION_DOWN	4
 #define TAG_DISTANCE	5
 
-extern int send_router_fd[];
+extern PacketRing *send_router_ring;
 
 bool spacebar_collision(World* world, unsigned int entity, unsigned int** collision_list, unsigned int* num_collisions);
 void cleanup_spacebar_collision(unsigned int** collision_list);
@@ -58,70 +56,36 @@ void collision_system(World* world, unsigned int entity, PositionComponent* temp
  * @author   Clark Allenby
  */
 void wall_collision(World* world, PositionComponent temp, unsigned int* tile_number) {
-	int i = 0;
-	int level = -1;
+	LevelComponent *level = find_level(world, temp.level);
 	int xl, xr, yt, yb;
-	int xdts, ydts;
-	
-	for (i = 0; i < MAX_ENTITIES; i++) {
-		if (((world->mask[i] & LEVEL_MASK) != 0) && world->level[i].levelID == temp.level) {
-			level = i;
-			break;
-		}
-	}
 
-	if (level == -1) {
+	if (level == NULL) {
 		*tile_number = COLLISION_UNKNOWN;
 		return;
 	}
 	
-	xl = (temp.x - temp.width / 2) / world->level[level].tileSize;
-	xr = (temp.x + temp.width / 2) / world->level[level].tileSize;
-	yt = (temp.y - temp.height / 2) / world->level[level].tileSize;
-	yb = (temp.y + temp.height / 2) / world->level[level].tileSize;
-	
-	xdts = ceil((float)temp.width / (float)world->level[level].tileSize);
-	ydts = ceil((float)temp.height / (float)world->level[level].tileSize);
+	xl = (temp.x - temp.width / 2) / level->tileSize;
+	xr = (temp.x + temp.width / 2) / level->tileSize;
+	yt = (temp.y - temp.height / 2) / level->tileSize;
+	yb = (temp.y + temp.height / 2) / level->tileSize;
 	
-	if (yt < world->level[level].height && yt > 0 && yb < world->level[level].height && yb > 0) {
-		for (int i = 0; i < xdts; i++) {
-			if (xl + i * world->level[level].tileSize < world->level[level].width &&
-				xl + i * world->level[level].tileSize >= 0) {
-				if (world->level[level].map[xl + i * world->level[level].tileSize][yt] == L_WALL) {
-					*tile_number = COLLISION_WALL;
-					return;
-				}
-			}
-			if (xr - i * world->level[level].tileSize < world->level[level].width &&
-				xr - i * world->level[level].tileSize >= 0) {
-				if (world->level[level].map[xr - i * world->level[level].tileSize][yb] == L_WALL) {
-					*tile_number = COLLISION_WALL;
-					return;
-				}
-			}
+	//top and bottom edges, a word of the wall bitmap at a time
+	if (yt < level->height && yt > 0 && yb < level->height && yb > 0) {
+		if (level_wall_row(level, yt, xl, xr) || level_wall_row(level, yb, xl, xr)) {
+			*tile_number = COLLISION_WALL;
+			return;
 		}
 	}
-	if (xl < world->level[level].width && xl > 0 && xr < world->level[level].width && xr > 0) {
-		for (int i = 0; i < ydts; i++) {
-			if (yt + i * world->level[level].tileSize < world->level[level].height &&
-				yt + i * world->level[level].tileSize >= 0) {
-				if (world->level[level].map[xr][yt + i * world->level[level].tileSize] == L_WALL) {
-					*tile_number = COLLISION_WALL;
-					return;
-				}
-			}
-			if (yb - i * world->level[level].tileSize < world->level[level].height &&
-				yb - i * world->level[level].tileSize >= 0) {
-				if (world->level[level].map[xl][yb - i * world->level[level].tileSize] == L_WALL) {
-					*tile_number = COLLISION_WALL;
-					return;
-				}
-			}
+	//left and right edges
+	if (xl < level->width && xl > 0 && xr < level->width && xr > 0) {
+		if (level_wall_column(level, xl, yt, yb) || level_wall_column(level, xr, yt, yb)) {
+			*tile_number = COLLISION_WALL;
+			return;
 		}
 	}
 	
 	
-	// debug statement: printf("xl: %i, xr: %i, yt: %i, yb: %i, xdts: %i, ydts: %i\n", xl, xr, yt, yb, xdts, ydts);
+	// debug statement: printf("xl: %i, xr: %i, yt: %i, yb: %i\n", xl, xr, yt, yb);
 	*tile_number = COLLISION_EMPTY;
 }
 
@@ -138,18 +102,62 @@ void wall_collision(World* world, PositionComponent temp, unsigned int* tile_num
  * @author   Joshua campbell & Clark Allenby
  */
 void entity_collision(World* world, unsigned int entity, PositionComponent temp, unsigned int* entity_number, unsigned int* hit_entity) {
-	unsigned int i = 0;
+	BodyBatch *batch = gather_colliders(world, temp.x - temp.width / 2, temp.y - temp.height / 2,
+		temp.x + temp.width / 2, temp.y + temp.height / 2, temp.level);
+	
+	batch_collision(world, batch, entity, temp, entity_number, hit_entity);
+}
+
+/**
+ * Checks for a collision between an entity and colliders that have already been
+ * gathered, so a caller that needs several tests in one place only queries once.
+ *
+ * @param[in,out] world      A pointer to the world structure.
+ * @param[in,out] batch      The colliders from gather_colliders. Must cover temp; NULL
+ *                           if they couldn't be gathered, to test them one at a time.
+ * @param[in]     entity     The entity being checked for collisions with. 
+ * @param[in]     temp       The temporary position to be applied later.
+ * @param[out] entity_number The collision type of the entity that was hit (if any).
+ * @param[out] hit_entity    The identifier of the entity that was hit (if any).
+ *
+ * @designer
+ * @author
+ */
+void batch_collision(World *world, BodyBatch *batch, unsigned int entity, PositionComponent temp, unsigned int* entity_number, unsigned int* hit_entity) {
+	OverlapBox box;
+	unsigned long long bits;
+	unsigned int word, n;
+	int type;
+	
+	//a pixel of slack on each side, bar the bottom edge
+	box.left = temp.x - temp.width / 2 + 2;
+	box.top = temp.y - temp.height / 2;
+	box.right = temp.x + temp.width / 2 - 2;
+	box.bottom = temp.y + temp.height / 2 - 2;
+	box.reading = BOX_CENTRE;
 	
-	for (i = 0; i < MAX_ENTITIES; i++) {
-		if (i != entity && IN_THIS_COMPONENT(world->mask[i], COLLISION_MASK)) {
-			if (temp.x + temp.width / 2 - 1 > world->position[i].x - world->position[i].width / 2 + 1 &&
-				temp.x - temp.width / 2 + 1 < world->position[i].x + world->position[i].width / 2 - 1 &&
-				temp.y + temp.height / 2 - 1 > world->position[i].y - world->position[i].height / 2 + 1 &&
-				temp.y - temp.height / 2 + 1 < world->position[i].y + world->position[i].height / 2 + 1
-				&& world->collision[i].active) {
-				*entity_number = world->collision[i].type;
-				*hit_entity = i;
-				return;
+	//the colliders couldn't be gathered, so they are tested one at a time
+	if (batch == NULL) {
+		n = scan_colliders(world, &box, temp.level, 0, &type);
+		if (n == entity) {
+			n = scan_colliders(world, &box, temp.level, entity + 1, &type);
+		}
+		if (n < MAX_ENTITIES) {
+			*entity_number = type;
+			*hit_entity = n;
+			return;
+		}
+	}
+	//the batch is in entity order, so the first hit is the lowest entity
+	else if (overlap_batch(batch, &box) > 0) {
+		for (word = 0; word < (batch->count + 63) / 64; word++) {
+			for (bits = batch->hits[word]; bits != 0; bits &= bits - 1) {
+				n = word * 64 + __builtin_ctzll(bits);
+				if (batch->entity[n] != entity) {
+					*entity_number = batch->type[n];
+					*hit_entity = batch->entity[n];
+					return;
+				}
 			}
 		}
 	}
@@ -158,6 +166,444 @@ void entity_collision(World* world, unsigned int entity, PositionComponent temp,
 	*hit_entity = MAX_ENTITIES;
 }
 
+/**
+ * One entity overlapping one trigger, kept from step to step so only the changes are
+ * reported.
+ *
+ * @struct TriggerPair
+ */
+typedef struct {
+	EntityHandle	entity;		/**< The entity overlapping the trigger. */
+	EntityHandle	trigger;	/**< The trigger. */
+	unsigned int	type;		/**< The trigger's collision type, kept for its exit once it is gone. */
+	int				level;		/**< The floor the entity was on. */
+} TriggerPair;
+
+static TriggerPair *trigger_pairs = NULL;	/**< Every overlap seen last step. */
+static unsigned int num_trigger_pairs = 0;	/**< The number of overlaps in trigger_pairs. */
+static unsigned int max_trigger_pairs = 0;	/**< The room in trigger_pairs. */
+
+/**
+ * Checks whether entities of a collision type are walked through and set something off,
+ * rather than blocking or being ignored.
+ *
+ * @param[in] type The collision type.
+ *
+ * @return true for stairs, belts and powerups.
+ *
+ * @designer
+ * @author
+ */
+bool is_trigger(unsigned int type) {
+	switch (type) {
+		case COLLISION_STAIR:
+		case COLLISION_BELTLEFT:
+		case COLLISION_BELTRIGHT:
+		case COLLISION_BELTLEFT_TILE:
+		case COLLISION_BELTRIGHT_TILE:
+		case COLLISION_PU_SPEEDUP:
+		case COLLISION_PU_SPEEDDOWN:
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Finds the triggers an entity overlaps and compares them with the ones it overlapped
+ * last step, so a trigger sets off its effect once on the way in and once on the way
+ * out instead of every step.
+ *
+ * Overlaps are tested with the same slack as batch_collision. A trigger that was
+ * destroyed while the entity stood on it still gets its exit, with the trigger set
+ * to MAX_ENTITIES. Overlaps of entities that no longer exist, no longer collide or
+ * have moved to another floor are dropped, as those entities aren't checked here.
+ * Only the first MAX_TRIGGERS triggers the entity overlaps are counted.
+ *
+ * @param[in,out] world  A pointer to the world structure.
+ * @param[in,out] batch  The colliders from gather_colliders. Must cover temp; NULL if
+ *                       they couldn't be gathered, to test them one at a time.
+ * @param[in]     entity The entity being checked.
+ * @param[in]     temp   The entity's position this step.
+ * @param[out]    events Receives the exits and stays, then the enters. Must have room
+ *                       for MAX_TRIGGERS * 2.
+ *
+ * @return The number of events.
+ *
+ * @designer
+ * @author
+ */
+unsigned int batch_triggers(World *world, BodyBatch *batch, unsigned int entity, PositionComponent temp, TriggerEvent *events) {
+	EntityHandle self = entity_handle(world, entity);
+	unsigned int hits[MAX_TRIGGERS];
+	unsigned int types[MAX_TRIGGERS];
+	unsigned int num_hits = 0, num_events = 0, num_missed = 0;
+	unsigned int trigger, owner, p, h, word, n;
+	int type;
+	static bool warned = false;
+	unsigned long long bits;
+	TriggerPair *pair;
+	OverlapBox box;
+	
+	box.left = temp.x - temp.width / 2 + 2;
+	box.top = temp.y - temp.height / 2;
+	box.right = temp.x + temp.width / 2 - 2;
+	box.bottom = temp.y + temp.height / 2 - 2;
+	box.reading = BOX_CENTRE;
+	
+	if (batch == NULL) {
+		for (n = scan_colliders(world, &box, temp.level, 0, &type); n < MAX_ENTITIES; n = scan_colliders(world, &box, temp.level, n + 1, &type)) {
+			if (n == entity || !is_trigger(type)) {
+				continue;
+			}
+			if (num_hits == MAX_TRIGGERS) {
+				num_missed++;
+				continue;
+			}
+			hits[num_hits] = n;
+			types[num_hits] = type;
+			num_hits++;
+		}
+	}
+	else if (overlap_batch(batch, &box) > 0) {
+		for (word = 0; word < (batch->count + 63) / 64; word++) {
+			for (bits = batch->hits[word]; bits != 0; bits &= bits - 1) {
+				n = word * 64 + __builtin_ctzll(bits);
+				if (batch->entity[n] == entity || !is_trigger(batch->type[n])) {
+					continue;
+				}
+				if (num_hits == MAX_TRIGGERS) {
+					num_missed++;
+					continue;
+				}
+				hits[num_hits] = batch->entity[n];
+				types[num_hits] = batch->type[n];
+				num_hits++;
+			}
+		}
+	}
+	if (num_missed > 0 && !warned) {
+		printf("batch_triggers: entity %u overlaps %u triggers, only the first %d are counted\n", entity, MAX_TRIGGERS + num_missed, MAX_TRIGGERS);
+		warned = true;
+	}
+	
+	//match last step's overlaps against this step's; whatever is left over is new
+	for (p = 0; p < num_trigger_pairs; ) {
+		pair = &trigger_pairs[p];
+		
+		owner = entity_from_handle(world, pair->entity);
+		if (owner == MAX_ENTITIES || (pair->entity != self &&
+			(!IN_THIS_COMPONENT(world->mask[owner], COMPONENT_COLLISION) || world->position[owner].level != pair->level))) {
+			*pair = trigger_pairs[--num_trigger_pairs];
+			continue;
+		}
+		if (pair->entity != self) {
+			p++;
+			continue;
+		}
+		
+		trigger = entity_from_handle(world, pair->trigger);
+		for (h = 0; h < num_hits && hits[h] != trigger; h++);
+		
+		events[num_events].trigger = trigger;
+		events[num_events].type = pair->type;
+		
+		if (h < num_hits) {
+			events[num_events++].event = TRIGGER_STAY;
+			num_hits--;
+			hits[h] = hits[num_hits];
+			types[h] = types[num_hits];
+			p++;
+		}
+		else {
+			events[num_events++].event = TRIGGER_EXIT;
+			*pair = trigger_pairs[--num_trigger_pairs];
+		}
+	}
+	
+	for (h = 0; h < num_hits; h++) {
+		if (num_trigger_pairs == max_trigger_pairs) {
+			pair = (TriggerPair*)realloc(trigger_pairs, sizeof(TriggerPair) * (max_trigger_pairs + 64));
+			if (pair == NULL) {
+				perror("batch_triggers: realloc");
+				break; //the rest are tried again next step
+			}
+			trigger_pairs = pair;
+			max_trigger_pairs += 64;
+		}
+		
+		pair = &trigger_pairs[num_trigger_pairs++];
+		pair->entity = self;
+		pair->trigger = entity_handle(world, hits[h]);
+		pair->type = types[h];
+		pair->level = temp.level;
+		
+		events[num_events].trigger = hits[h];
+		events[num_events].type = types[h];
+		events[num_events++].event = TRIGGER_ENTER;
+	}
+	
+	return num_events;
+}
+
+/**
+ * Finds the changes in the triggers an entity overlaps, for an entity whose colliders
+ * haven't been gathered.
+ *
+ * @param[in,out] world  A pointer to the world structure.
+ * @param[in]     entity The entity being checked.
+ * @param[in]     temp   The entity's position this step.
+ * @param[out]    events As for batch_triggers.
+ *
+ * @return The number of events.
+ *
+ * @designer
+ * @author
+ */
+unsigned int entity_triggers(World *world, unsigned int entity, PositionComponent temp, TriggerEvent *events) {
+	BodyBatch *batch = gather_colliders(world, temp.x - temp.width / 2, temp.y - temp.height / 2,
+		temp.x + temp.width / 2, temp.y + temp.height / 2, temp.level);
+	
+	return batch_triggers(world, batch, entity, temp, events);
+}
+
+/**
+ * Finds when a box moving in a straight line first runs into another box. Boxes that
+ * only touch don't overlap, so a box resting against another can slide along it.
+ *
+ * @param[in]  box     The moving box at the start of the move.
+ * @param[in]  dx      The move across.
+ * @param[in]  dy      The move down.
+ * @param[in]  left    The other box's left edge.
+ * @param[in]  top     The other box's top edge.
+ * @param[in]  right   The other box's right edge.
+ * @param[in]  bottom  The other box's bottom edge.
+ * @param[out] time    The part of the move made before they meet.
+ * @param[out] normalX The contact normal, as in SweepHit.
+ * @param[out] normalY
+ *
+ * @return true if they meet during the move. Boxes that overlap to begin with meet
+ *         straight away (time 0, pushed out along the axis they overlap least on),
+ *         unless the move takes the box back out along that axis, so an entity stuck
+ *         in another can walk out of it but not further in.
+ *
+ * @designer
+ * @author
+ */
+static bool sweep_box(const OverlapBox *box, float dx, float dy, float left, float top, float right, float bottom, float *time, int *normalX, int *normalY) {
+	float entryX, exitX, entryY, exitY, entry, exit;
+	float depthX, depthY;
+	int outX, outY;
+	
+	if (box->right > left && box->left < right && box->bottom > top && box->top < bottom) {
+		//the way out is towards whichever side of the other box is nearer
+		outX = box->left + box->right < left + right ? -1 : 1;
+		outY = box->top + box->bottom < top + bottom ? -1 : 1;
+		depthX = outX < 0 ? box->right - left : right - box->left;
+		depthY = outY < 0 ? box->bottom - top : bottom - box->top;
+		
+		if (depthX <= depthY) {
+			if (dx * outX > 0) {
+				return false;
+			}
+			*normalX = outX;
+			*normalY = 0;
+		}
+		else {
+			if (dy * outY > 0) {
+				return false;
+			}
+			*normalX = 0;
+			*normalY = outY;
+		}
+		*time = 0;
+		return true;
+	}
+	
+	if (dx > 0) {
+		entryX = (left - box->right) / dx;
+		exitX = (right - box->left) / dx;
+	}
+	else if (dx < 0) {
+		entryX = (right - box->left) / dx;
+		exitX = (left - box->right) / dx;
+	}
+	else if (box->right <= left || box->left >= right) {
+		return false;
+	}
+	else {
+		entryX = -INFINITY;
+		exitX = INFINITY;
+	}
+	
+	if (dy > 0) {
+		entryY = (top - box->bottom) / dy;
+		exitY = (bottom - box->top) / dy;
+	}
+	else if (dy < 0) {
+		entryY = (bottom - box->top) / dy;
+		exitY = (top - box->bottom) / dy;
+	}
+	else if (box->bottom <= top || box->top >= bottom) {
+		return false;
+	}
+	else {
+		entryY = -INFINITY;
+		exitY = INFINITY;
+	}
+	
+	entry = entryX > entryY ? entryX : entryY;
+	exit = exitX < exitY ? exitX : exitY;
+	
+	if (entry >= exit || entry < 0 || entry >= 1) {
+		return false;
+	}
+	
+	*time = entry;
+	if (entryX > entryY) {
+		*normalX = dx > 0 ? -1 : 1;
+		*normalY = 0;
+	}
+	else {
+		*normalX = 0;
+		*normalY = dy > 0 ? -1 : 1;
+	}
+	return true;
+}
+
+/**
+ * Sweeps a box against one collider, keeping the hit if the collider is solid and is
+ * met sooner than anything found so far.
+ *
+ * @param[in]     box    The moving box at the start of the move, with the slack taken off.
+ * @param[in]     dx     The move across.
+ * @param[in]     dy     The move down.
+ * @param[in]     other  The collider.
+ * @param[in]     type   Its collision type.
+ * @param[in]     x      Its centre.
+ * @param[in]     y
+ * @param[in]     width  Its size.
+ * @param[in]     height
+ * @param[in,out] hit    The first hit so far.
+ *
+ * @designer
+ * @author
+ */
+static void sweep_solid(const OverlapBox *box, float dx, float dy, unsigned int other, int type, float x, float y, int width, int height, SweepHit *hit) {
+	float time;
+	int normalX, normalY;
+	
+	if (type != COLLISION_SOLID && type != COLLISION_HACKER && type != COLLISION_GUARD && type != COLLISION_TARGET) {
+		return;
+	}
+	
+	if (sweep_box(box, dx, dy, x - width / 2, y - height / 2, x + width / 2, y + height / 2, &time, &normalX, &normalY) &&
+		time < hit->time) {
+		hit->time = time;
+		hit->normalX = normalX;
+		hit->normalY = normalY;
+		hit->type = type;
+		hit->entity = other;
+	}
+}
+
+/**
+ * Sweeps an entity's box along a move and finds the first wall or solid entity it
+ * runs into. Walls are the map's wall tiles; the solid entities are the ones movement
+ * stops at (solid objects, players and objectives).
+ *
+ * @param[in,out] world  A pointer to the world structure.
+ * @param[in]     entity The entity that is moving.
+ * @param[in]     temp   Its position at the start of the move.
+ * @param[in]     dx     The move across.
+ * @param[in]     dy     The move down.
+ * @param[in,out] batch  The colliders from gather_colliders. Must cover the whole move;
+ *                       NULL if they couldn't be gathered, to test them one at a time.
+ * @param[out]    hit    Where the move first hit something.
+ *
+ * @designer
+ * @author
+ */
+void sweep_collision(World* world, unsigned int entity, PositionComponent temp, float dx, float dy, BodyBatch *batch, SweepHit *hit) {
+	LevelComponent *level = find_level(world, temp.level);
+	OverlapBox box, swept;
+	float time;
+	int normalX, normalY;
+	int x0, x1, y0, y1, tx, ty, type;
+	unsigned int n;
+	
+	hit->time = 1;
+	hit->normalX = 0;
+	hit->normalY = 0;
+	hit->type = COLLISION_EMPTY;
+	hit->entity = MAX_ENTITIES;
+	
+	//the wall tiles anywhere along the move; walls are tested against the whole box
+	if (level != NULL) {
+		box.left = temp.x - temp.width / 2;
+		box.top = temp.y - temp.height / 2;
+		box.right = temp.x + temp.width / 2;
+		box.bottom = temp.y + temp.height / 2;
+		
+		x0 = (int)floorf((dx < 0 ? box.left + dx : box.left) / level->tileSize);
+		x1 = (int)floorf((dx > 0 ? box.right + dx : box.right) / level->tileSize);
+		y0 = (int)floorf((dy < 0 ? box.top + dy : box.top) / level->tileSize);
+		y1 = (int)floorf((dy > 0 ? box.bottom + dy : box.bottom) / level->tileSize);
+		if (x0 < 0)
+			x0 = 0;
+		if (y0 < 0)
+			y0 = 0;
+		if (x1 >= level->width)
+			x1 = level->width - 1;
+		if (y1 >= level->height)
+			y1 = level->height - 1;
+		
+		for (ty = y0; ty <= y1; ty++) {
+			if (!level_wall_row(level, ty, x0, x1)) {
+				continue;
+			}
+			for (tx = x0; tx <= x1; tx++) {
+				if (level_wall(level, tx, ty) &&
+					sweep_box(&box, dx, dy, tx * level->tileSize, ty * level->tileSize, (tx + 1) * level->tileSize, (ty + 1) * level->tileSize, &time, &normalX, &normalY) &&
+					time < hit->time) {
+					hit->time = time;
+					hit->normalX = normalX;
+					hit->normalY = normalY;
+					hit->type = COLLISION_WALL;
+					hit->entity = MAX_ENTITIES;
+				}
+			}
+		}
+	}
+	
+	//entities are tested with the same slack as entity_collision
+	box.left = temp.x - temp.width / 2 + 2;
+	box.top = temp.y - temp.height / 2;
+	box.right = temp.x + temp.width / 2 - 2;
+	box.bottom = temp.y + temp.height / 2 - 2;
+	
+	//the colliders couldn't be gathered, so everything the box passes over is tested one at a time
+	if (batch == NULL) {
+		swept.left = box.left + (dx < 0 ? dx : 0);
+		swept.top = box.top + (dy < 0 ? dy : 0);
+		swept.right = box.right + (dx > 0 ? dx : 0);
+		swept.bottom = box.bottom + (dy > 0 ? dy : 0);
+		swept.reading = BOX_CENTRE;
+		
+		for (n = scan_colliders(world, &swept, temp.level, 0, &type); n < MAX_ENTITIES; n = scan_colliders(world, &swept, temp.level, n + 1, &type)) {
+			if (n != entity) {
+				sweep_solid(&box, dx, dy, n, type, world->position[n].x, world->position[n].y, world->position[n].width, world->position[n].height, hit);
+			}
+		}
+		return;
+	}
+	
+	for (n = 0; n < batch->count; n++) {
+		if (batch->entity[n] != entity && batch->active[n]) {
+			sweep_solid(&box, dx, dy, batch->entity[n], batch->type[n], batch->x[n], batch->y[n], batch->width[n], batch->height[n], hit);
+		}
+	}
+}
+
 /**
  * Checks if a player is stuck in another player and moves the other player
  * out of the current player.
@@ -193,6 +639,7 @@ void anti_stuck_system(World *world, unsigned int curEntityID, int otherEntityID
 	} else if (downDist <= leftDist && downDist <= upDist && downDist <= rightDist && !(world->command[curEntityID].commands[C_UP])) {
 		world->position[otherEntityID].y = world->position[curEntityID].y - world->position[otherEntityID].height - 1;
 	}
+	update_body(world, otherEntityID);
 }
 
 /**
@@ -216,54 +663,37 @@ int check_tag_collision(World* world, unsigned int currentEntityID) {
 	entity.x = world->position[currentEntityID].x;
 	entity.y = world->position[currentEntityID].y;
 
-	for (unsigned int i = 0; i < MAX_ENTITIES; i++) {
-		if (i != currentEntityID && (world->mask[i] & COLLISION_MASK) != 0) {
-			switch(lastDirection) {
-				case DIRECTION_RIGHT:
-					if (entity.x + entity.width -1 + TAG_DISTANCE > world->position[i].x + 1 &&
-					entity.x  + 1 < world->position[i].x + world->position[i].width - 1 &&
-					entity.y + entity.height -1 > world->position[i].y + 1 &&
-					entity.y  + 1 < world->position[i].y + world->position[i].height - 1
-					&& world->collision[i].active && world->position[i].level == entity.level) {
-						return i;
-					}
-				break;
-				case DIRECTION_LEFT:
-					if (entity.x + entity.width -1 > world->position[i].x + 1 &&
-					entity.x  + 1 - TAG_DISTANCE < world->position[i].x + world->position[i].width - 1 &&
-					entity.y + entity.height -1 > world->position[i].y + 1 &&
-					entity.y  + 1< world->position[i].y + world->position[i].height - 1
-					&& world->collision[i].active && world->position[i].level == entity.level) {
-						return i;
-					}
-				break;
-				case DIRECTION_UP:
-					if (entity.x + entity.width -1 > world->position[i].x + 1 &&
-					entity.x  + 1 < world->position[i].x + world->position[i].width - 1 &&
-					entity.y + entity.height -1 + TAG_DISTANCE > world->position[i].y + 1 &&
-					entity.y  + 1 < world->position[i].y + world->position[i].height - 1
-					&& world->collision[i].active && world->position[i].level == entity.level) {
-						return i;
-					}
-				break;
-				case DIRECTION_DOWN:
-					if (entity.x + entity.width -1 > world->position[i].x + 1 &&
-					entity.x  + 1 < world->position[i].x + world->position[i].width - 1 &&
-					entity.y + entity.height -1 > world->position[i].y + 1 &&
-					entity.y  + 1 - TAG_DISTANCE < world->position[i].y + world->position[i].height - 1
-					&& world->collision[i].active && world->position[i].level == entity.level) {
-						return i;
-					}
-				break;
-				default:
-					if (entity.x + entity.width -1 > world->position[i].x + 1 &&
-					entity.x  + 1 < world->position[i].x + world->position[i].width - 1 &&
-					entity.y + entity.height -1 > world->position[i].y + 1 &&
-					entity.y  + 1 < world->position[i].y + world->position[i].height - 1
-					&& world->collision[i].active && world->position[i].level == entity.level) {
-						return i;
-					}
-				break;
+	BodyBatch *batch = gather_colliders(world, entity.x - TAG_DISTANCE, entity.y - TAG_DISTANCE,
+		entity.x + entity.width + TAG_DISTANCE, entity.y + entity.height + TAG_DISTANCE, entity.level);
+	OverlapBox box;
+	unsigned long long bits;
+	unsigned int word, n;
+	int type;
+
+	//a pixel of slack on each side, with the reach added in the direction last moved
+	box.left = entity.x + 2 - (lastDirection == DIRECTION_LEFT ? TAG_DISTANCE : 0);
+	box.top = entity.y + 2 - (lastDirection == DIRECTION_DOWN ? TAG_DISTANCE : 0);
+	box.right = entity.x + entity.width - 2 + (lastDirection == DIRECTION_RIGHT ? TAG_DISTANCE : 0);
+	box.bottom = entity.y + entity.height - 2 + (lastDirection == DIRECTION_UP ? TAG_DISTANCE : 0);
+	box.reading = BOX_CORNER;
+
+	//the lowest entity in front wins
+	if (batch == NULL) {
+		n = scan_colliders(world, &box, entity.level, 0, &type);
+		if (n == currentEntityID) {
+			n = scan_colliders(world, &box, entity.level, n + 1, &type);
+		}
+		if (n < MAX_ENTITIES) {
+			return n;
+		}
+	}
+	else if (overlap_batch(batch, &box) > 0) {
+		for (word = 0; word < (batch->count + 63) / 64; word++) {
+			for (bits = batch->hits[word]; bits != 0; bits &= bits - 1) {
+				n = word * 64 + __builtin_ctzll(bits);
+				if (batch->entity[n] != currentEntityID) {
+					return batch->entity[n];
+				}
 			}
 		}
 	}
@@ -275,6 +705,10 @@ int check_tag_collision(World* world, unsigned int currentEntityID) {
  * Checks if a the tag key was pressed and if the current player is a guard.
  * If a player was tagged, the tag data is sent to the server.
  *
+ * Other players sit where they were drawn, a little behind the server, so the tag is
+ * checked against what the guard saw. The tag says when that was, for the server to
+ * check it against the same moment.
+ *
  * @param[in,out] world      		A pointer to the world structure.
  * @param[in]     entity   			The player entity number. 
  *
@@ -290,7 +724,7 @@ bool tag_player(World* world, unsigned int entity) {
 			for (i = 0; i < num_collisions; i++) {
 				if (world->collision[collision_list[i]].type == COLLISION_HACKER) {
 					printf("tagged\n");
-					send_tag(world, send_router_fd[WRITE], world->player[collision_list[i]].playerNo);
+					send_tag(world, send_router_ring, world->player[collision_list[i]].playerNo);
 				}
 			}
 			cleanup_spacebar_collision(&collision_list);
@@ -327,7 +761,7 @@ bool capture_objective(World* world, unsigned int entity) {
 			cleanup_spacebar_collision(&collision_list);
 		}
 		if (captured) {
-			send_objectives(world, send_router_fd[WRITE]);
+			send_objectives(world, send_router_ring);
 		}
 	}
 	return false;
@@ -356,13 +790,22 @@ bool spacebar_collision(World* world, unsigned int entity, unsigned int** collis
 	
 	*num_collisions = 0;
 	
-	for (i = 0; i < MAX_ENTITIES; i++) {
-		if (i != entity && IN_THIS_COMPONENT(world->mask[i], COLLISION_MASK)) {
-			if (position.x + position.width / 2 - 1 > world->position[i].x - world->position[i].width / 2 + 1 &&
-				position.x - position.width / 2 + 1 < world->position[i].x + world->position[i].width / 2 - 1 &&
-				position.y + position.height / 2 - 1 > world->position[i].y - world->position[i].height / 2 + 1 &&
-				position.y - position.height / 2 + 1 < world->position[i].y + world->position[i].height / 2 + 1
-				&& world->collision[i].active) {
+	BodyBatch *batch = gather_colliders(world, position.x - position.width / 2, position.y - position.height / 2,
+		position.x + position.width / 2, position.y + position.height / 2, position.level);
+	OverlapBox box;
+	unsigned long long bits;
+	unsigned int word, n;
+	int type;
+	
+	box.left = position.x - position.width / 2 + 2;
+	box.top = position.y - position.height / 2;
+	box.right = position.x + position.width / 2 - 2;
+	box.bottom = position.y + position.height / 2 - 2;
+	box.reading = BOX_CENTRE;
+	
+	if (batch == NULL) {
+		for (i = scan_colliders(world, &box, position.level, 0, &type); i < MAX_ENTITIES; i = scan_colliders(world, &box, position.level, i + 1, &type)) {
+			if (i != entity) {
 				if ((*collision_list = (unsigned int*)realloc(*collision_list, sizeof(unsigned int) * ((*num_collisions) + 1))) == NULL) {
 					return false;
 				}
@@ -371,6 +814,21 @@ bool spacebar_collision(World* world, unsigned int entity, unsigned int** collis
 			}
 		}
 	}
+	else if (overlap_batch(batch, &box) > 0) {
+		for (word = 0; word < (batch->count + 63) / 64; word++) {
+			for (bits = batch->hits[word]; bits != 0; bits &= bits - 1) {
+				n = word * 64 + __builtin_ctzll(bits);
+				i = batch->entity[n];
+				if (i != entity) {
+					if ((*collision_list = (unsigned int*)realloc(*collision_list, sizeof(unsigned int) * ((*num_collisions) + 1))) == NULL) {
+						return false;
+					}
+					(*collision_list)[*num_collisions] = i;
+					(*num_collisions)++;
+				}
+			}
+		}
+	}
 	
 	return ((*num_collisions) > 0);
 }
@@ -399,6 +857,8 @@ void cleanup_spacebar_collision(unsigned int** collision_list) {
  * @param[in] yPos         The tile ypos.
  * @param[in] level        The level that the tile is on.
  *
+ * @return The tile, -1 if the type isn't a belt or MAX_ENTITIES if the world is full.
+ *
  * @designer 
  * @author   
  */
@@ -411,6 +871,10 @@ unsigned int create_stile(World * world, int type, int xPos, int yPos, int level
 
 	unsigned int speed_tile = create_entity(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION | COMPONENT_COLLISION | COMPONENT_STILE);
 	
+	if (speed_tile == MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
 	int x = xPos / TILE_WIDTH;
 	int y = yPos / TILE_HEIGHT;
 	
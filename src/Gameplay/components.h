@@ -45,17 +45,43 @@ typedef struct {
 	int radius;
 } CollisionComponent;
 
+/**
+ * A collider baked into a floor's static layer.
+ *
+ * @struct StaticCollider
+ */
+typedef struct {
+	unsigned int entity;	/**< The collider's handle, so a destroyed one can be told apart. */
+	int type;				/**< Its collision type, which doesn't change after the floor is loaded. */
+} StaticCollider;
+
 /**
  * Describes a floor's properties.
  *
+ * The tiles are stored row by row, so tile (x, y) is map[y * width + x]. The walls
+ * are kept again as one bit per tile, each row padded out to whole words, so a
+ * run of tiles can be tested a word at a time. Both live in the one allocation
+ * that map points to.
+ *
+ * The colliders that never move (stairs, blocks, objects, objectives and power ups)
+ * are baked into a static layer when the floor is loaded, listed under every tile
+ * their box touches, so the collision passes don't have to test them every frame.
+ *
  * @struct LevelComponent
  */
 typedef struct {
 	int levelID;
-	int** map;
+	int* map;					/**< The collision type of each tile. */
+	unsigned long long* walls;	/**< One bit per tile, set for walls. */
+	int wall_stride;			/**< Words per row of walls. */
 	int width;
 	int height;
 	int tileSize;
+	unsigned int* static_start;		/**< Where each tile's static colliders start in statics, plus one past the last. */
+	StaticCollider* statics;		/**< The static colliders touching each tile, tile by tile. */
+	unsigned int num_static;		/**< The number of colliders baked into the floor. */
+	unsigned int* static_found;		/**< The entities the last static query returned. */
+	int* static_types;				/**< Their collision types. */
 } LevelComponent;
 
 /**
@@ -72,6 +98,10 @@ typedef struct {
 	float movY;
 	float acceleration;
 	float friction;
+	float prevX;	/**< Where the entity was before the last simulation step, to draw it between steps. */
+	float prevY;
+	float offsetX;	/**< What is still drawn of the last correction from the server, eased out over a few steps. */
+	float offsetY;
 } MovementComponent;
 
 typedef struct {
@@ -5,8 +5,94 @@
 #ifndef LEVEL_H
 #define LEVEL_H
 
+#include "components.h"
+
 #define L_EMPTY			1 /**< The tile is empty (traversed normally). */
 #define L_WALL			2 /**< The tile is a wall tile (can't be traversed). */
 #define L_STAIR			3 /**< The tile is a stair tile (sends the entity to a different floor). */
 
+/**
+ * Gets the collision type of a tile. The tile must be on the map.
+ *
+ * @param level The floor.
+ * @param x     The tile's column.
+ * @param y     The tile's row.
+ *
+ * @return The tile's collision type.
+ */
+static inline int level_tile(const LevelComponent *level, int x, int y) {
+	return level->map[y * level->width + x];
+}
+
+/**
+ * Checks whether a tile is a wall. The tile must be on the map.
+ *
+ * @param level The floor.
+ * @param x     The tile's column.
+ * @param y     The tile's row.
+ *
+ * @return Whether the tile is a wall.
+ */
+static inline bool level_wall(const LevelComponent *level, int x, int y) {
+	return (level->walls[y * level->wall_stride + (x >> 6)] >> (x & 63)) & 1;
+}
+
+/**
+ * Checks whether any tile in a run along one row is a wall. The run is clipped to
+ * the map.
+ *
+ * @param level The floor.
+ * @param y     The row. Must be on the map.
+ * @param x0    The first column in the run.
+ * @param x1    The last column in the run.
+ *
+ * @return Whether any tile from x0 to x1 is a wall.
+ */
+static inline bool level_wall_row(const LevelComponent *level, int y, int x0, int x1) {
+	const unsigned long long *row = level->walls + y * level->wall_stride;
+	unsigned long long bits;
+	int word;
+	
+	if (x0 < 0)
+		x0 = 0;
+	if (x1 >= level->width)
+		x1 = level->width - 1;
+	
+	for (word = x0 >> 6; x0 <= x1; word++, x0 = word << 6) {
+		bits = row[word] >> (x0 & 63);
+		if ((x1 >> 6) == word) {
+			bits &= ~0ULL >> (63 - (x1 - x0));
+		}
+		if (bits) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Checks whether any tile in a run down one column is a wall. The run is clipped to
+ * the map.
+ *
+ * @param level The floor.
+ * @param x     The column. Must be on the map.
+ * @param y0    The first row in the run.
+ * @param y1    The last row in the run.
+ *
+ * @return Whether any tile from y0 to y1 is a wall.
+ */
+static inline bool level_wall_column(const LevelComponent *level, int x, int y0, int y1) {
+	if (y0 < 0)
+		y0 = 0;
+	if (y1 >= level->height)
+		y1 = level->height - 1;
+	
+	for (; y0 <= y1; y0++) {
+		if (level_wall(level, x, y0)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 #endif
@@ -7,6 +7,9 @@
 #include "../world.h"
 #include "collision.h"
 #include "powerups.h"
+#include "prediction.h"
+#include "../Network/SnapshotBuffer.h"
+#include "../view.h"
 #include "stdio.h"
 #include <math.h>
 
@@ -15,20 +18,24 @@
 #define CONTROLLABLE_MASK (COMPONENT_POSITION | COMPONENT_MOVEMENT | COMPONENT_CONTROLLABLE)	/**< Mask for moveable entities that may be controlled. */
 #define INPUT_MASK (COMPONENT_INPUT)															/**< Mask for entities that respond to input. */
 #define COLLISION_MASK (COMPONENT_COLLISION)													/**< Mask for entities that may collide with other entities. */
+typedef View<PositionComponent, MovementComponent> MoverView;									/**< All moveable entities. */
 #define PI 3.14159265		
 #define DIRECTION_RIGHT	1
 #define DIRECTION_LEFT	2
 #define DIRECTION_UP	3
 #define DIRECTION_DOWN	4																	/**< An approximation of pi for vector calculations. */
+#define SWEEP_SKIN 0.01f																	/**< How far short of contact a swept move stops. */
+#define STEP_SNAP_DISTANCE 64																/**< Moves longer than this in one step are drawn without easing. */
 
+static const float command_x[] = { 0, 0, -1, 1 };		/**< The unit push across of C_UP, C_DOWN, C_LEFT and C_RIGHT. */
+static const float command_y[] = { -1, 1, 0, 0 };		/**< The unit push down of each direction command. */
+static const int command_direction[] = { DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT };	/**< The way each direction command faces. */
 
-extern objective_cache objective_table[];
-extern unsigned int* player_table;
+extern objective_cache *objective_table;
 extern int floor_change_flag;
-extern int send_router_fd[];
+extern PacketRing *send_router_ring;
 extern unsigned int player_entity;
 extern int network_ready;
-extern unsigned int *player_table;
 /**
  * Adds a vector to the entity's movement vector.
  *
@@ -56,120 +63,6 @@ void add_force(World* world, unsigned int entity, float magnitude, float dir) {
 	}
 }
 
-/**
- * Applies the entity's velocity to it's position (x vector).
- * 
- * It also scales the speed to the FPS of the game, so that entities move at the same speed
- * across all systems.
- * @param[in, out]	world	A pointer to the world structure
- * @param[in]		entity	The entity to whose position is changed
- * @param[in, out]	temp	The temporary position that is being applied
- * @param[in]		fps		The frames-per-second class that allows scaling
- * 
- * @return	void
- * 
- * @designer	Josh Campbell
- * @author		Josh Campbell
- */
-void apply_force_x(World* world, unsigned int entity, PositionComponent* temp, FPS fps) {
-	temp->x += world->movement[entity].movX * ((double)GAME_SPEED / fps.getFPS());
-}
-
-/**
- * Removes the entity's velocity from it's position (x vector).
- * 
- * It also scales the speed to the FPS of the game, so that entities move at the same speed
- * across all systems.
- * @param[in, out]	world	A pointer to the world structure
- * @param[in]		entity	The entity to whose position is changed
- * @param[in, out]	temp	The temporary position that is being applied
- * @param[in]		fps		The frames-per-second class that allows scaling
- * 
- * @return	void
- * 
- * @designer	Josh Campbell
- * @author		Josh Campbell
- */
-void remove_force_x(World* world, unsigned int entity, PositionComponent* temp, FPS fps) {
-	temp->x -= world->movement[entity].movX * ((double)GAME_SPEED / fps.getFPS());
-}
-
-/**
- * Applies the entity's deceleration to it's velocity (x vector).
- * 
- * It also scales the speed to the FPS of the game, so that entities move at the same speed
- * across all systems.
- * @param[in, out]	world	A pointer to the world structure
- * @param[in]		entity	The entity to whose position is changed
- * @param[in, out]	temp	The temporary position that is being applied
- * @param[in]		fps		The frames-per-second class that allows scaling
- * 
- * @return	void
- * 
- * @designer	Josh Campbell
- * @author		Josh Campbell
- */
-void apply_deceleration_x(World* world, unsigned int entity, FPS fps) {
-	world->movement[entity].movX *= 1 - world->movement[entity].friction * ((double)GAME_SPEED / fps.getFPS());
-}
-
-/**
- * Applies the entity's velocity to it's position (y vector).
- * 
- * It also scales the speed to the FPS of the game, so that entities move at the same speed
- * across all systems.
- * @param[in, out]	world	A pointer to the world structure
- * @param[in]		entity	The entity to whose position is changed
- * @param[in, out]	temp	The temporary position that is being applied
- * @param[in]		fps		The frames-per-second class that allows scaling
- * 
- * @return	void
- * 
- * @designer	Josh Campbell
- * @author		Josh Campbell
- */
-void apply_force_y(World* world, unsigned int entity, PositionComponent* temp, FPS fps) {
-	temp->y += world->movement[entity].movY * ((double)GAME_SPEED / fps.getFPS());
-}
-
-/**
- * Removes the entity's velocity from it's position (y vector).
- * 
- * It also scales the speed to the FPS of the game, so that entities move at the same speed
- * across all systems.
- * @param[in, out]	world	A pointer to the world structure
- * @param[in]		entity	The entity to whose position is changed
- * @param[in, out]	temp	The temporary position that is being applied
- * @param[in]		fps		The frames-per-second class that allows scaling
- * 
- * @return	void
- * 
- * @designer	Josh Campbell
- * @author		Josh Campbell
- */
-void remove_force_y(World* world, unsigned int entity, PositionComponent* temp, FPS fps) {
-	temp->y -= world->movement[entity].movY * ((double)GAME_SPEED / fps.getFPS());
-}
-
-/**
- * Applies the entity's deceleration to it's velocity (y vector).
- * 
- * It also scales the speed to the FPS of the game, so that entities move at the same speed
- * across all systems.
- * @param[in, out]	world	A pointer to the world structure
- * @param[in]		entity	The entity to whose position is changed
- * @param[in, out]	temp	The temporary position that is being applied
- * @param[in]		fps		The frames-per-second class that allows scaling
- * 
- * @return	void
- * 
- * @designer	Josh Campbell
- * @author		Josh Campbell
- */
-void apply_deceleration_y(World* world, unsigned int entity, FPS fps) {
-	world->movement[entity].movY *= 1 - world->movement[entity].friction * ((double)GAME_SPEED / fps.getFPS());
-}
-
 /* SPECIAL TILES */
 void add_force_acceleration_x(World * world, MovementComponent& movement, float magnitude, float dir, float friction) {
 
@@ -188,84 +81,100 @@ void add_force_acceleration_x(World * world, MovementComponent& movement, float
 }
 
 /**
- * Handles the solid-wall x axis collisions, be it with walls or solid entities.
- * 
- * @param[in, out]	world			A pointer to the world struct.
- * @param[in]		entity			The current entity id whose collisions are being checked.
- * @param[in, out]	temp			The temporary position of the entity.
- * @praam[in]		entity_number	The entity collision type of the hit entity.
- * @param[in]		tile_number		The tile collision type of the hit tile.
- * @param[in]		fps				The current frames per second.
- * 
+ * Sweeps an entity along a move, stopping it at the first wall or solid entity in its
+ * way and sliding it along whatever it hit with what is left of the move.
+ *
+ * @param[in, out]	world		A pointer to the world struct.
+ * @param[in]		entity		The entity that is moving.
+ * @param[in]		dx			The move across.
+ * @param[in]		dy			The move down.
+ * @param[in]		batch		The colliders from gather_colliders. Must cover the whole move, or NULL.
+ * @param[in, out]	temp		The temporary position of the entity.
+ * @param[out]		tile_number	COLLISION_WALL if it ran into a wall.
+ *
  * @return	void
- * 
- * @designer	Josh Campbell
- * @author		Josh Campbell & Clark Allenby
+ *
+ * @designer
+ * @author
  */
-void handle_x_collision(World* world, unsigned int entity, PositionComponent* temp, unsigned int entity_number, unsigned int tile_number, FPS fps) {
-
-	switch(entity_number) {
-		case COLLISION_SOLID:
-		case COLLISION_HACKER:
-		case COLLISION_GUARD:
-		case COLLISION_TARGET:
-			remove_force_x(world, entity, temp, fps);
-			world->movement[entity].movX = 0;
-			break;
-		default:
+static void sweep_entity(World* world, unsigned int entity, float dx, float dy, BodyBatch* batch, PositionComponent* temp, unsigned int* tile_number) {
+	MovementComponent *movement = &(world->movement[entity]);
+	SweepHit hit;
+	int pass;
+	
+	*tile_number = COLLISION_EMPTY;
+	
+	//one pass for the move, and one to slide along whatever stopped it
+	for (pass = 0; pass < 2 && (dx != 0 || dy != 0); pass++) {
+		sweep_collision(world, entity, *temp, dx, dy, batch, &hit);
+		
+		//stop just short of contact, so rounding can't leave the entity inside what it hit
+		temp->x += dx * hit.time + hit.normalX * SWEEP_SKIN;
+		temp->y += dy * hit.time + hit.normalY * SWEEP_SKIN;
+		
+		if (hit.time >= 1) {
 			break;
 		}
-
-	switch(tile_number) {
-		case COLLISION_WALL:
-			remove_force_x(world, entity, temp, fps);
-			world->movement[entity].movX = 0;
-			break;
-		default:
-			if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_CONTROLLABLE)) {
-				apply_deceleration_x(world, entity, fps);
-			}
-			break;
+		if (hit.type == COLLISION_WALL) {
+			*tile_number = COLLISION_WALL;
+		}
+		
+		if (hit.normalX != 0) {
+			movement->movX = 0;
+			dx = 0;
+			dy *= 1 - hit.time;
+		}
+		else {
+			movement->movY = 0;
+			dy = 0;
+			dx *= 1 - hit.time;
+		}
 	}
 }
 
 /**
- * Handles the solid-wall y axis collisions, be it with walls or solid entities.
+ * Moves an entity by its velocity for one step. The move is swept against walls and
+ * solid entities, so a fast entity stops at the first thing in its way instead of
+ * passing through it, then slides along it with what is left of the move.
+ *
+ * Everything the entity can touch is gathered once, and the same colliders are used
+ * for the stuck check, the sweep and the triggers the entity ends up on.
  * 
  * @param[in, out]	world			A pointer to the world struct.
- * @param[in]		entity			The current entity id whose collisions are being checked.
+ * @param[in]		entity			The entity that is moving.
+ * @param[in]		dx				The move across, from integrate_movers.
+ * @param[in]		dy				The move down.
  * @param[in, out]	temp			The temporary position of the entity.
- * @praam[in]		entity_number	The entity collision type of the hit entity.
- * @param[in]		tile_number		The tile collision type of the hit tile.
- * @param[in]		fps				The current frames per second.
+ * @param[out]		tile_number		COLLISION_WALL if it ran into a wall.
  * 
- * @return	void
+ * @return	The colliders around the move, for batch_triggers; NULL if they couldn't be gathered.
  * 
- * @designer	Josh Campbell
- * @author		Josh Campbell & Clark Allenby
+ * @designer
+ * @author
  */
-void handle_y_collision(World* world, unsigned int entity, PositionComponent* temp, unsigned int entity_number, unsigned int tile_number, FPS fps) {
-	switch(entity_number) {
-		case COLLISION_SOLID:
-		case COLLISION_HACKER:
-		case COLLISION_GUARD:
-		case COLLISION_TARGET:
-			remove_force_y(world, entity, temp, fps);
-			world->movement[entity].movY = 0;
-			break;
-	}
+BodyBatch *move_entity(World* world, unsigned int entity, float dx, float dy, PositionComponent* temp, unsigned int* tile_number) {
+	float reachX = fabsf(dx);
+	float reachY = fabsf(dy);
+	BodyBatch *batch;
+	unsigned int entity_number, hit_entity;
 	
-	switch(tile_number) {
-		case COLLISION_WALL:
-			remove_force_y(world, entity, temp, fps);
-			world->movement[entity].movY = 0;
-			break;
-		default:
-			if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_CONTROLLABLE)) {
-				apply_deceleration_y(world, entity, fps);
-			}
-			break;
+	batch = gather_colliders(world, temp->x - temp->width / 2 - reachX, temp->y - temp->height / 2 - reachY,
+		temp->x + temp->width / 2 + reachX, temp->y + temp->height / 2 + reachY, temp->level);
+	
+	if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_CONTROLLABLE)) {
+		batch_collision(world, batch, entity, *temp, &entity_number, &hit_entity);
+		if (hit_entity < MAX_ENTITIES && (entity_number == COLLISION_HACKER || entity_number == COLLISION_GUARD)) {
+			anti_stuck_system(world, entity, hit_entity);
+			
+			//the other player has been moved out of the way
+			batch = gather_colliders(world, temp->x - temp->width / 2 - reachX, temp->y - temp->height / 2 - reachY,
+				temp->x + temp->width / 2 + reachX, temp->y + temp->height / 2 + reachY, temp->level);
+		}
 	}
+	
+	sweep_entity(world, entity, dx, dy, batch, temp, tile_number);
+	
+	return batch;
 }
 /**
  * Recreates the environment with the map specified without deleting the characters.
@@ -294,7 +203,7 @@ void rebuild_floor(World* world, int targl)
     {
         for(int i = 0; i < MAX_PLAYERS; i++)
         {
-            if(player_table[i] != UNASSIGNED)
+            if(player_lookup(world, i) != MAX_ENTITIES)
             {
                 num_players++;
             }
@@ -378,74 +287,117 @@ void rebuild_floor(World* world, int targl)
 			map_init(world, "assets/Graphics/map/map_09/map09.txt", "assets/Graphics/map/map_09/tiles.txt");
 			break;
 	}
-	for (unsigned int i = 0; i < MAX_ENTITIES; i++) {
-		if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_LEVEL)) {
-			world->level[i].levelID = targl;
+	//the floor that was just loaded is the only one in the registry
+	for (int i = 0; i < MAX_LEVELS; i++) {
+		if (world->levels[i] != MAX_ENTITIES) {
+			set_level_floor(world, world->levels[i], targl);
 			break;
 		}
 	}
 }
 
 /**
- * Handles collisions with entities.
+ * Sets off the effect of a trigger an entity has walked onto, is standing on or has
+ * walked off.
+ *
+ * Stairs ask for the floor change and powerups are picked up once, on the way in.
+ * Belts speed the entity up on the way in, push it every step it stays on, and put
+ * its speed back on the way out, keeping any speed powerup it still has.
  * 
- * @param[in, out]	world			A pointer to the world struct.
- * @param[in]		entity			The current entity that is being checked.
- * @param[in]		entity_number	The entity collision type.
- * @param[in]		tile_number		The tile collision type.
- * @param[in]		hit_entity		The id of the entity that was hit.
+ * @param[in, out]	world	A pointer to the world struct.
+ * @param[in]		entity	The entity on the trigger.
+ * @param[in]		trigger	The event from batch_triggers.
  * 
- * @return	void
+ * @return	true if the floor was rebuilt, which destroys the other triggers.
  * 
  * @designer	Josh Campbell & Clark Allenby
  * @author		Josh Campbell & Clark Allenby
  */
-void handle_entity_collision(World* world, unsigned int entity, unsigned int entity_number, unsigned int tile_number, unsigned int hit_entity) {
-	switch(entity_number) {
+bool trigger_event(World* world, unsigned int entity, const TriggerEvent* trigger) {
+	switch(trigger->type) {
 		case COLLISION_STAIR:
-			if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_CONTROLLABLE) && (world->collision[entity].type == COLLISION_HACKER || world->collision[entity].type == COLLISION_GUARD)) {
-				int targx = world->wormhole[hit_entity].targetX;
-				int targy = world->wormhole[hit_entity].targetY;
-				int targl = world->wormhole[hit_entity].targetLevel;
+			if (trigger->event == TRIGGER_ENTER && IN_THIS_COMPONENT(world->mask[entity], COMPONENT_CONTROLLABLE) && (world->collision[entity].type == COLLISION_HACKER || world->collision[entity].type == COLLISION_GUARD)) {
+				int targx = world->wormhole[trigger->trigger].targetX;
+				int targy = world->wormhole[trigger->trigger].targetY;
+				int targl = world->wormhole[trigger->trigger].targetLevel;
 
-				move_request(world, send_router_fd[WRITE], targl, targx, targy);
+				move_request(world, send_router_ring, targl, targx, targy);
 				if(!network_ready)
 				{
 					rebuild_floor(world, targl);
-					return;
+					return true;
 				}
 				floor_change_flag = 1;
 			}
 			break;
 		case COLLISION_BELTLEFT_TILE:
-			powerup_beltleft(world, entity);
+			if (trigger->event == TRIGGER_ENTER) {
+				powerup_beltleft(world, entity);
+			}
 			break;
 		case COLLISION_BELTRIGHT_TILE:
-			powerup_beltright(world, entity);
+			if (trigger->event == TRIGGER_ENTER) {
+				powerup_beltright(world, entity);
+			}
 			break;
 		case COLLISION_PU_SPEEDUP:
-			powerup_speedup(world, entity);
-		break;
+			if (trigger->event == TRIGGER_ENTER) {
+				powerup_speedup(world, entity);
+			}
+			break;
 		case COLLISION_PU_SPEEDDOWN:
-			powerup_speeddown(world, entity);
-		break;
-		case COLLISION_BELTRIGHT:
-			world->movement[player_entity].maxSpeed = world->movement[player_entity].defMaxSpeed * 5.0;
-			world->player[player_entity].onTile = 1;
-			add_force(world, entity, 5.0, 0);
+			if (trigger->event == TRIGGER_ENTER) {
+				powerup_speeddown(world, entity);
+			}
 			break;
+		case COLLISION_BELTRIGHT:
 		case COLLISION_BELTLEFT:
-			world->movement[player_entity].maxSpeed = world->movement[player_entity].defMaxSpeed * 5.0;
-			world->player[player_entity].onTile = 1;
-			add_force(world, entity, 20.0, 180);
+			//off the belt, the speed goes back to what any speed powerup still running gives
+			if (trigger->event != TRIGGER_STAY) {
+				world->movement[entity].maxSpeed = (trigger->event == TRIGGER_ENTER) ? world->movement[entity].defMaxSpeed * 5.0 : powerup_max_speed(world, entity);
+				if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_PLAYER)) {
+					world->player[entity].onTile = (trigger->event == TRIGGER_ENTER);
+				}
+			}
+			if (trigger->event == TRIGGER_EXIT) {
+				break;
+			}
+			if (trigger->type == COLLISION_BELTRIGHT) {
+				add_force(world, entity, 5.0, 0);
+			}
+			else {
+				add_force(world, entity, 20.0, 180);
+			}
 			break;
 	}
-		
-	if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_CONTROLLABLE) && world->controllable[entity].active) {
-		tag_player(world, entity);
-		capture_objective(world, entity);
+	return false;
+}
+
+/**
+ * Sets off the effects of every trigger event an entity had this step.
+ *
+ * @param[in, out]	world		A pointer to the world struct.
+ * @param[in]		entity		The entity on the triggers.
+ * @param[in]		events		The events from batch_triggers.
+ * @param[in]		num_events	The number of events.
+ *
+ * @return	true if the floor was rebuilt.
+ *
+ * @designer
+ * @author
+ */
+static bool trigger_events(World* world, unsigned int entity, const TriggerEvent* events, unsigned int num_events) {
+	unsigned int n;
+	
+	for (n = 0; n < num_events; n++) {
+		//a floor change has cleared out the rest
+		if (trigger_event(world, entity, &events[n])) {
+			return true;
+		}
 	}
+	return false;
 }
+
 /**
  * Updates the visibility of a tile based on player position and destroys it based on
  * the status of the tile timer.
@@ -463,24 +415,18 @@ int manage_special_tiles(World * world, unsigned int entity)
 	if(IN_THIS_COMPONENT(world->mask[entity], COMPONENT_STILE))
 	{
 		unsigned int current_time = SDL_GetTicks();
-		
-		if((world->position[player_entity].x != world->position[entity].x) && world->player[player_entity].onTile)
-		{
-			world->movement[player_entity].maxSpeed = 8;
-			world->player[player_entity].onTile = 0;
-		}
 
 		if((current_time - world->tile[entity].start_time) >= 5000)
 		{
-			destroy_entity(world, entity);
+			defer_destroy(world, entity);
 		}
 		else if(world->position[entity].level == world->position[player_entity].level)
 		{
-			world->mask[entity] |= COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION;
+			defer_enable(world, entity, COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION);
 		}
 		else if(world->position[entity].level != world->position[player_entity].level)
 		{
-			world->mask[entity] &= ~(COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION);
+			defer_disable(world, entity, COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION);
 		}
 
 		return 1;
@@ -488,37 +434,257 @@ int manage_special_tiles(World * world, unsigned int entity)
 	return 0;
 }
 
+/**
+ * Puts one mover into a lane of the integrator batch.
+ *
+ * @param[in, out]	world		A pointer to the world struct.
+ * @param[out]		batch		The integrator batch.
+ * @param[in]		lane		The lane to fill.
+ * @param[in]		entity		The mover.
+ * @param[in]		commands	The commands pushing the mover, or NULL if it isn't pushed
+ *								or slowed this step.
+ *
+ * @designer
+ * @author
+ */
+static void fill_lane(World* world, MoverBatch* batch, unsigned int lane, unsigned int entity, const bool* commands) {
+	MovementComponent *movement = &(world->movement[entity]);
+	int c;
+	
+	batch->entity[lane] = entity;
+	batch->movX[lane] = movement->movX;
+	batch->movY[lane] = movement->movY;
+	batch->forceX[lane] = 0;
+	batch->forceY[lane] = 0;
+	batch->maxSpeed[lane] = movement->maxSpeed;
+	batch->friction[lane] = 0;
+	
+	if (commands == NULL) {
+		return;
+	}
+	
+	for(c = C_UP; c <= C_RIGHT; c++) {
+		if (commands[c]) {
+			movement->lastDirection = command_direction[c];
+			batch->forceX[lane] += command_x[c] * movement->acceleration;
+			batch->forceY[lane] += command_y[c] * movement->acceleration;
+		}
+	}
+	
+	//only entities that are swept slow down, as before
+	if (IN_THIS_COMPONENT(world->mask[entity], COLLISION_MASK)) {
+		batch->friction[lane] = movement->friction;
+	}
+}
+
+/**
+ * Steps a single mover through a batch of one lane kept on the stack, so nothing has
+ * to be allocated.
+ *
+ * @param[in, out]	world		A pointer to the world struct.
+ * @param[in]		entity		The mover.
+ * @param[in]		commands	The commands pushing the mover, as for fill_lane.
+ * @param[out]		dx			The move this step, before collisions.
+ * @param[out]		dy
+ *
+ * @return	void
+ *
+ * @designer
+ * @author
+ */
+static void step_mover(World* world, unsigned int entity, const bool* commands, float* dx, float* dy) {
+	MoverBatch lane;
+	unsigned int lane_entity;
+	float movX, movY, forceX, forceY, maxSpeed, friction;
+	
+	lane.entity = &lane_entity;
+	lane.movX = &movX;
+	lane.movY = &movY;
+	lane.forceX = &forceX;
+	lane.forceY = &forceY;
+	lane.maxSpeed = &maxSpeed;
+	lane.friction = &friction;
+	lane.dx = dx;
+	lane.dy = dy;
+	lane.count = 1;
+	lane.size = 1;
+	
+	fill_lane(world, &lane, 0, entity, commands);
+	integrate_movers(&lane);
+	world->movement[entity].movX = movX;
+	world->movement[entity].movY = movY;
+}
+
+/**
+ * Gets the commands pushing a mover this step.
+ *
+ * @param[in]	world	A pointer to the world struct.
+ * @param[in]	entity	The mover.
+ *
+ * @return	The commands of an active controllable entity, otherwise NULL.
+ *
+ * @designer
+ * @author
+ */
+static const bool *mover_commands(World* world, unsigned int entity) {
+	if (IN_THIS_COMPONENT(world->mask[entity], CONTROLLABLE_MASK) && world->controllable[entity].active) {
+		return world->command[entity].commands;
+	}
+	return NULL;
+}
+
+/**
+ * Fills the integrator batch with every mover's velocity and this step's push, then
+ * steps them all at once. Active controllable entities are pushed by the direction
+ * keys held down and slowed by their friction; everything else keeps its velocity.
+ *
+ * @param[in, out]	world	A pointer to the world struct.
+ * @param[in]		movers	The movers, in the order the movement system walks them.
+ *
+ * @return	The stepped batch, or NULL if it couldn't be allocated; nothing has been
+ *			stepped then, and each mover is stepped on its own with step_mover.
+ *
+ * @designer
+ * @author
+ */
+static MoverBatch *step_movers(World* world, const MoverView& movers) {
+	MoverBatch *batch = reserve_movers(world, movers.size());
+	MovementComponent *movement;
+	unsigned int i;
+	static bool warned = false;
+	
+	if (batch == NULL) {
+		if (!warned) {
+			perror("step_movers: malloc");
+			printf("step_movers: %u movers don't fit, stepping them one at a time\n", movers.size());
+			warned = true;
+		}
+		return NULL;
+	}
+	
+	for(i = 0; i < movers.size(); i++) {
+		fill_lane(world, batch, i, movers[i], mover_commands(world, movers[i]));
+	}
+	
+	integrate_movers(batch);
+	
+	for(i = 0; i < movers.size(); i++) {
+		movement = &movers.get<MovementComponent>(batch->entity[i]);
+		movement->movX = batch->movX[i];
+		movement->movY = batch->movY[i];
+	}
+	return batch;
+}
+
+/**
+ * Runs one simulation step again for a single entity, with the commands it had then.
+ * Only the entity's own movement is stepped: it is pushed, slowed and swept against
+ * walls and solid entities, but it doesn't move anything else or set off triggers.
+ *
+ * @param[in, out]	world		A pointer to the world struct.
+ * @param[in]		entity		The entity to step.
+ * @param[in]		commands	The commands the entity had in that step.
+ *
+ * @return	void
+ *
+ * @designer
+ * @author
+ */
+void replay_step(World* world, unsigned int entity, const bool* commands) {
+	PositionComponent *position = &(world->position[entity]);
+	PositionComponent temp = *position;
+	unsigned int tile_number;
+	float dx, dy, reachX, reachY;
+	
+	if (!IN_THIS_COMPONENT(world->mask[entity], STANDARD_MASK | COLLISION_MASK)) {
+		return;
+	}
+	
+	step_mover(world, entity, commands, &dx, &dy);
+	
+	reachX = fabsf(dx);
+	reachY = fabsf(dy);
+	sweep_entity(world, entity, dx, dy,
+		gather_colliders(world, temp.x - temp.width / 2 - reachX, temp.y - temp.height / 2 - reachY,
+			temp.x + temp.width / 2 + reachX, temp.y + temp.height / 2 + reachY, temp.level),
+		&temp, &tile_number);
+	
+	position->x = temp.x;
+	position->y = temp.y;
+	update_body(world, entity);
+}
+
 /**
  * Determines the inputs applied to the entity and adds forces in
  * the specified directions.
  *
- * @param[in, out]	world	A pointer to the world struct.
- * @param[in]		fps		current frame rate.
+ * Each call is one simulation step of STEP_MS. The game loop runs as many steps as
+ * the time that has passed calls for, so movement doesn't depend on the frame rate.
+ *
+ * @param[in, out]	world		A pointer to the world struct.
+ * @param[in]		send_ring	The ring to the network router.
  *
  * @return	void
  * 
  * @designer	Josh Campbell & Clark Allenby
  * @author		Clark Allenby & Josh Campbell
  */
-void movement_system(World* world, FPS fps, int sendpipe) {
+void movement_system(World* world, PacketRing *send_ring) {
 	unsigned int entity;
+	unsigned int i;
 	PositionComponent		*position;
 	CommandComponent		*command;
 	ControllableComponent 	*controllable;
 	MovementComponent		*movement;
+	MoverBatch				*steps;
+	float					dx, dy;
+
+	advance_snapshot_clock();
 
-	//loop through each entity and see if the system can do work on it.
-	for(entity = 0; entity < MAX_ENTITIES; entity++) {
+	//expired tiles are only destroyed at the sync point, so the list stays good
+	View<TileComponent> special_tiles(world);
+	for(i = 0; i < special_tiles.size(); i++) {
+		manage_special_tiles(world, special_tiles[i]);
+	}
 
-		if(manage_special_tiles(world, entity))
+	//nothing has moved yet this step, so take a fresh copy of the colliders
+	sync_bodies(world);
+
+	//loop through each moveable entity and see if the system can do work on it.
+	MoverView movers(world);
+	
+	//remember where everything starts the step, so frames can be drawn between steps
+	for(i = 0; i < movers.size(); i++) {
+		movers.get<MovementComponent>(movers[i]).prevX = movers.get<PositionComponent>(movers[i]).x;
+		movers.get<MovementComponent>(movers[i]).prevY = movers.get<PositionComponent>(movers[i]).y;
+	}
+	
+	//push, slow and work out the move of every mover at once; lane i is movers[i]
+	steps = step_movers(world, movers);
+	
+	for(i = 0; i < movers.size(); i++) {
+		entity = movers[i];
+
+		//changing floors clears out the world as we go
+		if (!movers.has(entity)) {
 			continue;
+		}
+		
+		//a mover's step only depends on its own velocity and commands, so it can be taken here
+		if (steps != NULL) {
+			dx = steps->dx[i];
+			dy = steps->dy[i];
+		}
+		else {
+			step_mover(world, entity, mover_commands(world, entity), &dx, &dy);
+		}
 
 		//For controllable entities
 		if (IN_THIS_COMPONENT(world->mask[entity], CONTROLLABLE_MASK)) {
 			command = &(world->command[entity]);
-			position = &(world->position[entity]);
+			position = &movers.get<PositionComponent>(entity);
 			controllable = &(world->controllable[entity]);
-			movement = &(world->movement[entity]);
+			movement = &movers.get<MovementComponent>(entity);
 			//very simple movement. This needs to be synchronized with the
 			//game loop so there is no jittering on very slow systems.
 			if (controllable->active == true) {
@@ -528,40 +694,26 @@ void movement_system(World* world, FPS fps, int sendpipe) {
 				temp.width = position->width;
 				temp.height = position->height;
 				temp.level = position->level;
-				unsigned int entity_number = 0;
 				unsigned int tile_number = 0;
-				unsigned int hit_entity = 0;
-				
-				if (command->commands[C_UP]) {
-					world->movement[entity].lastDirection = DIRECTION_UP;
-					add_force(world, entity, world->movement[entity].acceleration, -90);
-				}
-				
-				if (command->commands[C_DOWN]) {
-					world->movement[entity].lastDirection = DIRECTION_DOWN;
-					add_force(world, entity, world->movement[entity].acceleration, 90);
-				}
-				
-				if (command->commands[C_LEFT]) {
-					world->movement[entity].lastDirection = DIRECTION_LEFT;
-					add_force(world, entity, world->movement[entity].acceleration, 180);
-				}
+				TriggerEvent events[MAX_TRIGGERS * 2];
+				unsigned int num_events;
+				BodyBatch *batch;
 				
-				if (command->commands[C_RIGHT]) {
-					world->movement[entity].lastDirection = DIRECTION_RIGHT;
-					add_force(world, entity, world->movement[entity].acceleration, 0);
-				}
 				/* SPECIAL TILES */
 				unsigned int tile;
 				if(command->commands[C_TILE]){
 					switch(world->player[entity].tilez){
 						case TILE_BELT_RIGHT:
 							tile = create_stile(world, TILE_BELT_RIGHT, world->position[entity].x, world->position[entity].y, world->position[entity].level);
-							send_tiles(world, tile, send_router_fd[WRITE]);
+							if (tile != MAX_ENTITIES) {
+								send_tiles(world, tile, send_router_ring);
+							}
 							break;
 						case TILE_BELT_LEFT: 
 							tile = create_stile(world, TILE_BELT_LEFT, world->position[entity].x, world->position[entity].y, world->position[entity].level);
-							send_tiles(world, tile, send_router_fd[WRITE]);
+							if (tile != MAX_ENTITIES) {
+								send_tiles(world, tile, send_router_ring);
+							}
 							break;
 					}
 				}
@@ -569,24 +721,18 @@ void movement_system(World* world, FPS fps, int sendpipe) {
 				
 				if (IN_THIS_COMPONENT(world->mask[entity], COLLISION_MASK)) {
 					
-					collision_system(world, entity, &temp, &entity_number, &tile_number, &hit_entity);
-					if (hit_entity != (unsigned int)-1 && (entity_number == COLLISION_HACKER || entity_number== COLLISION_GUARD)) {
-						anti_stuck_system(world, entity, hit_entity);
-					}
-
-					apply_force_x(world, entity, &temp, fps);
-					collision_system(world, entity, &temp, &entity_number, &tile_number, &hit_entity);
-					handle_x_collision(world, entity, &temp, entity_number, tile_number, fps);
-					
-					apply_force_y(world, entity, &temp, fps);
-					collision_system(world, entity, &temp, &entity_number, &tile_number, &hit_entity);
-					handle_y_collision(world, entity, &temp, entity_number, tile_number, fps);
+					batch = move_entity(world, entity, dx, dy, &temp, &tile_number);
+					num_events = batch_triggers(world, batch, entity, temp, events);
 					
-					handle_entity_collision(world, entity, entity_number, tile_number, hit_entity);
+					if (!trigger_events(world, entity, events, num_events)) {
+						tag_player(world, entity);
+						capture_objective(world, entity);
+					}
 				 }
 				
 				position->x = temp.x;
 				position->y = temp.y;
+				update_body(world, entity);
 
 				if (movement->movX > 0 && abs(movement->movX) > abs(movement->movY)) {
 					play_animation(world, entity, "right");
@@ -620,23 +766,27 @@ void movement_system(World* world, FPS fps, int sendpipe) {
 				
 				if (position->level == 0) { // sends ready statuses from the lobby
 					if (position->x < 240) {
-						send_status(world, sendpipe, 1, PLAYER_STATE_READY);
+						send_status(world, send_ring, 1, PLAYER_STATE_READY);
 					}
 					else if (position->x > 1000) {
-						send_status(world, sendpipe, 2, PLAYER_STATE_READY);
+						send_status(world, send_ring, 2, PLAYER_STATE_READY);
 					}
 					else {
-						send_status(world, sendpipe, 0, PLAYER_STATE_WAITING);
+						send_status(world, send_ring, 0, PLAYER_STATE_WAITING);
 					}
 				}
 				powerup_system(world, entity);
 			}
+			
+			//key presses are held until a step has seen them, and only one step acts on them
+			command->commands[C_ACTION] = false;
+			command->commands[C_TILE] = false;
 		}
 		else if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_POSITION | COMPONENT_MOVEMENT | COMPONENT_COLLISION)) {
 			command = &(world->command[entity]);
-			position = &(world->position[entity]);
+			position = &movers.get<PositionComponent>(entity);
 			controllable = &(world->controllable[entity]);
-			movement = &(world->movement[entity]);
+			movement = &movers.get<MovementComponent>(entity);
 			PositionComponent temp;
 			
 			temp.x = position->x;
@@ -644,23 +794,23 @@ void movement_system(World* world, FPS fps, int sendpipe) {
 			temp.width = position->width;
 			temp.height = position->height;
 			temp.level = position->level;
-			unsigned int entity_number = 0;
 			unsigned int tile_number = 0;
-			unsigned int hit_entity = 0;
-			
-			
-			apply_force_x(world, entity, &temp, fps);
-			collision_system(world, entity, &temp, &entity_number, &tile_number, &hit_entity);
-			handle_x_collision(world, entity, &temp, entity_number, tile_number, fps);
+			TriggerEvent events[MAX_TRIGGERS * 2];
+			unsigned int num_events;
 			
-			apply_force_y(world, entity, &temp, fps);
-			collision_system(world, entity, &temp, &entity_number, &tile_number, &hit_entity);
-			handle_y_collision(world, entity, &temp, entity_number, tile_number, fps);
+			//other players already moved on their own clients; draw them from their updates
+			if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_PLAYER) && sample_snapshot(world->player[entity].playerNo, &temp.x, &temp.y)) {
+				num_events = entity_triggers(world, entity, temp, events);
+			}
+			else {
+				num_events = batch_triggers(world, move_entity(world, entity, dx, dy, &temp, &tile_number), entity, temp, events);
+			}
 			
 			position->x = temp.x;
 			position->y = temp.y;
+			update_body(world, entity);
 			
-			handle_entity_collision(world, entity, entity_number, tile_number, hit_entity);
+			trigger_events(world, entity, events, num_events);
 			
 			switch(world->movement[entity].lastDirection) {
 				case DIRECTION_RIGHT:
@@ -694,5 +844,47 @@ void movement_system(World* world, FPS fps, int sendpipe) {
 			}
 		}
 	}
+	
+	//the local player's step is kept so it can be replayed over a correction from the server
+	record_prediction(world, player_entity);
 }
 
+
+/**
+ * Gets where to draw an entity between two simulation steps, part of the way from
+ * where it started the last step to where the step left it. Entities that don't move
+ * are drawn where they are, as are ones that jumped too far in the step, like a
+ * player taking the stairs.
+ *
+ * @param[in]	world	A pointer to the world struct.
+ * @param[in]	entity	The entity being drawn.
+ * @param[in]	alpha	How far into the next step the clock is, from 0 to 1.
+ * @param[out]	x		Set to the x position to draw at.
+ * @param[out]	y		Set to the y position to draw at.
+ *
+ * @designer
+ * @author
+ */
+void step_position(World* world, unsigned int entity, float alpha, float* x, float* y) {
+	PositionComponent *position = &(world->position[entity]);
+	MovementComponent *movement;
+	
+	*x = position->x;
+	*y = position->y;
+	
+	if (!IN_THIS_COMPONENT(world->mask[entity], STANDARD_MASK)) {
+		return;
+	}
+	
+	movement = &(world->movement[entity]);
+	
+	//written so a position that was never saved fails the test too
+	if (fabs(position->x - movement->prevX) <= STEP_SNAP_DISTANCE && fabs(position->y - movement->prevY) <= STEP_SNAP_DISTANCE) {
+		*x = movement->prevX + (position->x - movement->prevX) * alpha;
+		*y = movement->prevY + (position->y - movement->prevY) * alpha;
+	}
+	
+	//what is left of the last correction from the server, eased out over a few steps
+	*x += movement->offsetX;
+	*y += movement->offsetY;
+}
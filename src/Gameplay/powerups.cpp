@@ -126,3 +126,29 @@ void powerup_system(World * world, unsigned int entityID) {
 		}
 	}
 }
+
+/**
+ * Gets the top speed an entity should have with whatever speed powerup it has now,
+ * for putting its speed back after something else has changed it.
+ * 
+ * @param[in] world        A pointer to the world structure.
+ * @param[in] entityID     The entity, which must have a movement component.
+ *
+ * @return The default top speed, scaled by an active speed up or speed down.
+ *
+ * @designer
+ * @author
+ */
+float powerup_max_speed(World * world, unsigned int entityID) {
+	float speed = world->movement[entityID].defMaxSpeed;
+	
+	if (IN_THIS_COMPONENT(world->mask[entityID], COMPONENT_POWERUP)) {
+		switch(world->powerup[entityID].type) {
+			case PU_SPEED_UP:
+				return speed * 1.5;
+			case PU_SPEED_DOWN:
+				return speed * 0.5;
+		}
+	}
+	return speed;
+}
@@ -8,6 +8,7 @@ void powerup_speedup(World * world, unsigned int entityID);
 void powerup_speeddown(World * world, unsigned int entityID);
 void powerup_beltright(World * world, unsigned int entityID);
 void powerup_beltleft(World * world, unsigned int entityID);
+float powerup_max_speed(World * world, unsigned int entityID);
 
 #endif
 
@@ -0,0 +1,183 @@
+/** @ingroup Gameplay */
+/** @{ */
+/**
+ * Keeps the local player's recent steps so its movement can be predicted ahead of
+ * the server and corrected when the server disagrees.
+ *
+ * Every simulation step of the local player is numbered and kept with the direction
+ * commands it ran with and where it left the player. The number goes out with each
+ * position update, and the server sends back the last number it applied along with
+ * where it has the player. If that is not where the step left the player, the player
+ * is put back where the server says and the steps since are run again on top of it.
+ * The difference is drawn on top of the corrected position and eased out, so the
+ * player doesn't visibly jump.
+ *
+ * @file prediction.cpp
+ */
+/** @} */
+#include "prediction.h"
+#include "systems.h"
+#include "../view.h"
+#include <math.h>
+#include <string.h>
+
+#define PREDICTION_HISTORY		128		/**< Steps kept, a little over two seconds. Must be a power of two. */
+#define PREDICTION_TOLERANCE	4.0f	/**< How far the server may be off before a correction; positions are sent to 2 pixels. */
+#define PREDICTION_EASE			0.8f	/**< How much of a correction is still drawn after each step. */
+#define PREDICTION_SETTLED		0.05f	/**< A correction smaller than this is dropped. */
+
+/**
+ * One predicted step of the local player.
+ *
+ * @struct PredictedStep
+ */
+typedef struct {
+	seq_t	seq;						/**< The step's number, 0 if the slot is empty. */
+	bool	commands[NUM_COMMANDS];		/**< The commands the step ran with. */
+	float	x;							/**< Where the step left the player. */
+	float	y;
+} PredictedStep;
+
+static PredictedStep history[PREDICTION_HISTORY];	/**< The recent steps, by number. */
+static seq_t last_seq = 0;							/**< The number of the last step kept, 0 if none. */
+static seq_t last_ack = 0;							/**< The last step the server said it applied, 0 if none. */
+
+/**
+ * Keeps the step the local player has just taken and eases out what is left of the
+ * last correction. Called once at the end of every movement step.
+ *
+ * @param[in, out]	world	A pointer to the world struct.
+ * @param[in]		entity	The local player.
+ *
+ * @designer
+ * @author
+ */
+void record_prediction(World * world, unsigned int entity)
+{
+	MovementComponent *movement;
+	PredictedStep *step;
+
+	if (entity >= world->capacity || !IN_THIS_COMPONENT(world->mask[entity], COMPONENT_POSITION | COMPONENT_MOVEMENT | COMPONENT_CONTROLLABLE))
+		return;
+
+	movement = &(world->movement[entity]);
+	movement->offsetX *= PREDICTION_EASE;
+	movement->offsetY *= PREDICTION_EASE;
+	if (fabsf(movement->offsetX) < PREDICTION_SETTLED && fabsf(movement->offsetY) < PREDICTION_SETTLED)
+	{
+		movement->offsetX = 0;
+		movement->offsetY = 0;
+	}
+
+	//0 means no step, so it is skipped when the numbers wrap
+	if (++last_seq == 0)
+		last_seq = 1;
+
+	step = &history[last_seq & (PREDICTION_HISTORY - 1)];
+	step->seq = last_seq;
+	memcpy(step->commands, world->command[entity].commands, sizeof(step->commands));
+	step->x = world->position[entity].x;
+	step->y = world->position[entity].y;
+}
+
+/**
+ * Gets the number of the last step the local player took, to send with its position.
+ *
+ * @return The step number, or 0 if there hasn't been one.
+ *
+ * @designer
+ * @author
+ */
+seq_t prediction_sequence()
+{
+	return last_seq;
+}
+
+/**
+ * Checks the server's position for the local player against the step it was taken
+ * at, and if they disagree puts the player where the server says and runs the steps
+ * since again.
+ *
+ * Acknowledgements that are older than the last one, or for steps that are no longer
+ * kept, are ignored. A server that doesn't acknowledge steps always sends 0, which
+ * leaves the player where the client has it.
+ *
+ * @param[in, out]	world	A pointer to the world struct.
+ * @param[in]		entity	The local player.
+ * @param[in]		ack		The last step the server applied.
+ * @param[in]		x		Where the server has the player.
+ * @param[in]		y
+ * @param[in]		movX	The player's velocity on the server.
+ * @param[in]		movY
+ *
+ * @designer
+ * @author
+ */
+void reconcile_prediction(World * world, unsigned int entity, seq_t ack, float x, float y, float movX, float movY)
+{
+	PredictedStep *step = &history[ack & (PREDICTION_HISTORY - 1)];
+	PositionComponent *position;
+	MovementComponent *movement;
+	float drawnX, drawnY;
+	seq_t seq;
+
+	if (ack == 0 || step->seq != ack || (last_ack != 0 && (int16_t)(ack - last_ack) <= 0))
+		return;
+
+	if (entity >= world->capacity || !IN_THIS_COMPONENT(world->mask[entity], COMPONENT_POSITION | COMPONENT_MOVEMENT | COMPONENT_COLLISION))
+		return;
+
+	last_ack = ack;
+	if (fabsf(step->x - x) <= PREDICTION_TOLERANCE && fabsf(step->y - y) <= PREDICTION_TOLERANCE)
+		return;
+
+	position = &(world->position[entity]);
+	movement = &(world->movement[entity]);
+	drawnX = position->x + movement->offsetX;
+	drawnY = position->y + movement->offsetY;
+
+	position->x = x;
+	position->y = y;
+	movement->movX = movX;
+	movement->movY = movY;
+	step->x = x;
+	step->y = y;
+	update_body(world, entity);
+
+	for (seq = ack + 1; seq != (seq_t)(last_seq + 1); ++seq)
+	{
+		if (seq == 0)
+			continue;
+
+		step = &history[seq & (PREDICTION_HISTORY - 1)];
+		replay_step(world, entity, step->commands);
+		step->x = position->x;
+		step->y = position->y;
+	}
+
+	//keep drawing the player where it was and ease over to the corrected position
+	movement->offsetX = drawnX - position->x;
+	movement->offsetY = drawnY - position->y;
+}
+
+/**
+ * Forgets the local player's steps, for when it has been moved by the server and the
+ * old steps no longer apply, such as on a floor change.
+ *
+ * @param[in, out]	world	A pointer to the world struct.
+ * @param[in]		entity	The local player.
+ *
+ * @designer
+ * @author
+ */
+void reset_prediction(World * world, unsigned int entity)
+{
+	memset(history, 0, sizeof(history));
+	last_ack = 0;
+
+	if (entity < world->capacity && IN_THIS_COMPONENT(world->mask[entity], COMPONENT_MOVEMENT))
+	{
+		world->movement[entity].offsetX = 0;
+		world->movement[entity].offsetY = 0;
+	}
+}
@@ -0,0 +1,12 @@
+#ifndef PREDICTION_H
+#define PREDICTION_H
+
+#include "../world.h"
+#include "../Network/Packets.h"
+
+void record_prediction(World * world, unsigned int entity);
+seq_t prediction_sequence();
+void reconcile_prediction(World * world, unsigned int entity, seq_t ack, float x, float y, float movX, float movY);
+void reset_prediction(World * world, unsigned int entity);
+
+#endif
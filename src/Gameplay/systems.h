@@ -12,9 +12,11 @@
 #include "../world.h"
 void add_force(World* world, unsigned int entity, float magnitude, float dir);
 void apply_force(World* world, unsigned int entity);
-void movement_system(World* world, FPS fps, int sendpipe);
+void movement_system(World* world, PacketRing *send_ring);
+void step_position(World* world, unsigned int entity, float alpha, float* x, float* y);
+void replay_step(World* world, unsigned int entity, const bool* commands);
 void update_system(World* world);
-void handle_entity_collision(World* world, unsigned int entity, unsigned int entity_number, unsigned int tile_number, unsigned int hit_entity);
+bool trigger_event(World* world, unsigned int entity, const TriggerEvent* trigger);
 void add_force_acceleration_x(MovementComponent& movement, float magnitude, float dir, float friction);
 void add_force_acceleration_y(MovementComponent& movement, float magnitude, float dir, float friction);
 
@@ -11,10 +11,11 @@
 #include "../sound.h"
 #include "../Input/menu.h"
 #include "../triggered.h"
+#include "../view.h"
 
 #include <stdlib.h>
 
-#define SYSTEM_MASK (COMPONENT_RENDER_PLAYER | COMPONENT_ANIMATION) /**< The entity must have a animation and render component */
+typedef View<RenderPlayerComponent, AnimationComponent> SystemView; /**< The entity must have a animation and render component */
 
 /**
  * Updates animations
@@ -38,16 +39,21 @@
 void animation_system(World *world) {
 
 	unsigned int entity;
+	unsigned int i;
+	SystemView				entities(world);
 	AnimationComponent 		*animationComponent;
 	RenderPlayerComponent 	*renderPlayer;
 
 	Animation *animation;
-	for(entity = 0; entity < MAX_ENTITIES; entity++){
+	
+	for(i = 0; i < entities.size(); i++){
+		entity = entities[i];
 
-		if (IN_THIS_COMPONENT(world->mask[entity], SYSTEM_MASK)){
+		//animation_end can tear down the world while we are walking it
+		if (entities.has(entity)){
 
-			animationComponent = &(world->animation[entity]);
-			renderPlayer = &(world->renderPlayer[entity]);
+			animationComponent = &entities.get<AnimationComponent>(entity);
+			renderPlayer = &entities.get<RenderPlayerComponent>(entity);
 
 			if (animationComponent->current_animation > -1) {
 
@@ -105,20 +111,29 @@ void animation_system(World *world) {
 }
 
 /**
- * This loads in an animation text file to create an animated component.
+ * Allocates memory for an animation from the arena, or from the heap if there is no arena.
+ *
+ * @param arena The arena, or NULL.
+ * @param size  The number of bytes needed.
+ *
+ * @return The memory.
+ */
+static void *animation_alloc(Arena *arena, size_t size) {
+	return arena ? arena_alloc(arena, size) : malloc(size);
+}
+
+/**
+ * Loads an animation text file into an entity's animation component.
  *
  * @param filename The filename of the animation text file
  * @param world Pointer to the world structure (contains "world" info, entities / components)
  * @param entity The entity to create the animation for
+ * @param arena Where the animation arrays are allocated from, or NULL for the heap
  *
  * @designer Jordan Marling
- * @designer Mat Siwoski
- * @designer Damien Sathanielle
- *
  * @author Jordan Marling
- * @author Damien Sathanielle
  */
-int load_animation(const char *filename, World *world, unsigned int entity) {
+static int load_animation_from(const char *filename, World *world, unsigned int entity, Arena *arena) {
 	AnimationComponent *animationComponent = &(world->animation[entity]);
 	RenderPlayerComponent *renderComponent = &(world->renderPlayer[entity]);
 
@@ -144,7 +159,8 @@ int load_animation(const char *filename, World *world, unsigned int entity) {
 		return -1;
 	}
 
-	animationComponent->animations = (Animation*)malloc(sizeof(Animation) * animationComponent->animation_count);
+	animationComponent->animations = (Animation*)animation_alloc(arena, sizeof(Animation) * animationComponent->animation_count);
+	animationComponent->floor = (arena != NULL);
 	animationComponent->current_animation = -1;
 	animationComponent->id = -1;
 
@@ -157,7 +173,7 @@ int load_animation(const char *filename, World *world, unsigned int entity) {
 			return -1;
 		}
 
-		animationComponent->animations[animation_index].surfaces = (SDL_Surface**)malloc(sizeof(SDL_Surface*) * animation_frames);
+		animationComponent->animations[animation_index].surfaces = (SDL_Surface**)animation_alloc(arena, sizeof(SDL_Surface*) * animation_frames);
 
 		animationComponent->animations[animation_index].surface_count = animation_frames;
 		if (strcmp(triggered_sound, "-1") == 0) {
@@ -172,7 +188,7 @@ int load_animation(const char *filename, World *world, unsigned int entity) {
 		animationComponent->animations[animation_index].index = 0;
 		animationComponent->animations[animation_index].sound_enabled = true;
 		
-		animationComponent->animations[animation_index].name = (char*)malloc(sizeof(char) * strlen(animation_name) + 1);
+		animationComponent->animations[animation_index].name = (char*)animation_alloc(arena, sizeof(char) * strlen(animation_name) + 1);
 		strcpy(animationComponent->animations[animation_index].name, animation_name);
 
 		for (frame_index = 0; frame_index < animation_frames; frame_index++) {
@@ -233,6 +249,40 @@ int load_animation(const char *filename, World *world, unsigned int entity) {
 	return 0;
 }
 
+/**
+ * This loads in an animation text file to create an animated component.
+ *
+ * @param filename The filename of the animation text file
+ * @param world Pointer to the world structure (contains "world" info, entities / components)
+ * @param entity The entity to create the animation for
+ *
+ * @designer Jordan Marling
+ * @designer Mat Siwoski
+ * @designer Damien Sathanielle
+ *
+ * @author Jordan Marling
+ * @author Damien Sathanielle
+ */
+int load_animation(const char *filename, World *world, unsigned int entity) {
+	return load_animation_from(filename, world, entity, NULL);
+}
+
+/**
+ * Loads an animation for an entity that belongs to the current floor. The animation
+ * arrays come from the floor arena and are released with the floor, not by
+ * destroy_entity; the surfaces are still freed with the entity.
+ *
+ * @param filename The filename of the animation text file
+ * @param world Pointer to the world structure (contains "world" info, entities / components)
+ * @param entity The entity to create the animation for
+ *
+ * @designer
+ * @author
+ */
+int load_floor_animation(const char *filename, World *world, unsigned int entity) {
+	return load_animation_from(filename, world, entity, &world->floor_arena);
+}
+
 /**
  * This cancels an entities animation and freezes it on the first frame specified by the animation_name
  *
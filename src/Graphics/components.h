@@ -88,6 +88,7 @@ typedef struct {
 	int rand_occurance_max; //the maximum time delay for a random animation
 	unsigned int last_random_occurance; //the last time the random animation was played
 	unsigned int next_random_occurance; //the next time the random animation is played
+	bool floor; //the animation arrays come from the floor arena and are released with the floor
 } AnimationComponent;
 
 
@@ -11,10 +11,11 @@
 #include "../sound.h"
 #include "../Input/menu.h"
 #include "../triggered.h"
+#include "../view.h"
 
 #include <stdlib.h>
 
-#define SYSTEM_MASK (COMPONENT_POSITION | COMPONENT_ANIMATION | COMPONENT_CUTSCENE) /**< The entity must have a animation and render component */
+typedef View<PositionComponent, AnimationComponent, CutsceneComponent> SystemView; /**< The entity must have a animation and render component */
 
 void start_cutscene_section(int id, World *world, unsigned int entity);
 
@@ -42,6 +43,9 @@ void start_cutscene_section(int id, World *world, unsigned int entity);
 void cutscene_system(World *world) {
 	
 	unsigned int entity;
+	unsigned int i;
+	SystemView entities(world);
+	EntityHandle handle;
 	
 	PositionComponent *position;
 	CutsceneComponent *cutscene;
@@ -52,12 +56,14 @@ void cutscene_system(World *world) {
 	float x_start, y_start;
 	float x_diff, y_diff;
 	
-	for(entity = 0; entity < MAX_ENTITIES; entity++) {
+	for(i = 0; i < entities.size(); i++) {
+		entity = entities[i];
 		
-		if (IN_THIS_COMPONENT(world->mask[entity], SYSTEM_MASK)) {
+		//cutscene_end can tear down the world while we are walking it
+		if (entities.has(entity)) {
 			
-			position = &world->position[entity];
-			cutscene = &world->cutscene[entity];
+			position = &entities.get<PositionComponent>(entity);
+			cutscene = &entities.get<CutsceneComponent>(entity);
 			
 			section = &cutscene->sections[cutscene->current_section];
 			
@@ -70,8 +76,11 @@ void cutscene_system(World *world) {
 				//check to see if the cutscene is over
 				if (cutscene->current_section >= cutscene->num_sections) {
 					
+					handle = entity_handle(world, entity);
 					cutscene_end(world, entity);
-					destroy_entity(world, entity);
+					
+					//cutscene_end may have destroyed the entity already and handed its slot out again
+					defer_destroy(world, entity_from_handle(world, handle));
 					//printf("Destroyed entity\n");
 					
 					continue;
@@ -81,10 +90,10 @@ void cutscene_system(World *world) {
 				
 				//If the animation name is 0, don't render
 				if (strcmp(cutscene->sections[cutscene->current_section].animation_name, "0") == 0) {
-					disable_component(world, entity, COMPONENT_RENDER_PLAYER);
+					defer_disable(world, entity, COMPONENT_RENDER_PLAYER);
 				}
 				else {
-					enable_component(world, entity, COMPONENT_RENDER_PLAYER);
+					defer_enable(world, entity, COMPONENT_RENDER_PLAYER);
 					play_animation(world, entity, cutscene->sections[cutscene->current_section].animation_name);
 				}
 				cutscene->sections[cutscene->current_section].start_ms = SDL_GetTicks();
@@ -141,7 +150,7 @@ void cutscene_system(World *world) {
 unsigned int load_cutscene(const char *filename, World *world, int id) {
 	
 	unsigned int entity = create_entity(world, COMPONENT_POSITION | COMPONENT_RENDER_PLAYER | COMPONENT_ANIMATION | COMPONENT_CUTSCENE);
-	CutsceneComponent *cutscene = &world->cutscene[entity];
+	CutsceneComponent *cutscene;
 	
 	FILE *fp;
 	
@@ -152,6 +161,11 @@ unsigned int load_cutscene(const char *filename, World *world, int id) {
 	
 	int i;
 	
+	if (entity == MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	cutscene = &world->cutscene[entity];
+	
 	if ((fp = fopen(filename, "r")) == 0) {
 		printf("Error opening cutscene: %s\n", filename);
 		return MAX_ENTITIES;
@@ -12,6 +12,7 @@
 #include <stdlib.h>
 
 #include "map.h"
+#include "../Gameplay/level.h"
 
 
 extern SDL_Rect map_rect;
@@ -742,16 +743,9 @@ int set_visibility(PositionComponent *newposition, FowPlayerPosition *fowp, int
 
 	*newposition =  set_newposition(pos, yDel, xDel);
 	
-	int curlevel = -1;
+	LevelComponent *curlevel = find_level(world, newposition->level);
 	
-	for (int i = 0; i < MAX_ENTITIES; i++) {
-		if (((world->mask[i] & LEVEL_MASK) != 0) && world->level[i].levelID == newposition->level) {
-			curlevel = i;
-			break;
-		}
-	}
-	
-	if (curlevel == -1) {
+	if (curlevel == NULL) {
 		return false;
 	}
 	
@@ -763,7 +757,7 @@ int set_visibility(PositionComponent *newposition, FowPlayerPosition *fowp, int
 		fow -> tilesVisibleToControllablePlayerCount++;
 	}	
 	
-	if(x >= 0 && y >= 0 && y < world->level[ curlevel ].height && x < world->level[ curlevel ].width)
+	if(x >= 0 && y >= 0 && y < curlevel->height && x < curlevel->width)
 		fow -> tiles[y][x].visible[ pos->level ] = visType;
 		
 		return true;
@@ -827,25 +821,18 @@ int set_visibility_type(FowPlayerPosition *fowp, int y, int x)
  */
 int is_wall_collision(World *world, PositionComponent newposition)
 {
-	int curlevel = -1;
-	
-	for (int i = 0; i < MAX_ENTITIES; i++) {
-		if (((world->mask[i] & LEVEL_MASK) != 0) && world->level[i].levelID == newposition.level) {
-			curlevel = i;
-			break;
-		}
-	}
+	LevelComponent *curlevel = find_level(world, newposition.level);
 	
-	if (curlevel == -1) {
+	if (curlevel == NULL) {
 		return false;
 	}
 	
-	int x = newposition.x / world->level[curlevel].tileSize;
-	int y = newposition.y / world->level[curlevel].tileSize;
+	int x = newposition.x / curlevel->tileSize;
+	int y = newposition.y / curlevel->tileSize;
 	
-	if(x >= 0 && y >= 0 && y < world->level[curlevel].height && x < world->level[curlevel].width)
+	if(x >= 0 && y >= 0 && y < curlevel->height && x < curlevel->width)
 	{
-		if (world->level[curlevel].map[x][y] == L_WALL) 
+		if (level_wall(curlevel, x, y)) 
 		{
 			return COLLISION_WALL;
 		}
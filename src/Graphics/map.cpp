@@ -16,6 +16,7 @@
 
 #include "map.h"
 #include "systems.h"
+#include "../Gameplay/systems.h"
 #include "../sound.h"
 
 
@@ -24,12 +25,16 @@ SDL_Rect map_rect;        /**< The rectangle containing the map. */
 int w;                    /**< The map's width. */
 int h;                    /**< The map's height. */
 int level;                /**< The current floor. */
+extern float step_alpha;
 
 /**
  * Initiates the map by loading the tiles and putting it into one large texture.
  * 
  * Tiles are loaded from the array.
  *
+ * Everything allocated while loading comes from the floor arena, so it is all
+ * released at once when the floor is torn down, including on the early returns.
+ *
  * Revisions:
  *     -# March 10th - Jordan Marling: Implemented reading in the file correctly for the Stairs, 
  *    able to now set the location of the stairs & where the stairs will push the player to.
@@ -56,10 +61,10 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 	
 	int width, height;
 	int x, y, i;
-	int **collision_map;
+	int *collision_map;
 	int **map;
 
-	char *entity_type = (char*)malloc(sizeof(char) * 128);
+	char *entity_type = (char*)arena_alloc(&world->floor_arena, sizeof(char) * 128);
 	int entity_count;
 	
 	
@@ -67,7 +72,7 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 	int *collision;
 	int num_tiles;
 	int pos = 0;
-	char *tile_filename = (char*)malloc(sizeof(char) * 128);
+	char *tile_filename = (char*)arena_alloc(&world->floor_arena, sizeof(char) * 128);
 	
 	SDL_Rect tile_rect;
 	
@@ -86,11 +91,11 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 		return -1;
 	}
 	
-	if ((tiles = (SDL_Surface**)malloc(sizeof(SDL_Surface*) * num_tiles)) == 0) {
+	if ((tiles = (SDL_Surface**)arena_alloc(&world->floor_arena, sizeof(SDL_Surface*) * num_tiles)) == 0) {
 		printf("Error mallocing tile surfaces\n");
 		return -1;
 	}
-	if ((collision = (int*)malloc(sizeof(int) * num_tiles)) == 0) {
+	if ((collision = (int*)arena_alloc(&world->floor_arena, sizeof(int) * num_tiles)) == 0) {
 		printf("Error mallocing tile surfaces\n");
 		return -1;
 	}
@@ -137,18 +142,16 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 		return -1;
 	}
 	
-	if ((map = (int**)malloc(sizeof(int*) * width)) == NULL) {
+	if ((map = (int**)arena_alloc(&world->floor_arena, sizeof(int*) * width)) == NULL) {
 		printf("malloc failed\n");
 	}
-	if ((collision_map = (int**)malloc(sizeof(int*) * width)) == NULL) {
+	if ((collision_map = (int*)arena_alloc(&world->floor_arena, sizeof(int) * width * height)) == NULL) {
 		printf("malloc failed\n");
+		return -1;
 	}
 	
 	for (i = 0; i < width; i++) {
-		if ((map[i] = (int*)malloc(sizeof(int) * height)) == NULL) {
-			printf("malloc failed\n");
-		}
-		if ((collision_map[i] = (int*)malloc(sizeof(int) * height)) == NULL) {
+		if ((map[i] = (int*)arena_alloc(&world->floor_arena, sizeof(int) * height)) == NULL) {
 			printf("malloc failed\n");
 		}
 	}
@@ -167,7 +170,7 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 				printf("Using tile %u that is bigger than %d\n", map[x][y], num_tiles);
 			}
 			
-			collision_map[x][y] = collision[map[x][y]];
+			collision_map[y * width + x] = collision[map[x][y]];
 		}
 	}
 	
@@ -196,19 +199,19 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 				switch (dir) { // make the hitboxes for the stairs
 					case 'l':
 						create_stair(world, floor, targetX * TILE_WIDTH + TILE_WIDTH / 2, targetY * TILE_HEIGHT + TILE_HEIGHT / 2, x * TILE_WIDTH + TILE_WIDTH / 2 - 5, y * TILE_HEIGHT + TILE_HEIGHT / 2, 4, 4, level);
-						create_block(world, x * TILE_WIDTH + 7, y * TILE_HEIGHT + TILE_HEIGHT / 2, 10, TILE_HEIGHT - 4, floor);
+						create_block(world, x * TILE_WIDTH + 7, y * TILE_HEIGHT + TILE_HEIGHT / 2, 10, TILE_HEIGHT - 4, level);
 						break;
 					case 'r':
 						create_stair(world, floor, targetX * TILE_WIDTH + TILE_WIDTH / 2, targetY * TILE_HEIGHT + TILE_HEIGHT / 2, x * TILE_WIDTH + TILE_WIDTH / 2 + 5, y * TILE_HEIGHT + TILE_HEIGHT / 2, 4, 4, level);
-						create_block(world, x * TILE_WIDTH + TILE_WIDTH - 7, y * TILE_HEIGHT + TILE_HEIGHT / 2, 10, TILE_HEIGHT - 4, floor);
+						create_block(world, x * TILE_WIDTH + TILE_WIDTH - 7, y * TILE_HEIGHT + TILE_HEIGHT / 2, 10, TILE_HEIGHT - 4, level);
 						break;
 					case 'u':
 						create_stair(world, floor, targetX * TILE_WIDTH + TILE_WIDTH / 2, targetY * TILE_HEIGHT + TILE_HEIGHT / 2, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + TILE_HEIGHT / 2 - 5, 4, 4, level);
-						create_block(world, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + 7, TILE_WIDTH - 4, 10, floor);
+						create_block(world, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + 7, TILE_WIDTH - 4, 10, level);
 						break;
 					case 'd':
 						create_stair(world, floor, targetX * TILE_WIDTH + TILE_WIDTH / 2, targetY * TILE_HEIGHT + TILE_HEIGHT / 2, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + TILE_HEIGHT / 2 + 5, 4, 4, level);
-						create_block(world, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + TILE_HEIGHT - 7, TILE_WIDTH - 4, 10, floor);
+						create_block(world, x * TILE_WIDTH + TILE_WIDTH / 2, y * TILE_HEIGHT + TILE_HEIGHT - 7, TILE_WIDTH - 4, 10, level);
 						break;
 				}
 			}
@@ -217,8 +220,8 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 				unsigned int entity;
 				float x, y;
 				int w, h;
-				char *animation_name = (char*)malloc(sizeof(char) * 64);
-				char *animation_filename = (char*)malloc(sizeof(char) * 64);
+				char *animation_name = (char*)arena_alloc(&world->floor_arena, sizeof(char) * 64);
+				char *animation_filename = (char*)arena_alloc(&world->floor_arena, sizeof(char) * 64);
 				
 				if (fscanf(fp_map, "%f %f %d %d %s %s", &x, &y, &w, &h, animation_filename, animation_name) != 6) {
 					printf("Error loading object!\n");
@@ -226,6 +229,10 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 				}
 				
 				entity = create_entity(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION | COMPONENT_COLLISION);
+				if (entity == MAX_ENTITIES) {
+					printf("Error creating object!\n");
+					return -1;
+				}
 				
 				//printf("Loading object %d (%f, %f) [%s] %s\n", entity, x, y, animation_name, animation_filename);
 				
@@ -234,6 +241,7 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 				
 				world->position[entity].width = w;
 				world->position[entity].height = h;
+				world->position[entity].level = level;
 				
 				world->renderPlayer[entity].width = w;
 				world->renderPlayer[entity].height = h;
@@ -245,12 +253,9 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 				world->collision[entity].active = true;
 				world->collision[entity].radius = 0;
 				
-				load_animation(animation_filename, world, entity);
+				load_floor_animation(animation_filename, world, entity);
 				play_animation(world, entity, animation_name);
 				
-				free(animation_name);
-				free(animation_filename);
-				
 			}
 			else if (strcmp(entity_type, "sound") == 0) {
 				
@@ -271,7 +276,7 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 				float x, y;
 				int w, h;
 				unsigned int id, entity = -1;
-				char *animation_filename = (char*)malloc(sizeof(char) * 64);
+				char *animation_filename = (char*)arena_alloc(&world->floor_arena, sizeof(char) * 64);
 				
 				if (fscanf(fp_map, "%f %f %d %d %u %s", &x, &y, &w, &h, &id, animation_filename) != 6) {
 					printf("Error loading objective!\n");
@@ -285,23 +290,22 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 					return -1;
 				}
 				
-				world->mask[entity] |= COMPONENT_ANIMATION | COMPONENT_RENDER_PLAYER;
+				enable_component(world, entity, COMPONENT_ANIMATION | COMPONENT_RENDER_PLAYER);
 				
 				world->renderPlayer[entity].width = w;
 				world->renderPlayer[entity].height = h;
 				
-				load_animation(animation_filename, world, entity);
+				load_floor_animation(animation_filename, world, entity);
 				play_animation(world, entity, "not_captured");
 				
 				//printf("Loaded objective: %u\n", entity);
 				
-				free(animation_filename);
 			}
 			else if (strcmp(entity_type, "powerup") == 0) {
 				float x, y;
 				int w, h, type;
 				unsigned int entity = -1;
-				char *animation_filename = (char*)malloc(sizeof(char) * 128);
+				char *animation_filename = (char*)arena_alloc(&world->floor_arena, sizeof(char) * 128);
 				
 				if (fscanf(fp_map, "%f %f %d %d %d %s", &x, &y, &w, &h, &type, animation_filename) != 6) {
 					printf("Error loading powerup!\n");
@@ -313,22 +317,21 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 					printf("exceeded max entities.\n");
 					return -1;
 				}
-				world->mask[entity] |= COMPONENT_ANIMATION | COMPONENT_RENDER_PLAYER;
+				enable_component(world, entity, COMPONENT_ANIMATION | COMPONENT_RENDER_PLAYER);
 				world->renderPlayer[entity].width = w;
 				world->renderPlayer[entity].height = h;
 				
-				load_animation(animation_filename, world, entity);
+				load_floor_animation(animation_filename, world, entity);
 				play_animation(world, entity, "bounce");
 				
-				free(animation_filename);
 			}
 			else if (strcmp(entity_type, "chair") == 0) { //animated objects
 				
 				unsigned int entity;
 				float x, y;
 				int w, h;
-				char *animation_name = (char*)malloc(sizeof(char) * 64);
-				char *animation_filename = (char*)malloc(sizeof(char) * 64);
+				char *animation_name = (char*)arena_alloc(&world->floor_arena, sizeof(char) * 64);
+				char *animation_filename = (char*)arena_alloc(&world->floor_arena, sizeof(char) * 64);
 				
 				if (fscanf(fp_map, "%f %f %d %d %s %s", &x, &y, &w, &h, animation_filename, animation_name) != 6) {
 					printf("Error loading chair!\n");
@@ -336,6 +339,10 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 				}
 				
 				entity = create_entity(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION);
+				if (entity == MAX_ENTITIES) {
+					printf("Error creating chair!\n");
+					return -1;
+				}
 				
 				//printf("Loading object %d (%f, %f) [%s] %s\n", entity, x, y, animation_name, animation_filename);
 				
@@ -344,16 +351,14 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 				
 				world->position[entity].width = w;
 				world->position[entity].height = h;
+				world->position[entity].level = level;
 				
 				world->renderPlayer[entity].width = w;
 				world->renderPlayer[entity].height = h;
 				
-				load_animation(animation_filename, world, entity);
+				load_floor_animation(animation_filename, world, entity);
 				play_animation(world, entity, animation_name);
 				
-				free(animation_name);
-				free(animation_filename);
-				
 			}
 			else {
 				printf("Did not deal with the entity type: %s\n", entity_type);
@@ -397,20 +402,8 @@ int map_init(World* world, const char *file_map, const char *file_tiles) {
 	
 	
 	create_level(world, collision_map, width, height, TILE_WIDTH, level);
+	bake_static_colliders(world, level);
 
-	for (i = 0; i < width; i++) {
-		free(map[i]);
-		free(collision_map[i]);
-	}
-	free(map);
-	free(collision_map);
-	
-	
-	free(tiles);
-	free(collision);
-	
-	free(entity_type);
-	free(tile_filename);
 
 	return 0;
 }
@@ -447,9 +440,13 @@ void cleanup_map() {
 void map_render(SDL_Surface *surface, World *world, unsigned int player_entity) {
 	
 	SDL_Rect tempRect;
+	float drawX, drawY;
+	
+	//follow the player where they are drawn, between simulation steps
+	step_position(world, player_entity, step_alpha, &drawX, &drawY);
 	
-	int playerXPosition = world->position[player_entity].x;
-	int playerYPosition = world->position[player_entity].y;
+	int playerXPosition = drawX;
+	int playerYPosition = drawY;
 	int playerWidth = world->position[player_entity].width;
 	int playerHeight = world->position[player_entity].height;
 	
@@ -9,15 +9,19 @@
 #include "../world.h"
 #include "components.h"
 #include "systems.h"
+#include "../Gameplay/systems.h"
 #include "text.h"
 #include "../Input/menu.h"
+#include "../view.h"
 
 static void render_opponent_players(World& world, SDL_Surface *surface, FowComponent *fow, SDL_Rect map_rect);
 static int opponentPlayers[32];
 static int opponentPlayersCount = 0;
 extern int curlevel;
-#define SYSTEM_MASK (COMPONENT_RENDER_PLAYER | COMPONENT_POSITION) /**< The entity must have a render player and position component
-                                                                    * for processing by this system. */
+extern float step_alpha;
+typedef View<RenderPlayerComponent, PositionComponent> SystemView; /**< The entity must have a render player and position component
+                                                                   * for processing by this system. */
+typedef View<RenderPlayerComponent, PositionComponent, MenuItemTag> MenuView; /**< Menu items are drawn by the menu system. */
 
 extern SDL_Rect map_rect; /**< The rectangle containing the map. */
 SDL_Surface *ibeam;
@@ -50,30 +54,36 @@ SDL_Surface *ibeam;
 void render_player_system(World& world, SDL_Surface* surface, FowComponent *fow) {
 	
 	unsigned int entity;
+	unsigned int i;
+	View<PlayerComponent, ControllableComponent> controllable(&world);
+	SystemView			entities(&world);
 	RenderPlayerComponent 	*renderPlayer;
 	PositionComponent 	*position;
 	SDL_Rect playerRect;
+	float drawX, drawY;
 	
 	SDL_Rect clipRect;
 
 	opponentPlayersCount = 0;
 	memset(opponentPlayers, 0, sizeof(opponentPlayers));
 
+	for(i = 0; i < controllable.size(); i++) {
+		fow->teamNo = controllable.get<PlayerComponent>(controllable[i]).teamNo;
+	}
 
-	for(entity = 0; entity < MAX_ENTITIES; entity++){
-		
-		if(IN_THIS_COMPONENT(world.mask[entity], COMPONENT_PLAYER | COMPONENT_CONTROLLABLE)) {
-			fow->teamNo = world.player[entity].teamNo;
-		}
-
+	//views are in entity order, so the layering doesn't depend on the order of the sets
+	for(i = 0; i < entities.size(); i++){
+		entity = entities[i];
 
-		if (IN_THIS_COMPONENT(world.mask[entity], SYSTEM_MASK) && !IN_THIS_COMPONENT(world.mask[entity], COMPONENT_MENU_ITEM)){
+		if (!IN_THIS_COMPONENT(world.mask[entity], COMPONENT_MENU_ITEM)){
 			
-			position = &(world.position[entity]);
-			renderPlayer = &(world.renderPlayer[entity]);
+			position = &entities.get<PositionComponent>(entity);
+			renderPlayer = &entities.get<RenderPlayerComponent>(entity);
 			
-			playerRect.x = position->x + map_rect.x;
-			playerRect.y = position->y + map_rect.y;
+			step_position(&world, entity, step_alpha, &drawX, &drawY);
+			
+			playerRect.x = drawX + map_rect.x;
+			playerRect.y = drawY + map_rect.y;
 			playerRect.w = renderPlayer->width;
 			playerRect.h = renderPlayer->height;
 			
@@ -180,9 +190,12 @@ void render_opponent_players(World& world, SDL_Surface *surface, FowComponent *f
 
 		SDL_Rect playerRect;
 		SDL_Rect clipRect;
+		float drawX, drawY;
+
+		step_position(&world, opponentPlayers[entity], step_alpha, &drawX, &drawY);
 
-		playerRect.x = position->x + map_rect.x - 20;
-		playerRect.y = position->y + map_rect.y - 20 ;
+		playerRect.x = drawX + map_rect.x - 20;
+		playerRect.y = drawY + map_rect.y - 20 ;
 		playerRect.w = renderPlayer->width;
 		playerRect.h = renderPlayer->height;
 
@@ -236,53 +249,53 @@ void render_menu_system(World *world, SDL_Surface *surface) {
 	PositionComponent 	*position;
 	TextFieldComponent *text;
 	SDL_Rect menu_rect;
+	unsigned int i;
+	MenuView entities(world);
 	
-	for(entity = 0; entity < MAX_ENTITIES; entity++){
+	for(i = 0; i < entities.size(); i++){
+		entity = entities[i];
 		
-		if (IN_THIS_COMPONENT(world->mask[entity], SYSTEM_MASK | COMPONENT_MENU_ITEM)) {
-			
-			position = &(world->position[entity]);
-			renderPlayer = &(world->renderPlayer[entity]);
-			
-			
-			menu_rect.x = position->x;
-			menu_rect.y = position->y;
-			menu_rect.w = renderPlayer->width;
-			menu_rect.h = renderPlayer->height;
+		position = &entities.get<PositionComponent>(entity);
+		renderPlayer = &entities.get<RenderPlayerComponent>(entity);
+		
+		
+		menu_rect.x = position->x;
+		menu_rect.y = position->y;
+		menu_rect.w = renderPlayer->width;
+		menu_rect.h = renderPlayer->height;
+		
+		if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_BUTTON)) {
 			
-			if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_BUTTON)) {
-				
-				if (world->button[entity].hovered) {
-					menu_rect.x -= 5;
-					menu_rect.y -= 5;
-					menu_rect.w += 10;
-					menu_rect.h += 10;
-				}
+			if (world->button[entity].hovered) {
+				menu_rect.x -= 5;
+				menu_rect.y -= 5;
+				menu_rect.w += 10;
+				menu_rect.h += 10;
 			}
+		}
+		
+		SDL_BlitScaled(renderPlayer->playerSurface, NULL, surface, &menu_rect);
+		
+		
+	
+		//check if a textbox.
+		if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_TEXTFIELD)) {
 			
-			SDL_BlitScaled(renderPlayer->playerSurface, NULL, surface, &menu_rect);
+			text = &(world->text[entity]);
 			
+			menu_rect.x += 10;
+			menu_rect.y += 8;
 			
-		
-			//check if a textbox.
-			if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_TEXTFIELD)) {
-				
-				text = &(world->text[entity]);
-				
-				menu_rect.x += 10;
-				menu_rect.y += 8;
-				
-				//TODO: Store the text in a component instead of creating it every frame.
-				//Perhaps we should store it in the renderPlayer component and draw the
-				//textbox if it has a text field component?
-				SDL_BlitSurface(draw_text(text->text, MENU_FONT), NULL, surface, &menu_rect);
-				
-				if (text->focused) {
-					menu_rect.x += get_text_width(text->text, MENU_FONT) + 1;
-					SDL_BlitSurface(ibeam, NULL, surface, &menu_rect);
-				}
-			}	
-		}
+			//TODO: Store the text in a component instead of creating it every frame.
+			//Perhaps we should store it in the renderPlayer component and draw the
+			//textbox if it has a text field component?
+			SDL_BlitSurface(draw_text(text->text, MENU_FONT), NULL, surface, &menu_rect);
+			
+			if (text->focused) {
+				menu_rect.x += get_text_width(text->text, MENU_FONT) + 1;
+				SDL_BlitSurface(ibeam, NULL, surface, &menu_rect);
+			}
+		}	
 	}
 }
 
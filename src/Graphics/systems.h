@@ -15,6 +15,7 @@ void animation_system(World *world);
 void cutscene_system(World *world);
 
 int load_animation(const char *filename, World *world, unsigned int entity);
+int load_floor_animation(const char *filename, World *world, unsigned int entity);
 void play_animation(World *world, unsigned int entity, const char *animation_name);
 void cancel_animation(World *world, unsigned int entity);
 
@@ -199,6 +199,8 @@ void chat_render(SDL_Surface *surface) {
  *
  * @param[in, out]	world 	Pointer to WORLD (structure containing "world" information, entities/components)
  *
+ * @return The text field, or MAX_ENTITIES if the world is full.
+ *
  * @designer Jordan Marling
  * @author Jordan Marling
  *
@@ -207,6 +209,10 @@ unsigned int create_chat(World *world) {
 	
 	unsigned int entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_TEXTFIELD | COMPONENT_MOUSE);
 	
+	if (entity == MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
 	world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/screen/menu/text_field.png");
 	
 	world->renderPlayer[entity].width = CHAT_SURFACE_WIDTH;
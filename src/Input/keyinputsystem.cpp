@@ -24,8 +24,9 @@
 #include "menu.h"
 #include "../Input/chat.h"
 #include "../Network/SendSystem.h"
+#include "../view.h"
 
-#define SYSTEM_MASK (COMPONENT_COMMAND) /**< Entities with a command component will be processed by the system. */
+typedef View<CommandComponent> SystemView; /**< Entities with a command component will be processed by the system. */
 
 int GetScancode(char *character);
 
@@ -34,7 +35,7 @@ int *command_keys; /**< This is the current keycodes mapped to each command. */
 extern const char *character_map;
 extern bool running;
 extern unsigned int player_entity;
-extern int send_router_fd[];
+extern PacketRing *send_router_ring;
 
 extern int window_width, window_height;
 
@@ -59,7 +60,8 @@ extern int window_width, window_height;
  */
 void KeyInputSystem(World *world)
 {
-    int entity;
+    unsigned int entity;
+    unsigned int i;
     CommandComponent *command;
 
     SDL_Event event;
@@ -128,27 +130,24 @@ void KeyInputSystem(World *world)
 		}
     }
 	
-    for(entity = 0; entity < MAX_ENTITIES; entity++) {
+    SystemView entities(world);
+    for(i = 0; i < entities.size(); i++) {
+        entity = entities[i];
+        command = &entities.get<CommandComponent>(entity);
 
-        if ((world->mask[entity] & SYSTEM_MASK) == SYSTEM_MASK)
-        {
-            command = &(world->command[entity]);
-
-            command->commands[C_UP] = (currentKeyboardState[command_keys[C_UP]] != 0);
-            command->commands[C_LEFT] = (currentKeyboardState[command_keys[C_LEFT]] != 0);
-            command->commands[C_DOWN] = (currentKeyboardState[command_keys[C_DOWN]] != 0);
-            command->commands[C_RIGHT] = (currentKeyboardState[command_keys[C_RIGHT]] != 0);
-			command->commands[C_ACTION] = (currentKeyboardState[command_keys[C_ACTION]] != 0) && (prevKeyboardState[command_keys[C_ACTION]] == 0);
-			command->commands[C_TILE] = (currentKeyboardState[command_keys[C_TILE]] != 0) && (prevKeyboardState[command_keys[C_TILE]] == 0);
-
-        }
+        command->commands[C_UP] = (currentKeyboardState[command_keys[C_UP]] != 0);
+        command->commands[C_LEFT] = (currentKeyboardState[command_keys[C_LEFT]] != 0);
+        command->commands[C_DOWN] = (currentKeyboardState[command_keys[C_DOWN]] != 0);
+        command->commands[C_RIGHT] = (currentKeyboardState[command_keys[C_RIGHT]] != 0);
+		
+		//presses stay set until the movement system has had a step to act on them
+		command->commands[C_ACTION] = command->commands[C_ACTION] || ((currentKeyboardState[command_keys[C_ACTION]] != 0) && (prevKeyboardState[command_keys[C_ACTION]] == 0));
+		command->commands[C_TILE] = command->commands[C_TILE] || ((currentKeyboardState[command_keys[C_TILE]] != 0) && (prevKeyboardState[command_keys[C_TILE]] == 0));
     }
     
     if (player_entity < MAX_ENTITIES) {		//pause menu
 		if ((currentKeyboardState[SDL_SCANCODE_ESCAPE] != 0) && (prevKeyboardState[SDL_SCANCODE_ESCAPE] == 0)) {
-			if (IN_THIS_COMPONENT(world->mask[player_entity], COMPONENT_COMMAND)) {
-				world->mask[player_entity] ^= COMPONENT_COMMAND;
-			}
+			disable_component(world, player_entity, COMPONENT_COMMAND);
 			create_pause_screen(world);
 		}
 		
@@ -167,15 +166,21 @@ void KeyInputSystem(World *world)
 					strcat(message, world->text[textField].text);
 					
 					chat_add_line(message, PLAYER_FONT);
-					send_chat(world, send_router_fd[1], world->text[textField].text);
+					send_chat(world, send_router_ring, world->text[textField].text);
 				}
 				destroy_menu(world);
 				textField = -1;
+				enable_component(world, player_entity, COMPONENT_COMMAND);
 			}
 			else {
 				textField = create_chat(world);
+				if (textField == MAX_ENTITIES) {
+					textField = -1;
+				}
+				else {
+					disable_component(world, player_entity, COMPONENT_COMMAND);
+				}
 			}
-			world->mask[player_entity] ^= COMPONENT_COMMAND;
 		}
 	}
     
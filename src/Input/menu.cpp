@@ -19,6 +19,7 @@
 #include "../systems.h"
 #include "../sound.h"
 #include "../Network/network_systems.h"
+#include "../view.h"
 
 unsigned int background = MAX_ENTITIES + 1;
 unsigned int background_music = -1;
@@ -35,10 +36,13 @@ unsigned int background_music = -1;
  */
 void destroy_menu(World *world) {
 	unsigned int entity;
+	unsigned int i;
+	View<MenuItemTag> menu(world);
 	
-	for(entity = 0; entity < MAX_ENTITIES; entity++) {
+	for(i = 0; i < menu.size(); i++) {
+		entity = menu[i];
 		
-		if (entity != background && IN_THIS_COMPONENT(world->mask[entity], COMPONENT_MENU_ITEM)) {
+		if (entity != background) {
 			destroy_entity(world, entity);
 		}
 		
@@ -62,6 +66,10 @@ void create_button(World *world, const char *text, const char *name, int x, int
 	
 	char *new_name;
 	unsigned int entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_BUTTON | COMPONENT_MOUSE);
+	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
 
 	world->position[entity].x = x;
 	world->position[entity].y = y;
@@ -98,6 +106,10 @@ void create_label(World *world, const char *text, int x, int y) {
 	
 	unsigned int entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION);
 	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
+	
 	render_text(world, entity, text, MENU_FONT);
 	
 	world->position[entity].x = x;
@@ -125,6 +137,10 @@ void create_title(World *world, const char *text, int x, int y) {
 	
 	unsigned int entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION);
 	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
+	
 	world->position[entity].x = x;
 	world->position[entity].y = y;
 	
@@ -152,6 +168,10 @@ void create_textfield(World *world, const char *name, int x, int y, const char*
 	
 	unsigned int entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_TEXTFIELD | COMPONENT_MOUSE);
 	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
+	
 	if(big) {
 		world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/screen/menu/text_field.png");
 		
@@ -202,6 +222,11 @@ void create_animated_button(World *world, const char* fileName, int x, int y, co
 	
 	char *new_name;
 	unsigned int entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION | COMPONENT_BUTTON | COMPONENT_MOUSE);
+	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
+	
 	world->position[entity].x = x;
 	world->position[entity].y = y;
 	world->position[entity].width = ANIMATED_BUTTON_WIDTH;
@@ -243,6 +268,10 @@ void create_main_menu_background(World *world) {
 	
 	background = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION);
 	
+	if (background == MAX_ENTITIES) {
+		return;
+	}
+	
 	world->position[background].x = 0;
 	world->position[background].y = 0;
 	world->position[background].width = WIDTH;
@@ -281,6 +310,10 @@ void create_logo_screen(World* world) {
 	//create black background
 	entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION);
 	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
+	
 	world->position[entity].x = 0;
 	world->position[entity].y = 0;
 	world->position[entity].width = WIDTH;
@@ -297,6 +330,10 @@ void create_logo_screen(World* world) {
 	//create animation
 	entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION);
 	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
+	
 	world->position[entity].x = 440;
 	world->position[entity].y = 334;
 	world->position[entity].width = 400;
@@ -444,6 +481,10 @@ void create_credits_menu(World *world) {
 	
 	entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION);
 	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
+	
 	world->renderPlayer[entity].width = WIDTH;
 	world->renderPlayer[entity].height = HEIGHT;
 	world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/screen/menu/credits.png");
@@ -507,6 +548,10 @@ void create_bsod_menu(World *world) {
 	
 	entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION);
 	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
+	
 	world->renderPlayer[entity].width = WIDTH;
 	world->renderPlayer[entity].height = HEIGHT;
 	world->renderPlayer[entity].playerSurface = IMG_Load("assets/Graphics/end/blue_screen.png");
@@ -562,6 +607,10 @@ void create_load_screen(World *world) {
 	
 	entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION);
 	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
+	
 	world->position[entity].x = 0;
 	world->position[entity].y = 0;
 	world->position[entity].width = WIDTH;
@@ -596,6 +645,10 @@ void create_select_screen(World *world) {
 	
 	entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION);
 	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
+	
 	world->position[entity].x = 0;
 	world->position[entity].y = 0;
 	world->position[entity].width = WIDTH;
@@ -649,6 +702,10 @@ void create_pause_screen(World *world) {
 	
 	entity = create_entity(world, COMPONENT_MENU_ITEM | COMPONENT_RENDER_PLAYER | COMPONENT_POSITION);
 	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
+	
 	const int w = 650;
 	const int h = 600;
 	
@@ -689,7 +746,11 @@ void create_pause_screen(World *world) {
  */
 void create_van_intro(World *world, int character) {
 	
-	unsigned int entity = create_entity(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION);
+	unsigned int entity = create_ui_entity(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION);
+	
+	if (entity == MAX_ENTITIES) {
+		return;
+	}
 	
 	const int w = 1280;
 	const int h = 768;
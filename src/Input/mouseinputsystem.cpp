@@ -13,9 +13,10 @@
 #include "../Graphics/map.h"
 #include "../sound.h"
 #include "../triggered.h"
+#include "../view.h"
 
-#define SYSTEM_MASK (COMPONENT_MOUSE) /**< Entities must have a mouse component to be processed by this system. */
-#define ANIMATION_MASK (COMPONENT_ANIMATION | COMPONENT_POSITION)
+typedef View<MouseComponent> SystemView; /**< Entities must have a mouse component to be processed by this system. */
+typedef View<AnimationComponent, PositionComponent> AnimationView; /**< Entities that can play an animation on hover. */
 
 int textField = -1;
 extern int window_width, window_height;
@@ -35,7 +36,9 @@ extern int window_width, window_height;
  */
 void MouseInputSystem(World *world)
 {
-    int entity, e, x, y;
+    unsigned int entity, e;
+    unsigned int i, j;
+    int x, y;
     static Uint32 previousState = 0;
     static Uint32 currentState = 0;
     bool rclick, lclick, text_field_pressed = false;
@@ -62,12 +65,15 @@ void MouseInputSystem(World *world)
         textField = -1;
     }
 
-    for(entity = 0; entity < MAX_ENTITIES; entity++)
+    SystemView entities(world);
+    for(i = 0; i < entities.size(); i++)
     {
+        entity = entities[i];
 
-        if ((world->mask[entity] & SYSTEM_MASK) == SYSTEM_MASK)
+        //menu_click can replace the menu while we are walking it
+        if (entities.has(entity))
         {
-            mouse = &(world->mouse[entity]);
+            mouse = &entities.get<MouseComponent>(entity);
 
             mouse->x = x;
             mouse->y = y;
@@ -91,11 +97,12 @@ void MouseInputSystem(World *world)
 					
 					text_field_pressed = true;
 					
-					for(e = 0; e < MAX_ENTITIES; e++) {
+					View<TextFieldComponent> text_fields(world);
+					for(j = 0; j < text_fields.size(); j++) {
+						e = text_fields[j];
 						
-						if (e != entity &&
-							(world->mask[e] & COMPONENT_TEXTFIELD) == COMPONENT_TEXTFIELD) {
-							world->text[e].focused = false;
+						if (e != entity) {
+							text_fields.get<TextFieldComponent>(e).focused = false;
 						}
 						
 					}
@@ -130,26 +137,27 @@ void MouseInputSystem(World *world)
 			}
 
         }
+    }
+    
+    AnimationView animated(world);
+    for(i = 0; i < animated.size(); i++)
+    {
+        entity = animated[i];
 		
 		//trigger animations on hover
-		if ((world->mask[entity] & ANIMATION_MASK) == ANIMATION_MASK) {
-			
-			position = &(world->position[entity]);
-			animation = &(world->animation[entity]);
+		position = &animated.get<PositionComponent>(entity);
+		animation = &animated.get<AnimationComponent>(entity);
+		
+		if (animation->hover_animation > -1 && animation->current_animation == -1) {
 			
-			if (animation->hover_animation > -1 && animation->current_animation == -1) {
+			if (position->x < x && position->y < y &&
+				position->x + position->width > x &&
+				position->y + position->height > y) {
+				
+				
+				animation->current_animation = animation->hover_animation;
 				
-				if (position->x < x && position->y < y &&
-					position->x + position->width > x &&
-					position->y + position->height > y) {
-					
-					
-					animation->current_animation = animation->hover_animation;
-					
-				}
 			}
-			
-			
 		}
 		
     }
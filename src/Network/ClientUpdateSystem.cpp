@@ -11,23 +11,111 @@
  /** @} */
 #include "Packets.h"
 #include "GameplayCommunication.h"
-#include "PipeUtils.h"
 #include "../world.h"
 #include "../systems.h"
 #include "../Gameplay/collision.h"
+#include "../Gameplay/prediction.h"
+#include "SnapshotBuffer.h"
 #include "network_systems.h"
 #include "../Input/chat.h"
+#include "../view.h"
 
 extern int textField;
 extern FowComponent *fow;
 extern unsigned int player_entity;
-extern int game_net_signalfd;     /**< An eventfd allowing the gameplay thread to request data from network router. */
 extern int network_ready;         /**< Indicates whether the network has initialised. */
 extern int player_team;           /**< The player's team (0, COPS or ROBBERS). */
 int floor_change_flag = 0;        /**< Whether we just changed floors. */
 
-unsigned int *player_table       = NULL; /**< A lookup table mapping server player numbers to client entities. */
+EntityHandle *player_table       = NULL; /**< A lookup table mapping server player numbers to client entity handles. */
 objective_cache *objective_table = NULL; /**< A lookup table mapping server objective numbers to client entities. */
+
+/**
+ * Finds the entity currently representing a server player.
+ *
+ * If the entity the table points at has been destroyed since it was stored, the
+ * table entry is cleared so the player gets recreated on the next status update.
+ *
+ * @param[in] world     The world struct containing the player entities.
+ * @param[in] playerNo  The server's player number.
+ *
+ * @return The player's entity, or MAX_ENTITIES if the player has no live entity.
+ *
+ * @designer Shane Spoor
+ * @author Shane Spoor
+ */
+unsigned int player_lookup(World *world, unsigned int playerNo)
+{
+	unsigned int entity;
+
+	if(playerNo >= MAX_PLAYERS || player_table[playerNo] == UNASSIGNED)
+		return MAX_ENTITIES;
+
+	entity = entity_from_handle(world, player_table[playerNo]);
+	if(entity == MAX_ENTITIES)
+		player_table[playerNo] = UNASSIGNED;
+
+	return entity;
+}
+/**
+ * Applies one packet from the server to the world.
+ *
+ * While the player is changing floors, only the floor move is applied.
+ *
+ * @param[in, out] world     The world struct to be updated.
+ * @param[in]      type      The packet's type.
+ * @param[in]      packet    The packet.
+ * @param[in]      timestamp The server time the packet was sent at.
+ * @param[in]      received  When the packet reached the socket, in CLOCK_REALTIME ns, or 0.
+ *
+ * @return 0, or -1 if the server denied the connection.
+ *
+ * @designer Shane Spoor
+ * @designer Clark Allenby
+ * @author Shane Spoor
+ */
+static int apply_packet(World *world, uint32_t type, void *packet, uint64_t timestamp, uint64_t received)
+{
+	if(floor_change_flag == 1)
+	{
+		if(type == P_FLOOR_MOVE)
+			client_update_floor(world, packet);
+		return 0;
+	}
+
+	switch (type) 
+	{ 
+		case P_CONNECT:
+			if(client_update_info(world, packet) == CONNECT_CODE_DENIED)
+			{
+				return -1; // Pass error up to someone else to deal with
+			}
+			break;
+		case G_STATUS:
+			client_update_status(world, packet);
+			break;
+		case P_CHAT:
+			client_update_chat(world, packet);
+			break;
+		case P_SPECIAL_TILE:
+			update_special_tile(world, packet);
+			break;
+		case P_OBJSTATUS:
+			client_update_objectives(world, packet);
+			break;
+		case G_ALLPOSUPDATE:
+			client_update_pos(world, packet, timestamp, received);
+			break;
+		case P_FLOOR_MOVE:
+			client_update_floor(world, packet);
+			break;
+		default:
+			break;
+	}
+
+	return 0;
+}
+
 /**
  * Receives all updates from the server and applies them to the world.
  *
@@ -35,90 +123,52 @@ objective_cache *objective_table = NULL; /**< A lookup table mapping server obje
  * objective updates, floor changes, and the initial player information (names, team numbers and
  * player numbers).
  *
+ * The network router fills the inbox as packets arrive, so this never waits on it. Queued
+ * events are applied first, in the order they arrived, and then the latest packet of each
+ * state type that has changed since the last frame.
+ *
  * @param[in] world 	The world struct to be updated.
- * @param[in] net_pipe	The read end of a pipe connected to the network module.
+ * @param[in] inbox		The inbox filled by the network router.
  *
  * @designer Shane Spoor
 	 * @designer Clark Allenby
 	 * @author Shane Spoor
  */
-int client_update_system(World *world, int net_pipe) {
+int client_update_system(World *world, PacketInbox *inbox) {
 	void* 		packet;
 	uint32_t 	type;
-	uint32_t 	num_packets;
-	uint64_t	signal = 1;
-	unsigned	i;
+	uint64_t	timestamp;
+	uint64_t	received;
+	int			result = 0;
 
-    if(!network_ready) // Don't try to read the pipe until the network module has been initialised
+    if(!network_ready) // Don't try to read the inbox until the network module has been initialised
         return -3;
 
-	write(game_net_signalfd, &signal, sizeof(uint64_t));
-	num_packets = read_type(net_pipe); // the function just reads a 32 bit value, so this works; semantically, not ideal
-
-    if(num_packets == (unsigned int)NET_SHUTDOWN) // network is shutting down; this is the only packet
-    {
-        char err_buf[128];
-        uint32_t str_size;
-        read_pipe(net_pipe, &str_size, sizeof(str_size));
-        if(str_size)
-        {
-            read_pipe(net_pipe, err_buf, str_size);
-            err_buf[str_size] = 0; // null terminate the string
-            fprintf(stderr, "%s", err_buf);
-        }
-        memset(player_table, 255, MAX_PLAYERS);
-        memset(objective_table, 255, MAX_OBJECTIVES);
-        network_ready = 0;
-        return -2;
-    }
-
-	for(i = 0; i < num_packets; ++i)
+	while((packet = ring_peek(inbox->queue, &type, &timestamp)) != NULL)
 	{
-		packet = read_data(net_pipe, &type);
-		if(floor_change_flag == 1)
+		if(type == (unsigned int)NET_SHUTDOWN) // network is shutting down; the packet holds the error string
 		{
-			switch (type) 
-			{ 
-				case P_FLOOR_MOVE:
-					client_update_floor(world, packet);
-					break;
-			}
-		}
-		else {
-			switch (type) 
-			{ 
-				case P_CONNECT:
-					if(client_update_info(world, packet) == CONNECT_CODE_DENIED)
-					{
-						return -1; // Pass error up to someone else to deal with
-					}
-					break;
-				case G_STATUS:
-					client_update_status(world, packet);
-					break;
-				case P_CHAT:
-					client_update_chat(world, packet);
-					break;
-				case P_SPECIAL_TILE:
-					update_special_tile(world, packet);
-					break;
-				case P_OBJSTATUS:
-					client_update_objectives(world, packet);
-					break;
-				case G_ALLPOSUPDATE:
-					client_update_pos(world, packet);
-					break;
-				case P_FLOOR_MOVE:
-					client_update_floor(world, packet);
-					break;
-				default:
-					break;
-			}
+			if(*(char *)packet)
+				fprintf(stderr, "%s", (char *)packet);
+			ring_release(inbox->queue);
+			memset(player_table, 255, MAX_PLAYERS * sizeof(EntityHandle));
+			memset(objective_table, 255, MAX_OBJECTIVES * sizeof(objective_cache));
+			network_ready = 0;
+			return -2;
 		}
-		free(packet);
+
+		if(apply_packet(world, type, packet, timestamp, 0) == -1)
+			result = -1;
+		ring_release(inbox->queue);
 	}
 
-	return 0;
+	for(type = 1; type <= NUM_PACKETS; ++type)
+	{
+		if(inbox->latest[type - 1] && (packet = mailbox_take(inbox->latest[type - 1], &timestamp, &received)) != NULL)
+			apply_packet(world, type, packet, timestamp, received);
+	}
+
+	return result;
 }
 /**
  * Updates the positions and movement properties of every other player.
@@ -145,8 +195,12 @@ void client_update_chat(World *world, void *packet)
 	}
 	else
 	{
-		snprintf(message, MAX_MESSAGE + MAX_NAME + 2,"%s: %s", world->player[player_table[snd_chat->sendingPlayer_number]].name, snd_chat->message);
-		font_type = (world->player[player_table[snd_chat->sendingPlayer_number]].teamNo == world->player[player_entity].teamNo) ? CHAT_FONT : OTHER_TEAM_FONT;
+		unsigned int sender = player_lookup(world, snd_chat->sendingPlayer_number);
+		if(sender == MAX_ENTITIES)
+			return;
+
+		snprintf(message, MAX_MESSAGE + MAX_NAME + 2,"%s: %s", world->player[sender].name, snd_chat->message);
+		font_type = (world->player[sender].teamNo == world->player[player_entity].teamNo) ? CHAT_FONT : OTHER_TEAM_FONT;
 	} 
 	chat_add_line(message, font_type);
 }
@@ -170,26 +224,29 @@ void client_update_floor(World *world, void *packet)
 {
 	PKT_FLOOR_MOVE* floor_move = (PKT_FLOOR_MOVE*)packet;
 	int obj_idx = (floor_move->new_floor - 1) * OBJECTIVES_PER_FLOOR; // Start at the correct offset for this floor (requires fixed number of objectives/floor)
-	int i;
+	unsigned int i;
+	unsigned int n;
 
 	world->position[player_entity].level	= floor_move->new_floor;
 	world->position[player_entity].x		= floor_move->xPos;
 	world->position[player_entity].y		= floor_move->yPos;
+	reset_prediction(world, player_entity);
+	clear_all_snapshots();
 	rebuild_floor(world, floor_move->new_floor);
 	if(floor_move->new_floor == 0)
 	{
 		reset_fog_of_war(fow);
 	}
 
-	for(i = 0; i < MAX_ENTITIES; i++)
+	//the view is in entity order, which is the order the map created the objectives in
+	View<ObjectiveComponent> objectives(world);
+	for(n = 0; n < objectives.size(); n++)
 	{
-		if(IN_THIS_COMPONENT(world->mask[i], COMPONENT_OBJECTIVE))
-		{
-			objective_table[obj_idx].entity_no = i;
-			world->objective[i].status = objective_table[obj_idx].obj_state;
-    		play_animation(world, objective_table[obj_idx].entity_no, (world->objective[i].status == OBJECTIVE_CAP) ? "captured" : "not_captured");
-			obj_idx++;
-		}
+		i = objectives[n];
+		objective_table[obj_idx].entity = entity_handle(world, i);
+		objectives.get<ObjectiveComponent>(i).status = objective_table[obj_idx].obj_state;
+		play_animation(world, i, (objectives.get<ObjectiveComponent>(i).status == OBJECTIVE_CAP) ? "captured" : "not_captured");
+		obj_idx++;
 	}
 
 	floor_change_flag = 0;
@@ -200,19 +257,26 @@ void client_update_floor(World *world, void *packet)
  *
  * The function will ignore players that aren't on the current floor and the client's
  * own player, since they're said to be authoritative over their own position (except
- * for their floor).
+ * for their floor). Other players' positions are kept as snapshots for the movement
+ * system to draw them from.
  *
- * @param[in, out]	world 	The world struct holding the data to be updated.
- * @param[in] 		packet	The packet containing update information.
+ * @param[in, out]	world 		The world struct holding the data to be updated.
+ * @param[in] 		packet		The packet containing update information.
+ * @param[in] 		timestamp	The server's timestamp on the packet.
+ * @param[in] 		received	When the packet reached the socket, in CLOCK_REALTIME ns, or 0 if it
+ * 								isn't known and the snapshots are stamped with the current time.
  *
  * @designer Shane Spoor
  * @author Shane Spoor
  */
-void client_update_pos(World *world, void *packet)
+void client_update_pos(World *world, void *packet, uint64_t timestamp, uint64_t received)
 {
 	PKT_ALL_POS_UPDATE *pos_update = (PKT_ALL_POS_UPDATE *)packet;
+	double age = snapshot_age(received);
 	
-	if(player_entity == UNASSIGNED)
+	unsigned int entity;
+
+	if(player_entity >= MAX_ENTITIES)
 	{
 		return;
 	}
@@ -221,34 +285,41 @@ void client_update_pos(World *world, void *packet)
 		for (unsigned int i = 0; i < MAX_PLAYERS; i++)
 		{
 	        if(i == world->player[player_entity].playerNo)
+	        {
+				// our own position comes back with the last step the server applied
+				if(pos_update->players_on_floor[i])
+					reconcile_prediction(world, player_entity, pos_update->ack[i], pos_update->xPos[i], pos_update->yPos[i], pos_update->xVel[i], pos_update->yVel[i]);
 				continue;
+			}
 			
-			if(player_table[i] != UNASSIGNED)
+			entity = player_lookup(world, i);
+			if(entity != MAX_ENTITIES)
 			{
 				if(!pos_update->players_on_floor[i])
 				{
-					world->mask[player_table[i]] &= ~(COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION); // If the player is no longer on the floor, turn off render and collision
+					defer_disable(world, entity, COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION); // If the player is no longer on the floor, turn off render and collision
+					clear_snapshots(i);
 				 	continue;
 				}
-				world->mask[player_table[i]] |= COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION;
-				world->movement[player_table[i]].movX	= pos_update->xVel[i];
-				world->movement[player_table[i]].movY 	= pos_update->yVel[i];
+				defer_enable(world, entity, COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION);
+				world->movement[entity].movX	= pos_update->xVel[i];
+				world->movement[entity].movY 	= pos_update->yVel[i];
 				
 				if(pos_update->xVel[i] < 0){
-				 	world->movement[player_table[i]].lastDirection = DIRECTION_LEFT;
+				 	world->movement[entity].lastDirection = DIRECTION_LEFT;
 				}else if (pos_update->xVel[i] > 0){
-					world->movement[player_table[i]].lastDirection = DIRECTION_RIGHT;
+					world->movement[entity].lastDirection = DIRECTION_RIGHT;
 				}
 				
 				if(pos_update->yVel[i] < 0){
-					world->movement[player_table[i]].lastDirection = DIRECTION_DOWN;
+					world->movement[entity].lastDirection = DIRECTION_DOWN;
 				}else if (pos_update->yVel[i] > 0){
-					world->movement[player_table[i]].lastDirection = DIRECTION_UP;
+					world->movement[entity].lastDirection = DIRECTION_UP;
 				}
 				
-				world->position[player_table[i]].x		= pos_update->xPos[i];
-				world->position[player_table[i]].y		= pos_update->yPos[i];
-				world->position[player_table[i]].level	= pos_update->floor;
+				// the movement system draws them from here, a little behind
+				push_snapshot(i, timestamp, age, pos_update->xPos[i], pos_update->yPos[i], pos_update->xVel[i], pos_update->yVel[i]);
+				world->position[entity].level	= pos_update->floor;
 			}
 		}
 	}
@@ -281,10 +352,15 @@ void client_update_objectives(World *world, void *packet)
 
 	    if(i >= obj_idx && i < obj_idx + OBJECTIVES_PER_FLOOR)
 	    {
-    		if((unsigned int)objective_table[i].obj_state != objective_update->objectives_captured[i])
-    			play_animation(world, objective_table[i].entity_no, (objective_update->objectives_captured[i] == OBJECTIVE_CAP) ? "captured" : "not_captured");
+	    	unsigned int entity = entity_from_handle(world, objective_table[i].entity);
 
-			world->objective[objective_table[i].entity_no].status = objective_table[i].obj_state;
+	    	if(entity != MAX_ENTITIES)
+	    	{
+    			if((unsigned int)objective_table[i].obj_state != objective_update->objectives_captured[i])
+    				play_animation(world, entity, (objective_update->objectives_captured[i] == OBJECTIVE_CAP) ? "captured" : "not_captured");
+
+				world->objective[entity].status = objective_table[i].obj_state;
+			}
 	    }
 	    objective_table[i].obj_state = objective_update->objectives_captured[i];
 	}
@@ -307,23 +383,30 @@ void client_update_status(World *world, void *packet)
 {
 	PKT_GAME_STATUS *status_update = (PKT_GAME_STATUS *)packet;
 
+	unsigned int entity;
+
 	for(int i = 0; i < MAX_PLAYERS; i++)
 	{
+		entity = player_lookup(world, i);
 		if(status_update->player_valid[i] == true)
 		{	
-			if(player_table[i] == UNASSIGNED) // They're on the floor but haven't yet been created
+			if(entity == MAX_ENTITIES) // They're on the floor but haven't yet been created
 	        {
-	            player_table[i] = create_player(world, 400, 600, false, COLLISION_HACKER, i, status_update);	
+	            entity = create_player(world, 400, 600, false, COLLISION_HACKER, i, status_update);	
+	            if(entity == MAX_ENTITIES)
+	            	continue;
+
+	            player_table[i] = entity_handle(world, entity);
 	           	if(status_update->otherPlayers_teams[i] == COPS)
 				{
-					load_animation("assets/Graphics/player/p0/rob_animation.txt", world, player_table[i]);
+					load_animation("assets/Graphics/player/p0/rob_animation.txt", world, entity);
 				}
 				else{
-					setup_character_animation(world, status_update->characters[i], player_table[i]);
+					setup_character_animation(world, status_update->characters[i], entity);
 				}
 	        }
 
-	        else if(player_table[i] != UNASSIGNED && status_update->player_valid[i])
+	        else if(status_update->player_valid[i])
 	        {
 	        	if(status_update->otherPlayers_teams[i] == COPS)
 	        	{
@@ -346,11 +429,12 @@ void client_update_status(World *world, void *packet)
 		} 
 		else
 		{
-			if(player_table[i] != UNASSIGNED)
+			// The slot is kept until the destroy is applied; player_lookup clears it once the entity is gone
+			if(entity != MAX_ENTITIES)
 			{
-				destroy_entity(world, player_table[i]);
-				player_table[i] = UNASSIGNED;
+				defer_destroy(world, entity);
 			}
+			clear_snapshots(i); // so a player who takes the slot isn't drawn from the old one's updates
 		}
 	}
 }
@@ -369,22 +453,26 @@ void client_update_status(World *world, void *packet)
  */
 void change_player(World * world, int type, PKT_GAME_STATUS * pkt, int playerNo)
 {
-	world->player[player_table[playerNo]].playerNo = playerNo;
-	world->player[player_table[playerNo]].teamNo = pkt->otherPlayers_teams[playerNo];
-	world->player[player_table[playerNo]].readyStatus = pkt->readystatus[playerNo];
+	unsigned int entity = player_lookup(world, playerNo);
+	if(entity == MAX_ENTITIES)
+		return;
+
+	world->player[entity].playerNo = playerNo;
+	world->player[entity].teamNo = pkt->otherPlayers_teams[playerNo];
+	world->player[entity].readyStatus = pkt->readystatus[playerNo];
 	if(type == COPS)
 	{
-		world->collision[player_table[playerNo]].type = COLLISION_GUARD;
+		world->collision[entity].type = COLLISION_GUARD;
 	}
 	else{
-		world->collision[player_table[playerNo]].type = COLLISION_HACKER;
+		world->collision[entity].type = COLLISION_HACKER;
 	}
 	if(type == COPS)
 	{
-		load_animation("assets/Graphics/player/p0/rob_animation.txt", world, player_table[playerNo]);
+		load_animation("assets/Graphics/player/p0/rob_animation.txt", world, entity);
 	}
 	else{
-		setup_character_animation(world, pkt->characters[playerNo], player_table[playerNo]);
+		setup_character_animation(world, pkt->characters[playerNo], entity);
 	}
 
 
@@ -562,15 +650,14 @@ int client_update_info(World *world, void *packet)
 	if(client_info->connect_code == CONNECT_CODE_DENIED)
 		return CONNECT_CODE_DENIED;
 
-	for (int i = 0; i < MAX_ENTITIES; i++)
+	View<MovementComponent, PositionComponent, PlayerComponent, ControllableComponent> local(world);
+	for (unsigned int n = 0; n < local.size(); n++)
 	{
-		if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_MOVEMENT | COMPONENT_POSITION | COMPONENT_PLAYER | COMPONENT_CONTROLLABLE))
-		{
-			world->player[i].teamNo							= client_info->clients_team_number;
-			world->player[i].playerNo						= client_info->clients_player_number;
-			memcpy(world->player[i].name, client_info->name, MAX_NAME);
-			player_table[client_info->clients_player_number] = i;	
-		}
+		unsigned int i = local[n];
+		local.get<PlayerComponent>(i).teamNo					= client_info->clients_team_number;
+		local.get<PlayerComponent>(i).playerNo					= client_info->clients_player_number;
+		memcpy(local.get<PlayerComponent>(i).name, client_info->name, MAX_NAME);
+		player_table[client_info->clients_player_number] = entity_handle(world, i);	
 	}
 
 	return CONNECT_CODE_ACCEPTED;
@@ -584,7 +671,7 @@ int client_update_info(World *world, void *packet)
 int init_client_update(World *world)
 {
 	objective_table = (objective_cache *)malloc(MAX_OBJECTIVES * sizeof(objective_cache));
-	player_table = (unsigned int *)malloc(sizeof(unsigned int) * MAX_PLAYERS);
+	player_table = (EntityHandle *)malloc(sizeof(EntityHandle) * MAX_PLAYERS);
 
 	if(!objective_table || !player_table)
 	{
@@ -592,7 +679,7 @@ int init_client_update(World *world)
 	    return 0;
 	}
 
-	memset(player_table, 255, MAX_PLAYERS * sizeof(unsigned int));
+	memset(player_table, 255, MAX_PLAYERS * sizeof(EntityHandle));
 	memset(objective_table, 0, MAX_OBJECTIVES * sizeof(objective_cache));
 	return 1;
 }
@@ -613,13 +700,13 @@ void update_special_tile(World *world, void * packet)
 			
 	unsigned int tile = create_stile(world, pkt->tile, pkt->xPos, pkt->yPos, pkt->floor);
 	
-	if(tile == -1)
+	if(tile == -1 || tile == MAX_ENTITIES)
 	{
 		return;
 	}
 
 	if(pkt->floor != (unsigned int) world->position[player_entity].level)
 	{
-		world->mask[tile] &= ~(COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION);
+		defer_disable(world, tile, COMPONENT_RENDER_PLAYER | COMPONENT_COLLISION);
 	}
 }
@@ -0,0 +1,572 @@
+/** @ingroup Network */
+/** @{ */
+
+/**
+ * A network backend that does everything in the router thread, using raw Linux sockets
+ * and one epoll loop in place of SDL_net and the send and receive threads.
+ *
+ * The thread sleeps in epoll_wait on the TCP socket, the UDP socket and the ring from
+ * gameplay. Packets from the server go straight into gameplay's inbox and packets from
+ * gameplay straight onto the sockets, so nothing passes between threads on the way.
+ * Datagrams are received and sent in batches with recvmmsg and sendmmsg, and the kernel
+ * stamps each one with the time it arrived, which is passed on with position updates.
+ *
+ * @file EpollNetwork.cpp
+ */
+
+/** @} */
+#include "Packets.h"
+#include "GameplayCommunication.h"
+#include "ServerCommunication.h"
+#include "NetworkRouter.h"
+#include "packet_min_utils.h"
+#include "EpollNetwork.h"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <time.h>
+
+#define DATAGRAM_SIZE	(MAX_UDP_RECV + sizeof(uint32_t) + sizeof(uint64_t))	/**< The most a datagram holds: type, packet and timestamp. */
+
+extern int network_ready;
+extern uint32_t packet_sizes[NUM_PACKETS + 1];
+
+/**
+ * The network thread's connection to the server.
+ *
+ * @struct EpollConnection
+ */
+typedef struct
+{
+	int					epoll_fd;
+	int					tcp_fd;
+	int					udp_fd;
+	struct sockaddr_in	udp_addr;		/**< The server's UDP address. */
+	uint64_t			tcp_seq;		/**< Stands in for a timestamp on TCP packets, which don't carry one. */
+	bool				tcp_watch_out;	/**< Whether epoll is watching for room to write TCP data. */
+
+	TcpStream			in;				/**< TCP data read but not yet made into packets. */
+	TcpStream			out;			/**< TCP packets waiting to be sent. */
+
+	struct mmsghdr		recv_msgs[UDP_BATCH];
+	struct iovec		recv_iov[UDP_BATCH];
+	uint64_t			recv_data[UDP_BATCH][(DATAGRAM_SIZE + 7) / 8];
+	uint64_t			recv_control[UDP_BATCH][(CMSG_SPACE(sizeof(struct timespec)) + 7) / 8];
+
+	unsigned int		send_count;		/**< Datagrams waiting to be sent. */
+	struct mmsghdr		send_msgs[UDP_BATCH];
+	struct iovec		send_iov[UDP_BATCH];
+	uint64_t			send_data[UDP_BATCH][(DATAGRAM_SIZE + 7) / 8];
+} EpollConnection;
+
+/**
+ * Connects the TCP socket to the server and opens the UDP socket.
+ *
+ * @param[out] conn The connection to fill in.
+ * @param[in]  ip   The server's address.
+ *
+ * @return 0 on success, or -1 on failure (the network error is set).
+ *
+ * @designer
+ * @author
+ */
+static int open_sockets(EpollConnection *conn, const char *ip)
+{
+	struct addrinfo hints, *server;
+	struct sockaddr_in addr;
+	int on = 1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	if(getaddrinfo(ip, NULL, &hints, &server) != 0)
+	{
+		fprintf(stderr, "open_sockets: Couldn't resolve %s\n", ip);
+		set_error(ERR_NO_HOST);
+		return -1;
+	}
+	memcpy(&addr, server->ai_addr, sizeof(addr));
+	freeaddrinfo(server);
+
+	addr.sin_port = htons(TCP_PORT);
+	if((conn->tcp_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1 ||
+	   connect(conn->tcp_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+	{
+		perror("open_sockets: TCP");
+		set_error(ERR_NO_CONN);
+		return -1;
+	}
+	fcntl(conn->tcp_fd, F_SETFL, fcntl(conn->tcp_fd, F_GETFL) | O_NONBLOCK);
+	setsockopt(conn->tcp_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+	conn->udp_addr = addr;
+	conn->udp_addr.sin_port = htons(UDP_PORT);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port        = htons(UDP_PORT);
+	if((conn->udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1 ||
+	   bind(conn->udp_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+	{
+		perror("open_sockets: UDP");
+		set_error(ERR_ROUTER_INIT);
+		return -1;
+	}
+
+	// without the kernel's timestamps, position updates are timed when gameplay takes them
+	if(setsockopt(conn->udp_fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == -1)
+		perror("open_sockets: SO_TIMESTAMPNS");
+
+	return 0;
+}
+
+/**
+ * Adds a descriptor to the epoll set or changes the events watched on it.
+ *
+ * @param[in] conn   The connection.
+ * @param[in] op     EPOLL_CTL_ADD or EPOLL_CTL_MOD.
+ * @param[in] fd     The descriptor.
+ * @param[in] events The events to watch for.
+ *
+ * @return 0 on success, or -1 on failure.
+ *
+ * @designer
+ * @author
+ */
+static int watch_fd(EpollConnection *conn, int op, int fd, uint32_t events)
+{
+	struct epoll_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.events  = events;
+	event.data.fd = fd;
+	if(epoll_ctl(conn->epoll_fd, op, fd, &event) == -1)
+	{
+		perror("watch_fd: epoll_ctl");
+		set_error(ERR_ROUTER_INIT);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Reads what has arrived on the TCP socket and passes each whole packet to gameplay.
+ *
+ * Keep alives are skipped. A partial packet is kept until the rest of it arrives.
+ *
+ * @param[in, out] conn  The connection.
+ * @param[in]      inbox Gameplay's inbox.
+ *
+ * @return 0 on success, or -1 if the connection closed or failed (the network error is set).
+ *
+ * @designer
+ * @author
+ */
+static int read_tcp(EpollConnection *conn, PacketInbox *inbox)
+{
+	unsigned char *space;
+	unsigned int room;
+	uint32_t type;
+	void *packet;
+	ssize_t numread;
+
+	while(1)
+	{
+		space   = stream_space(&conn->in, &room);
+		numread = read(conn->tcp_fd, space, room);
+		if(numread == 0)
+		{
+			fprintf(stderr, "read_tcp: Connection closed or reset.\n");
+			set_error(ERR_CONN_CLOSED);
+			return -1;
+		}
+		if(numread == -1)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			perror("read_tcp: read");
+			set_error(ERR_TCP_RECV_FAIL);
+			return -1;
+		}
+		stream_fill(&conn->in, numread);
+
+		// gameplay's queue is only full if gameplay has stopped reading; the packet is dropped then
+		while((packet = stream_next(&conn->in, &type)) != NULL)
+			update_gameplay(inbox, type, packet, conn->tcp_seq++, 0);
+
+		if(type == INVALID_PACKET_TYPE)
+		{
+			fprintf(stderr, "read_tcp: Received Invalid Packet Type!\n");
+			set_error(ERR_CORRUPTED);
+			return -1;
+		}
+	}
+}
+
+/**
+ * Gets the time the kernel stamped a datagram with when it arrived.
+ *
+ * @param[in] msg The datagram's message header from recvmmsg.
+ *
+ * @return The time in CLOCK_REALTIME ns, or 0 if the datagram wasn't stamped.
+ *
+ * @designer
+ * @author
+ */
+static uint64_t received_time(struct msghdr *msg)
+{
+	struct cmsghdr *cmsg;
+	struct timespec stamp;
+
+	for(cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+	{
+		if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+		{
+			memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+			return (uint64_t)stamp.tv_sec * 1000000000ULL + stamp.tv_nsec;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Passes one datagram from the server to gameplay, expanding minimised position updates.
+ *
+ * Datagrams that are too short or of an impossible type are dropped. Position updates from
+ * older servers, without the seq and ack fields, get those fields zeroed.
+ *
+ * @param[in] inbox    Gameplay's inbox.
+ * @param[in] data     The datagram.
+ * @param[in] len      The datagram's length.
+ * @param[in] received When the datagram arrived, in CLOCK_REALTIME ns, or 0.
+ *
+ * @designer
+ * @author
+ */
+static void handle_datagram(PacketInbox *inbox, const unsigned char *data, unsigned int len, uint64_t received)
+{
+	uint64_t packet[(MAX_UDP_RECV + 7) / 8];
+	uint64_t full[(sizeof(PKT_ALL_POS_UPDATE) + 7) / 8];
+	uint32_t type, size;
+	uint64_t timestamp;
+
+	if(len < sizeof(type))
+		return;
+
+	memcpy(&type, data, sizeof(type));
+	if(type < 1 || type > NUM_PACKETS || (size = datagram_packet_size(type, len)) == 0)
+	{
+		fprintf(stderr, "handle_datagram: Received Invalid Packet Type!\n");
+		return;
+	}
+
+	memcpy(packet, data + sizeof(type), size);
+	memset((unsigned char *)packet + size, 0, packet_sizes[type - 1] - size); // fields an older server leaves off
+	memcpy(&timestamp, data + sizeof(type) + size, sizeof(timestamp));
+
+	if(type == P_MIN_POS)
+	{
+		decapsulate_pos_update((PKT_POS_UPDATE_MIN *)packet, (PKT_POS_UPDATE *)full);
+		update_gameplay(inbox, P_POSUPDATE, full, timestamp, received);
+	}
+	else if(type == P_MIN_POS_ALL)
+	{
+		decapsulate_all_pos_update((PKT_ALL_POS_UPDATE_MIN *)packet, (PKT_ALL_POS_UPDATE *)full);
+		update_gameplay(inbox, G_ALLPOSUPDATE, full, timestamp, received);
+	}
+	else
+		update_gameplay(inbox, type, packet, timestamp, received);
+}
+
+/**
+ * Receives every datagram waiting on the UDP socket, a batch at a time.
+ *
+ * @param[in, out] conn  The connection.
+ * @param[in]      inbox Gameplay's inbox.
+ *
+ * @return 0 on success, or -1 if receiving failed (the network error is set).
+ *
+ * @designer
+ * @author
+ */
+static int read_udp(EpollConnection *conn, PacketInbox *inbox)
+{
+	int i, count;
+
+	while(1)
+	{
+		for(i = 0; i < UDP_BATCH; ++i)
+		{
+			conn->recv_iov[i].iov_base = conn->recv_data[i];
+			conn->recv_iov[i].iov_len  = DATAGRAM_SIZE;
+			memset(&conn->recv_msgs[i], 0, sizeof(conn->recv_msgs[i]));
+			conn->recv_msgs[i].msg_hdr.msg_iov        = &conn->recv_iov[i];
+			conn->recv_msgs[i].msg_hdr.msg_iovlen     = 1;
+			conn->recv_msgs[i].msg_hdr.msg_control    = conn->recv_control[i];
+			conn->recv_msgs[i].msg_hdr.msg_controllen = sizeof(conn->recv_control[i]);
+		}
+
+		if((count = recvmmsg(conn->udp_fd, conn->recv_msgs, UDP_BATCH, MSG_DONTWAIT, NULL)) == -1)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			perror("read_udp: recvmmsg");
+			set_error(ERR_UDP_RECV_FAIL);
+			return -1;
+		}
+
+		for(i = 0; i < count; ++i)
+		{
+			handle_datagram(inbox, (unsigned char *)conn->recv_data[i], conn->recv_msgs[i].msg_len,
+							received_time(&conn->recv_msgs[i].msg_hdr));
+		}
+
+		if(count < UDP_BATCH)
+			return 0;
+	}
+}
+
+/**
+ * Sends the datagrams waiting in the batch with as few system calls as possible.
+ *
+ * If the socket's buffer is full, the rest are dropped, as they would be anywhere
+ * else on the way.
+ *
+ * @param[in, out] conn The connection.
+ *
+ * @return 0 on success, or -1 if sending failed (the network error is set).
+ *
+ * @designer
+ * @author
+ */
+static int flush_udp(EpollConnection *conn)
+{
+	unsigned int sent = 0;
+	int count;
+
+	while(sent < conn->send_count)
+	{
+		if((count = sendmmsg(conn->udp_fd, conn->send_msgs + sent, conn->send_count - sent, 0)) == -1)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+				break;
+			perror("flush_udp: sendmmsg");
+			set_error(ERR_UDP_SEND_FAIL);
+			return -1;
+		}
+		sent += count;
+	}
+
+	conn->send_count = 0;
+	return 0;
+}
+
+/**
+ * Sends as much of the waiting TCP data as the socket will take, and has epoll watch for
+ * room to send the rest.
+ *
+ * @param[in, out] conn The connection.
+ *
+ * @return 0 on success, or -1 if sending failed (the network error is set).
+ *
+ * @designer
+ * @author
+ */
+static int flush_tcp(EpollConnection *conn)
+{
+	unsigned char *pending;
+	unsigned int count;
+	ssize_t sent;
+
+	while((count = stream_pending(&conn->out, &pending)) > 0)
+	{
+		if((sent = send(conn->tcp_fd, pending, count, MSG_NOSIGNAL)) == -1)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			perror("flush_tcp: send");
+			set_error(ERR_TCP_SEND_FAIL);
+			return -1;
+		}
+
+		stream_consume(&conn->out, sent);
+	}
+
+	if(conn->tcp_watch_out != (count > 0))
+	{
+		conn->tcp_watch_out = (count > 0);
+		return watch_fd(conn, EPOLL_CTL_MOD, conn->tcp_fd, EPOLLIN | EPOLLRDHUP | (conn->tcp_watch_out ? EPOLLOUT : 0));
+	}
+
+	return 0;
+}
+
+/**
+ * Adds a packet from gameplay to the TCP data or the datagram batch waiting to be sent.
+ * Position updates are minimised straight into the datagram, as send_udp does.
+ *
+ * @param[in, out] conn   The connection.
+ * @param[in]      type   The packet's type.
+ * @param[in]      packet The packet.
+ *
+ * @return 0 on success, or -1 if sending failed (the network error is set).
+ *
+ * @designer
+ * @author
+ */
+static int queue_packet(EpollConnection *conn, uint32_t type, void *packet)
+{
+	unsigned char *datagram;
+	unsigned int n;
+
+	if(get_protocol(type) == TCP)
+		return stream_append(&conn->out, type, packet);
+
+	n = conn->send_count++;
+	datagram = (unsigned char *)conn->send_data[n];
+
+	if(type == P_POSUPDATE)
+	{
+		type = P_MIN_POS;
+		encapsulate_pos_update((PKT_POS_UPDATE *)packet, (PKT_POS_UPDATE_MIN *)(datagram + sizeof(type)));
+	}
+	else if(type == G_ALLPOSUPDATE)
+	{
+		type = P_MIN_POS_ALL;
+		encapsulate_all_pos_update((PKT_ALL_POS_UPDATE *)packet, (PKT_ALL_POS_UPDATE_MIN *)(datagram + sizeof(type)));
+	}
+	else
+		memcpy(datagram + sizeof(type), packet, packet_sizes[type - 1]);
+	memcpy(datagram, &type, sizeof(type));
+
+	conn->send_iov[n].iov_base = datagram;
+	conn->send_iov[n].iov_len  = sizeof(type) + packet_sizes[type - 1];
+	memset(&conn->send_msgs[n], 0, sizeof(conn->send_msgs[n]));
+	conn->send_msgs[n].msg_hdr.msg_name    = &conn->udp_addr;
+	conn->send_msgs[n].msg_hdr.msg_namelen = sizeof(conn->udp_addr);
+	conn->send_msgs[n].msg_hdr.msg_iov     = &conn->send_iov[n];
+	conn->send_msgs[n].msg_hdr.msg_iovlen  = 1;
+
+	return conn->send_count == UDP_BATCH ? flush_udp(conn) : 0;
+}
+
+/**
+ * Runs the network in the calling (router) thread until gameplay asks it to stop or the
+ * connection fails, then tells gameplay the network has shut down.
+ *
+ * The thread only blocks in epoll_wait once gameplay's ring is empty and armed to wake it.
+ * If the TCP data waiting to be sent has filled its buffer, packets are left in the ring
+ * until the socket has room again.
+ *
+ * @param[in] gameplay The ring from gameplay, gameplay's inbox and the server's address.
+ *
+ * @return 0 once the network has shut down, or -1 if epoll isn't available and nothing
+ *         was done, so the SDL_net threads should be used instead.
+ *
+ * @designer
+ * @author
+ */
+int epoll_network(PDATA gameplay)
+{
+	EpollConnection		*conn;
+	struct epoll_event	events[4];
+	int					epoll_fd, count, i;
+	bool				running = true, armed, room;
+	uint32_t			type;
+	void				*packet;
+
+	if((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+	{
+		perror("epoll_network: epoll_create1");
+		return -1;
+	}
+
+	if(!(conn = (EpollConnection *)calloc(1, sizeof(EpollConnection))))
+	{
+		perror("epoll_network: calloc");
+		close(epoll_fd);
+		return -1;
+	}
+	conn->epoll_fd = epoll_fd;
+	conn->tcp_fd   = -1;
+	conn->udp_fd   = -1;
+	conn->tcp_seq  = 1;
+
+	if(open_sockets(conn, gameplay->ip) == -1 ||
+	   watch_fd(conn, EPOLL_CTL_ADD, conn->tcp_fd, EPOLLIN | EPOLLRDHUP) == -1 ||
+	   watch_fd(conn, EPOLL_CTL_ADD, conn->udp_fd, EPOLLIN) == -1 ||
+	   watch_fd(conn, EPOLL_CTL_ADD, gameplay->read_ring->event_fd, EPOLLIN) == -1)
+		running = false;
+	else
+		network_ready = 1;
+
+	while(running)
+	{
+		room  = stream_room(&conn->out) >= sizeof(uint32_t) + gameplay->read_ring->slot_size;
+		armed = room && ring_arm(gameplay->read_ring);
+
+		count = epoll_wait(epoll_fd, events, 4, (armed || !room) ? -1 : 0);
+
+		if(armed)
+			ring_disarm(gameplay->read_ring);
+
+		if(count == -1 && errno != EINTR)
+		{
+			perror("epoll_network: epoll_wait");
+			set_error(ERR_SOCKSET_READ);
+			break;
+		}
+
+		for(i = 0; running && i < count; ++i)
+		{
+			if(events[i].data.fd == conn->tcp_fd)
+			{
+				if((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && read_tcp(conn, gameplay->inbox) == -1)
+					running = false;
+				else if((events[i].events & EPOLLOUT) && flush_tcp(conn) == -1)
+					running = false;
+			}
+			else if(events[i].data.fd == conn->udp_fd && read_udp(conn, gameplay->inbox) == -1)
+				running = false;
+		}
+
+		while(running && stream_room(&conn->out) >= sizeof(uint32_t) + gameplay->read_ring->slot_size &&
+			  (packet = ring_peek(gameplay->read_ring, &type, NULL)) != NULL)
+		{
+			if(type == 0 || type > NUM_PACKETS || queue_packet(conn, type, packet) == -1)
+			{
+				running = false;
+				break;
+			}
+			ring_release(gameplay->read_ring);
+		}
+
+		if(running && (flush_udp(conn) == -1 || flush_tcp(conn) == -1))
+			running = false;
+	}
+
+	if(conn->tcp_fd != -1)
+		close(conn->tcp_fd);
+	if(conn->udp_fd != -1)
+		close(conn->udp_fd);
+	close(epoll_fd);
+	free(conn);
+
+	if(gameplay->inbox)
+		write_shutdown(gameplay->inbox->queue, get_error_string());
+	return 0;
+}
@@ -0,0 +1,17 @@
+/** @ingroup Network */
+/** @{ */
+/**
+ * @file EpollNetwork.h
+ */
+/** @} */
+#ifndef EPOLL_NETWORK_H
+#define EPOLL_NETWORK_H
+
+#include "GameplayCommunication.h"
+#include "TcpStream.h"
+
+#define UDP_BATCH		16					/**< Most datagrams received or sent with one system call. */
+
+int epoll_network(PDATA gameplay);
+
+#endif
@@ -9,9 +9,9 @@
 
 /** @} */
 #include "GameplayCommunication.h"
-#include "PipeUtils.h"
 #include "Packets.h" /* extern packet_sizes[] */
 #include "NetworkRouter.h"
+#include <cstddef> /* offsetof */
  
 uint32_t packet_sizes[NUM_PACKETS + 1] = {
 	sizeof(PKT_PLAYER_NAME),         // 0
@@ -29,98 +29,34 @@ uint32_t packet_sizes[NUM_PACKETS + 1] = {
 	sizeof(PKT_FLOOR_MOVE),          // 12
     sizeof(PKT_TAGGING),             // 13
     sizeof(PKT_POS_UPDATE_MIN),      // 14
-    sizeof(PKT_ALL_POS_UPDATE_MIN)   // 15
+    sizeof(PKT_ALL_POS_UPDATE_MIN),  // 15
+    sizeof(PKT_TAGGING_SEEN)         // 16
 };
 
-/**
- * A function for reading the type of the following data struct in the pipe.
- * 
- * @param[in]   fd  The file descriptor to read from.
- *
- * @return  <ul>
- *              <li>Returns type of the following data struct on a successful read from the pipe.</li>
- *              <li>Returns 99 if no data is found on the pipe.</li>
- *              <li>Returns 98 if there's an error while reading from the pipe. </li>
- *          </ul>
- *
- * @designer    Abhishek Bhardwaj
- * @author      Abhishek Bhardwaj
- */
-uint32_t read_type(int fd)
-{
-    uint32_t type;
-    int read_bytes;
-
-    if((read_bytes = read_pipe(fd, &type, sizeof(uint32_t))) <= 0)
-    {
-        if(read_bytes == 0)
-        {
-            perror("read_type: No data on pipe");
-            return 99;
-        }
-        perror("read_type: Error while reading from pipe");
-        return 98; //error .. check error
-    }
-
-    return type;
-}
-
-/**
- * A function for reading the packet from the pipe.
- * 
- * @param[in]   fd      The file descriptor to read from.
- * @param[in]   size    size of the data to be scanned from the file descriptor.
- *
- * @return  <ul>
- *              <li>Returns the scanned packet from the pipe if successful [Casted as void*].</li>
- *              <li>Returns NULL if there's an error while reading or if the there's nothing on the pipe.</li>
- *          </ul>
- *
- * @designer    Abhishek Bhardwaj
- * @author      Abhishek Bhardwaj
- */
-void* read_packet(int fd, uint32_t size)
-{
-    void *temp = calloc(1, size);
-	int read_bytes;
-
-    if((read_bytes = read_pipe(fd, temp, size)) == -1){
-        perror("Error on reading pipe : read_packet(int, uint32_t)");
-        return NULL;
-    }
-
-    if(read_bytes == 0){
-        perror("Nothing on pipe to read: read_packet(int, uint32_t)");
-        return NULL;
-    }
-
-    return temp; 
-}
-
 /**
  * Called by the main function of the game. Intializes the client network component of the game.
- * Requires 2 pipes as arguments, these will be passed for communication to network router. The 
- * read descriptor of rcv_router_fd will be passed to the update system by the game, while the 
- * write descriptor of the send_router_fd will be passed to the send_system.
+ * Creates the ring and the inbox used to talk to the network router. The game passes
+ * rcv_router_inbox to the update system and send_router_ring to the send system.
  * 
- * @param[in]   send_router_fd      Set of pipes created for passing data to the network router.
- * @param[in]   rcv_router_fd       Set of pipes created for grabbing data from the network router.
+ * @param[out]  send_router_ring    Receives the ring for passing data to the network router.
+ * @param[out]  rcv_router_inbox    Receives the inbox for grabbing data from the network router.
+ * @param[in]   ip                  The server's address.
  *
  * @return      void
  *
  * @designer    Ramzi Chennafi
  * @author      Ramzi Chennafi
  */
-void init_client_network(int send_router_fd[2], int rcv_router_fd[2], char * ip)
+void init_client_network(PacketRing **send_router_ring, PacketInbox **rcv_router_inbox, char * ip)
 {
     pthread_t thread;
     PDATA pdata = (PDATA) malloc(sizeof(WTHREAD_DATA));
    
-    create_pipe(send_router_fd);
-    create_pipe(rcv_router_fd);
+    *send_router_ring = create_ring();
+    *rcv_router_inbox = create_inbox();
     
-    pdata->read_pipe = send_router_fd[READ_END];
-    pdata->write_pipe = rcv_router_fd[WRITE_END];
+    pdata->read_ring = *send_router_ring;
+    pdata->inbox = *rcv_router_inbox;
     memcpy(pdata->ip, ip, MAXIP);
 
     pthread_create(&thread, NULL, networkRouter, (void *)pdata);
@@ -128,69 +64,77 @@ void init_client_network(int send_router_fd[2], int rcv_router_fd[2], char * ip)
 }
 
 /**
- * Writes the packet type, packet size, and the packet itself to the pipe specified by fd.
- * This function should be used in conjunction with read_data_size and read_packet to transfer
- * gameplay information between the gameplay and network client modules.
+ * Copies a packet into the next free slot of a ring and hands it to the thread reading the ring.
+ *
+ * Packets that are built by the caller anyway should be built straight into the slot with
+ * ring_reserve and ring_commit instead.
  * 
- * @param[in]   write_fd      The write end of a pipe (to gameplay or network module).
+ * @param[in]   ring          The ring to the next thread (gameplay, network router or send thread).
  * @param[in]   packet_type   The type of packet written, as defined in Packets.h
  * @param[in]   packet        A pointer to the packet structure.
+ * @param[in]   timestamp     The packet's timestamp, or 0 if it has none.
  *
  * @return      <ul>
  *                  <li>Returns 0 on a successful write.</li>
- *                  <li>Returns -1 if the write failed.</li>
+ *                  <li>Returns -1 if the ring is full.</li>
  *              </ul>
  *
  * @designer    Shane Spoor
  * @author      Shane Spoor
  */
-int write_packet(int write_fd, uint32_t packet_type, void *packet)
+int write_packet(PacketRing *ring, uint32_t packet_type, void *packet, uint64_t timestamp)
 {   
-    int temp;
-    if ((temp = write_pipe(write_fd, &packet_type, sizeof(packet_type))) <= 0)
+    void *slot;
+
+    if((slot = ring_reserve(ring)) == NULL)
     {
-        perror("write_packet: Failed to write packet");
+        fprintf(stderr, "write_packet: Ring full, dropping packet type %u\n", packet_type);
         return -1;
     }
-	
-    if((temp = write_pipe(write_fd, packet, packet_sizes[packet_type - 1])) <= 0)
-	{
-		perror("write_packet: Failed to write packet");
-		return -1;
-	}
+
+    memcpy(slot, packet, packet_sizes[packet_type - 1]);
+    ring_commit(ring, packet_type, timestamp);
 
 	return 0; 
 }
 
 /**
- * A wrapper function around read_type() and read_packet() for reading data from the pipe 
- * and returning it.
- * 
- * @param[in]   fd      The file descriptor to read from.
- * @param[in]   type    A pointer to the packet type.
+ * Finds the size of the packet in a datagram from the server.
  *
- * @return      <ul>
- *                  <li>Returns the packet if successful.</li>
- *                  <li>Returns NULL if it fails to read either of the type or the packet from the pipe.</li>
- *              </ul>
+ * A datagram holds the packet type, the packet and an 8 byte timestamp. Servers from before
+ * movement steps were numbered send position updates without the seq and ack fields on the
+ * end, so a datagram that is only long enough for the older layout is still accepted; the
+ * caller zeroes the missing fields, which means "no step".
  *
- * @designer    Ramzi Chennafi
- * @author      Ramzi Chennafi
+ * @param[in] packet_type The packet's type; must be between 1 and NUM_PACKETS.
+ * @param[in] len         The datagram's length.
+ *
+ * @return The number of bytes of packet in the datagram, or 0 if it's too short.
+ *
+ * @designer
+ * @author
  */
-void *read_data(int fd, uint32_t *type){
+uint32_t datagram_packet_size(uint32_t packet_type, uint32_t len)
+{
+    uint32_t size = packet_sizes[packet_type - 1];
 
-    void *packet;
-    *type = read_type(fd);
-    if(*type <= 0 || *type > NUM_PACKETS){
-        perror("read_data: Failed to read packet type from pipe");
-        return NULL;
-    }
+    if(len >= sizeof(uint32_t) + size + sizeof(uint64_t))
+        return size;
 
-    if((packet = read_packet(fd, packet_sizes[*type - 1])) == NULL){
-        printf("read_data: Failed to read packet\n");
-        return NULL;
+    switch(packet_type)
+    {
+    case P_POSUPDATE:
+        size = offsetof(PKT_POS_UPDATE, seq);
+        break;
+    case G_ALLPOSUPDATE:
+        size = offsetof(PKT_ALL_POS_UPDATE, ack);
+        break;
+    case P_MIN_POS_ALL:
+        size = offsetof(PKT_ALL_POS_UPDATE_MIN, ack);
+        break;
+    default:
+        return 0;
     }
 
-    return packet;
+    return len >= sizeof(uint32_t) + size + sizeof(uint64_t) ? size : 0;
 }
-
@@ -16,6 +16,8 @@
 #include <cerrno>
 #include <cstring>
 #include <pthread.h>
+#include "PacketRing.h"
+#include "PacketMailbox.h"
 
 #define NET_SHUTDOWN    -1 /**< The network will write this to the gameplay 
                              module (possibly followed by an error message) on shutdown. */
@@ -28,21 +30,17 @@
  */
 typedef struct THREAD_DATA
 {
-    int read_pipe;  /**< pipe descriptor for reading */
-    int write_pipe; /**< pipe descriptor for writing */
+    PacketRing *read_ring;  /**< ring of packets from gameplay */
+    PacketInbox *inbox;     /**< queue and mailboxes of packets to gameplay */
     char ip[MAXIP]; /**< ip address of the server */
 } WTHREAD_DATA, *PDATA;
 
-/* Packet reading wrappers */
-void *read_data(int fd, uint32_t *type);
-uint32_t read_type(int fd);
-void *read_packet(int fd, uint32_t size);
-
 /* Packet writing wrapper */
-int write_packet(int write_fd, uint32_t packet_type, void *packet);
+int write_packet(PacketRing *ring, uint32_t packet_type, void *packet, uint64_t timestamp);
+uint32_t datagram_packet_size(uint32_t packet_type, uint32_t len);
 
 /* Gameplay wrapper */
 int update_data(void* packet, int fd);
-void init_client_network(int send_router_fd[2], int rcv_router_fd[2], char * ip);
+void init_client_network(PacketRing **send_router_ring, PacketInbox **rcv_router_inbox, char * ip);
 
 #endif
@@ -13,15 +13,11 @@
 #include "Packets.h"
 #include "ServerCommunication.h"
 #include "GameplayCommunication.h"
-#include "PipeUtils.h"
 #include "NetworkRouter.h"
-#include <list>
+#include "EpollNetwork.h"
 
-extern int game_net_signalfd;
 extern int network_ready;
 extern uint32_t packet_sizes[NUM_PACKETS];
-static int chat_packets_rcv = 0;
-static std::list<PKT_SND_CHAT*> cached_chat;
 sem_t err_sem;
 int send_failure_fd;
 
@@ -35,8 +31,13 @@ int send_failure_fd;
  *
  * It will automatically determine the origin and destination of each data packet and deliver it.
  *
- * Uses both TCP and UDP to communicate with the server and uses the good old IPC pipes for communicating
- * with the gameplay module.
+ * Uses both TCP and UDP to communicate with the server and uses packet rings for communicating
+ * with the gameplay module and the send and receive threads. Packets from the server are passed
+ * on to gameplay's inbox as soon as they arrive. The router only sleeps in select()
+ * once both rings it reads are empty and armed to wake it.
+ *
+ * With EPOLL_NETWORK on, the router does all of this itself in one epoll loop (see
+ * EpollNetwork.cpp), and only starts the SDL_net threads if epoll isn't available.
  * 
  * @param[in]   args  A void pointer to the PDATA data structure.
  *
@@ -49,142 +50,129 @@ int send_failure_fd;
  */
 void *networkRouter(void *args)
 {
-    int 		sendfd[2];
-    int 		recvfd[2];
     fd_set 		listen_fds;
     fd_set		active;
     int 		max_fd;
+    bool		running = true;
     uint32_t 	type;
-    uint64_t	timestamps[NUM_PACKETS] = {0}, timestamp;
-    void 		*packet, *cached_packets[NUM_PACKETS] = {0};
+    uint64_t	timestamp;
+    void 		*packet;
     pthread_t 	thread_send;
     pthread_t 	thread_receive;
     PDATA 		gameplay = (PDATA)args;
     
-    NDATA 		send_data = (NDATA) malloc(sizeof(WNETWORK_DATA));
-    NDATA 		receive_data = (NDATA) malloc(sizeof(WNETWORK_DATA));
+    NDATA 		send_data = (NDATA) calloc(1, sizeof(WNETWORK_DATA));
+    NDATA 		receive_data = (NDATA) calloc(1, sizeof(WNETWORK_DATA));
 
     sem_init(&err_sem, 0, 1);
 
-    if(init_router(&max_fd, send_data, receive_data, gameplay, sendfd, recvfd, &thread_receive, &thread_send, gameplay->ip) == -1)
+#if EPOLL_NETWORK
+    if(epoll_network(gameplay) == 0)
+    {
+        free(send_data);
+        free(receive_data);
+        return NULL;
+    }
+    fprintf(stderr, "networkRouter: epoll isn't available, using SDL_net instead\n");
+#endif
+
+    if(init_router(&max_fd, send_data, receive_data, gameplay, &thread_receive, &thread_send, gameplay->ip) == -1)
     {     
-        net_cleanup(send_data, receive_data, gameplay, cached_packets);
+        net_cleanup(send_data, receive_data, gameplay);
     	return NULL;
     }
 	
     FD_ZERO(&listen_fds);
-    FD_SET(recvfd[READ_END], &listen_fds);
-    FD_SET(gameplay->read_pipe, &listen_fds);
-    FD_SET(game_net_signalfd, &listen_fds);
+    FD_SET(receive_data->ring->event_fd, &listen_fds);
+    FD_SET(gameplay->read_ring->event_fd, &listen_fds);
     FD_SET(send_failure_fd, &listen_fds);
 
     network_ready = 1;
 
-    while(1)
+    while(running)
     {
     	int ret;
+        bool armed;
+        struct timeval no_wait = {0, 0};
+
+        // Only block if both rings are empty; otherwise just check the descriptors and get on with it
+        armed = ring_arm(receive_data->ring);
+        if(armed && !(armed = ring_arm(gameplay->read_ring)))
+            ring_disarm(receive_data->ring);
+
         active = listen_fds;
-        ret = select(max_fd + 1, &active, NULL, NULL, NULL);
+        ret = select(max_fd + 1, &active, NULL, NULL, armed ? NULL : &no_wait);
 
-        if(ret && FD_ISSET(send_failure_fd, &active))
+        if(armed)
+        {
+            ring_disarm(gameplay->read_ring);
+            ring_disarm(receive_data->ring);
+        }
+
+        if(ret > 0 && FD_ISSET(send_failure_fd, &active))
         	break;
 
-        if(ret && FD_ISSET(recvfd[READ_END], &active))
+        while(running && (packet = ring_peek(receive_data->ring, &type, &timestamp)) != NULL)
         {
-			packet = read_data(recvfd[READ_END], &type);
-
-            if(!packet)
+            if(type == 0 || type > NUM_PACKETS)
             {
+                running = false;
                 break;
             }
             
-            if(type == P_CHAT)
-            {
-                read(recvfd[READ_END], &timestamp, sizeof(timestamp));
-                chat_packets_rcv++;
-                cached_chat.push_back((PKT_SND_CHAT*)packet);
-            }
-            else
-            {
-    			read(recvfd[READ_END], &timestamp, sizeof(timestamp));
-                if(timestamps[type - 1] < timestamp)     // If the received packet is more recent, replace the cached one
-                {
-                    timestamps[type - 1] = timestamp;
-                    free(cached_packets[type - 1]);
-                    cached_packets[type - 1] = packet;
-                }
-                else                                    // Otherwise discard it
-                    free(packet);
-            }
-			--ret;
+            update_gameplay(gameplay->inbox, type, packet, timestamp, 0);
+            ring_release(receive_data->ring);
         }
 
-        if(ret && FD_ISSET(gameplay->read_pipe, &active))
+        while(running && (packet = ring_peek(gameplay->read_ring, &type, NULL)) != NULL)
         {
-        	packet = read_data(gameplay->read_pipe, &type);
-            if(!packet)
+            if(type == 0 || type > NUM_PACKETS)
             {
+                running = false;
                 break;
             }
             
-            write_packet(sendfd[WRITE_END], type, packet);
-			
-            --ret;
+            write_packet(send_data->ring, type, packet, 0);
+            ring_release(gameplay->read_ring);
         }
-
-        if(ret && FD_ISSET(game_net_signalfd, &active))
-        {
-        	if(update_gameplay(gameplay->write_pipe, cached_packets, timestamps) == -1)
-                return NULL;
-
-            --ret;
-		}
     }
 
-    pthread_cancel(thread_receive);
-    pthread_cancel(thread_send);
-    // Kill the send thread... forgot how this was supposed to happen, oops
-    net_cleanup(send_data, receive_data, gameplay, cached_packets);
+    stop_threads(send_data, receive_data, thread_send, thread_receive);
+    net_cleanup(send_data, receive_data, gameplay);
     return NULL;
 }
+
 /**
- * Sends all cached chat packets down the gameplay pipe.
+ * Stops the send and receive threads and waits for them to return, so that the rings,
+ * pools and sockets they use can be freed.
  *
- * Takes the linked CHAT_LIST and sends all its chat packets to gameplay for processing.
+ * The send thread is woken and returns once it sees its stop flag. It's joined before the
+ * receive thread is cancelled, as the receive thread closes the sockets on its way out.
+ * The receive thread only acts on the cancel while waiting on its sockets, never part way
+ * through passing a packet on.
  *
- * @return  <ul>
- *              <li>0 on success, or -1 on failure.</li>
- *          </ul>
+ * @param[in] send           The send thread's data.
+ * @param[in] receive        The receive thread's data.
+ * @param[in] thread_send    The send thread.
+ * @param[in] thread_receive The receive thread.
  *
- * @designer Ramzi Chennafi
- * @author   Ramzi Chennafi
+ * @designer
+ * @author
  */
-int send_cached_chat(int gameplay_write_fd)
+void stop_threads(NDATA send, NDATA receive, pthread_t thread_send, pthread_t thread_receive)
 {
-    uint32_t type = P_CHAT;
-    for(int i = 0; i < chat_packets_rcv; i++)
-    {
-        if(write(gameplay_write_fd, &type, sizeof(type)) == -1 ||
-           write(gameplay_write_fd, cached_chat.front(), packet_sizes[P_CHAT - 1]) == -1)
-        {
-            perror("update_gameplay: write");
-            return -1;
-        }
+    __atomic_store_n(&send->stop, 1, __ATOMIC_RELEASE);
+    ring_kick(send->ring);
+    pthread_join(thread_send, NULL);
 
-        free(cached_chat.front());
-        cached_chat.pop_front();
-
-    }
-    
-    chat_packets_rcv = 0;
-
-    return 0;
+    pthread_cancel(thread_receive);
+    pthread_join(thread_receive, NULL);
 }
 /**
  * Creates and dispatches a new thread.
  *
- * The thread runs independently of the thread that distpaches it. The thread handle is
- * stored in @a handle.
+ * The thread handle is stored in @a handle. The thread must be joined before anything
+ * passed to it is freed.
  * 
  * @param[in]  function	Function which the new thread will run.
  * @param[in]  params	The parameter(s) to pass to the thread function.
@@ -199,53 +187,23 @@ int send_cached_chat(int gameplay_write_fd)
  */
 int dispatch_thread(void *(*function)(void *), void *params, pthread_t *handle)
 {
-	if(pthread_create(handle, NULL, function, params) == -1)
+	int err;
+
+	if((err = pthread_create(handle, NULL, function, params)) != 0)
 	{
-		perror("dispatch_thread");
+		fprintf(stderr, "dispatch_thread: %s\n", strerror(err));
 		return -1;
 	}
 
-	pthread_detach(*handle);
 	return 0;
 }
 
-/**
- * Determines which packets have new data.
- *
- * 
- * @param   packets     The array containing all currently cached packets.
- * @param   changed     A mask indicating which packets have new data.
- *
- * @return <ul> 
- *              <li>The number of packets with new data.</li>
- *         </ul>
- *
- * @author 		Shane Spoor
- * @designer 	Shane Spoor
- */
-uint32_t determine_changed(void **packets, unsigned *changed)
-{
-	size_t i;
-	uint32_t nchanged = 0;
-	
-	for(i = 0; i < NUM_PACKETS; ++i)
-	{
-		if(packets[i])
-		{
-			*changed |= 1 << i;
-			++nchanged;
-		}
-	}
-	
-	return nchanged + chat_packets_rcv;
-}
-
 /**
  * Tells the gameplay module that network is shutting down, possibly with an error message.
  *
- * Writes the network shutdown code to 
+ * Writes a NET_SHUTDOWN packet holding the error string, or an empty string, to gameplay.
  *
- * @param[in] gameplay_pipe The write end of the pipe to gameplay.
+ * @param[in] gameplay_ring The ring to gameplay.
  * @param[in] err_str       The error string; may be null.
  *
  * @designer Shane Spoor
@@ -253,21 +211,19 @@ uint32_t determine_changed(void **packets, unsigned *changed)
  *
  * @date March 14, 2014
  */
-void write_shutdown(int gameplay_pipe, const char *err_str)
+void write_shutdown(PacketRing *gameplay_ring, const char *err_str)
 {
-    uint32_t shutdown = (uint32_t)NET_SHUTDOWN;
+    char *slot;
 
-    /* Tell gameplay we're shutting down */
-    write_pipe(gameplay_pipe, &shutdown, sizeof(shutdown));
-    shutdown = 0;
-    if(err_str) // if there was an error, write the error string to the pipe
+    if((slot = (char *)ring_reserve(gameplay_ring)) == NULL)
     {
-        shutdown = strlen(err_str);
-        write_pipe(gameplay_pipe, &shutdown, sizeof(shutdown));
-        write_pipe(gameplay_pipe, err_str, shutdown);
+        fprintf(stderr, "write_shutdown: Ring to gameplay is full\n");
+        return;
     }
-    else
-        write_pipe(gameplay_pipe, &shutdown, sizeof(shutdown)); // write 0 instead (no string)
+
+    /* Tell gameplay we're shutting down, with the error string if there was an error */
+    snprintf(slot, gameplay_ring->slot_size, "%s", err_str ? err_str : "");
+    ring_commit(gameplay_ring, (uint32_t)NET_SHUTDOWN, 0);
     
     return;
 }
@@ -275,12 +231,11 @@ void write_shutdown(int gameplay_pipe, const char *err_str)
 /**
  * Initialises the variables used in the router thread or the send/receive threads.
  *
- * @param[out] max_fd         The highest value of the gameplay write file descriptor, the receive
- *                            thread read file descriptor, and the semaphore file descriptor (for select()).
+ * @param[out] max_fd         The highest value of the two rings' eventfds and the send failure
+ *                            eventfd (for select()).
  * @param[out] send           Pointer to a struct to contain the data passed to the send thread.
  * @param[out] receive        Pointer to a struct to contain the data passed to the receive thread.
  * @param[out] gameplay       Pointer to a struct containing the objects necessary for communication with gameplay.
- * @param[out] fd             An integer array to hold two ends of a pipe.
  * @param[out] thread_receive Holds a handle to the receive thread.
  * @param[out] thread_send    Holds a handle to the send thread.
  *
@@ -293,8 +248,8 @@ void write_shutdown(int gameplay_pipe, const char *err_str)
  *
  * @author   Shane Spoor
  */
-int init_router(int *max_fd, NDATA send, NDATA receive, PDATA gameplay, int sendfd[2], 
-				int recvfd[2], pthread_t *thread_receive, pthread_t *thread_send, char* ip)
+int init_router(int *max_fd, NDATA send, NDATA receive, PDATA gameplay,
+				pthread_t *thread_receive, pthread_t *thread_send, char* ip)
 {
     IPaddress ipaddr, udpaddr;
 	TCPsocket tcp_sock;
@@ -303,15 +258,24 @@ int init_router(int *max_fd, NDATA send, NDATA receive, PDATA gameplay, int send
 	
     send_failure_fd = eventfd(0, 0);
 
-	if(create_pipe(sendfd) == -1 ||
-	   create_pipe(recvfd) == -1)
+    send->ring = create_ring();
+    receive->ring = create_ring();
+    send->pool = create_pool();
+    receive->pool = create_pool();
+
+	if(!send->ring || !receive->ring || !gameplay->read_ring || !gameplay->inbox)
     {
         set_error(ERR_IPC_FAIL);
         return -1;
     }
 
-    *max_fd = recvfd[READ_END] > gameplay->read_pipe ? recvfd[READ_END] : gameplay->read_pipe;
-    *max_fd = game_net_signalfd > *max_fd ? game_net_signalfd : *max_fd;
+    if(!send->pool || !receive->pool)
+    {
+        set_error(ERR_NO_MEM);
+        return -1;
+    }
+
+    *max_fd = receive->ring->event_fd > gameplay->read_ring->event_fd ? receive->ring->event_fd : gameplay->read_ring->event_fd;
     *max_fd = send_failure_fd > *max_fd ? send_failure_fd : *max_fd;
 
     /* Initialize SDL_net */
@@ -361,15 +325,17 @@ int init_router(int *max_fd, NDATA send, NDATA receive, PDATA gameplay, int send
     receive->tcp_sock = tcp_sock;
     receive->udp_sock = udp_sock;
 
-    send->read_pipe = sendfd[READ_END];
-    send->write_pipe = sendfd[WRITE_END];
-
-    receive->read_pipe = recvfd[READ_END];
-    receive->write_pipe = recvfd[WRITE_END];
+	if(dispatch_thread(send_thread_func, (void *)send, thread_send) == -1)
+    {
+        set_error(ERR_ROUTER_INIT);
+        return -1;
+    }
 
-	if(dispatch_thread(send_thread_func, (void *)send, thread_send) == -1 ||
-        dispatch_thread(recv_thread_func, (void *)receive, thread_receive) == -1)
+    if(dispatch_thread(recv_thread_func, (void *)receive, thread_receive) == -1)
     {
+        __atomic_store_n(&send->stop, 1, __ATOMIC_RELEASE);
+        ring_kick(send->ring);
+        pthread_join(*thread_send, NULL);
         set_error(ERR_ROUTER_INIT);
         return -1;
     }
@@ -378,15 +344,21 @@ int init_router(int *max_fd, NDATA send, NDATA receive, PDATA gameplay, int send
 }
 
 /**
- * Initialises the variables used in the router thread or the send/receive threads.
+ * Passes a packet from the server to gameplay.
  *
- * @param[in] gameplay_write_fd Write end of the pipe to the client/gameplay update system.
- * @param[in] packets           The latest packets received from the server.
- * @param[in] timestamps        An array of timestamps associated with each packet.
+ * Packets that describe the current state replace the one in their type's mailbox if they
+ * are newer. Every other packet is added to gameplay's queue, in the order it arrived.
+ *
+ * @param[in] inbox     Gameplay's inbox.
+ * @param[in] type      The packet's type.
+ * @param[in] packet    The packet.
+ * @param[in] timestamp The packet's timestamp.
+ * @param[in] received  When the packet reached the socket, in CLOCK_REALTIME ns, or 0 if unknown.
+ *                      Only kept for packets that go in a mailbox.
  *
  * @return <ul>
  *              <li>0 on success</li>
-                <li>-1 on failure.</li>
+ *              <li>-1 if gameplay's queue is full and the packet was dropped.</li>
  *         </ul>
  *
  * @designer Shane Spoor
@@ -394,47 +366,15 @@ int init_router(int *max_fd, NDATA send, NDATA receive, PDATA gameplay, int send
  *
  * @date March 12, 2014
  */
-int update_gameplay(int gameplay_write_fd, void **packets, uint64_t *timestamps)
+int update_gameplay(PacketInbox *inbox, uint32_t type, void *packet, uint64_t timestamp, uint64_t received)
 {
-    uint32_t num_changed;
-    uint64_t sem_buf;
-    unsigned changed_mask = 0;
-
-    read(game_net_signalfd, &sem_buf, sizeof(uint64_t)); /* Receive the signal */
-    num_changed = determine_changed(packets, &changed_mask);
-
-    if(write(gameplay_write_fd, &num_changed, sizeof(num_changed)) == -1)
-    {
-        perror("update_gameplay: write");
-        return -1;
-    }
-
-    if(!num_changed)
+    if(inbox->latest[type - 1])
     {
+        mailbox_post(inbox->latest[type - 1], packet, timestamp, received);
         return 0;
     }
 
-    for(uint32_t type = 1, idx = 0; type <= NUM_PACKETS; ++type, ++idx) // type = packet type, idx = index in packet array
-    {
-        if(changed_mask & (1 << idx))
-        {   
-            if(write(gameplay_write_fd, &type, sizeof(type)) == -1 ||
-               write(gameplay_write_fd, packets[idx], packet_sizes[idx]) == -1)
-            {
-                perror("update_gameplay: write");
-                return -1;
-            }
-            free(packets[idx]);
-            packets[idx] = NULL;
-        }
-    }
-
-    if(send_cached_chat(gameplay_write_fd) == -1)
-    {
-        return -1;
-    }
-
-    return 0;
+    return write_packet(inbox->queue, type, packet, timestamp);
 }
 
 /**
@@ -443,61 +383,40 @@ int update_gameplay(int gameplay_write_fd, void **packets, uint64_t *timestamps)
  * The thread also notifies the gameplay side that the network module is closing down,
  * possibly also sending an error message to be passed along to the user.
  *
- * @param[in] send           The send thread's data (socket and pipe descriptors).
- * @param[in] received       The receive thread's data (socket and pipe descriptors).
- * @param[in] cached_packets The array of cached packets.
- *
+ * @param[in] send           The send thread's data (sockets and ring).
+ * @param[in] received       The receive thread's data (sockets and ring).
+ * @param[in] gameplay       The rings to and from gameplay.
  *
  * @designer Shane Spoor
  * @author   Shane Spoor
  *
  * @date March 14, 2014
  */
-void net_cleanup(NDATA send_data, NDATA receive_data, PDATA gameplay, void **cached_packets)
+void net_cleanup(NDATA send_data, NDATA receive_data, PDATA gameplay)
 {
-    unsigned int changed_mask = 0;
-    
-    /* Close pipes for thread communication, checking that they're valid first */
-    if(fcntl(send_data->read_pipe, F_GETFD) != -1 || errno != EBADF)
-    {
-        close(send_data->read_pipe);
-        close(send_data->write_pipe);
-    }
-    if(fcntl(receive_data->read_pipe, F_GETFD) != -1 || errno != EBADF)
-    {
-        close(receive_data->read_pipe);
-        close(receive_data->write_pipe);
-    }
+    /* Free the rings for thread communication and the threads' packet buffers */
+    destroy_ring(send_data->ring);
+    destroy_ring(receive_data->ring);
+    destroy_pool(send_data->pool);
+    destroy_pool(receive_data->pool);
+    printf("Network: %llu packet buffers were allocated from the heap\n", (unsigned long long)packet_heap_allocs());
     
     /* Free NDATA */
     free(send_data);
     free(receive_data);
 
-    write_shutdown(gameplay->write_pipe, get_error_string());
-
-    /* Free any remaining packets */
-    determine_changed(cached_packets, &changed_mask);
-    for(int i = 0; i < NUM_PACKETS - 1; ++i)
-    {
-        if(changed_mask & (1 << i))
-        {
-            free(cached_packets[i]);
-            cached_packets[i] = NULL;
-        }
-    }
+    if(gameplay->inbox)
+        write_shutdown(gameplay->inbox->queue, get_error_string());
 
     /* Close send thread's eventfd */
     close(send_failure_fd);
 }
 /*
 
-The gameplay module will basically create the pipe and call the networkRouter() function
-with the newly created pipe.
-
-Wrapper functions for creating the pipe, reading and writing to/from the pipe are present
-in the Functions.cpp file.
+The gameplay module will basically create the ring and inbox and call the networkRouter()
+function with them.
 
-All the functions that the gameplay side will need to use to read/write to the pipe are
-present in GameplayCommunication.cpp and Functions.cpp
+The ring functions are in PacketRing.cpp and the inbox functions in PacketMailbox.cpp. All the functions that the gameplay side will
+need to use to write to the rings are present in GameplayCommunication.cpp and SendSystem.cpp
 
 */
@@ -11,12 +11,19 @@
 
 #include <SDL2/SDL_net.h>
 #include <semaphore.h>
+#include <pthread.h>
+#include <string.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <fcntl.h>
 #include <sys/eventfd.h>
+#include "PacketRing.h"
+#include "PacketMailbox.h"
+#include "PacketPool.h"
+
+#define EPOLL_NETWORK		1 /**< 1 = one epoll network thread on raw sockets, 0 = SDL_net send and receive threads */
 
 #define READ_RECV_THREAD	0
 #define WRITE_SEND_THREAD 	1
@@ -29,15 +36,16 @@
 
 /**
  * A structure of data that will be passed on to child threads.
- * Contains read and write descriptors for communication with gameplay pipes
- * and TCP and UDP sockets for communication with the server.
+ * Contains the ring between the router and the thread, the thread's packet buffers, and TCP
+ * and UDP sockets for communication with the server.
  *
  * @struct WNETWORK_DATA, *NDATA
  */
 typedef struct NETWORK_DATA
 {
-    int         read_pipe;      /**< pipe descriptor for reading */
-    int         write_pipe;     /**< pipe descriptor for writing */
+    PacketRing  *ring;          /**< ring of packets between the router and the thread */
+    PacketPool  *pool;          /**< the thread's packet buffers */
+    int         stop;           /**< set by the router to tell the send thread to return */
     TCPsocket   tcp_sock;       /**< TCP socket for server communication */
     UDPsocket   udp_sock;       /**< UDP socket for server communication */
 } WNETWORK_DATA, *NDATA;
@@ -45,15 +53,13 @@ typedef struct NETWORK_DATA
 
 void *networkRouter(void *args);
 int dispatch_thread(void *(*function)(void *), void *params, pthread_t *handle);
-int update_gameplay(int gameplay_write_fd, void **packets, uint64_t *timestamps);
-uint32_t determine_changed(void **packets, unsigned *changed);
-int init_router(int *max_fd, NDATA send, NDATA receive, PDATA gameplay, int sendfd[2],
-				int recvfd[2], pthread_t *thread_receive, pthread_t *thread_send, char * ip);
-void net_cleanup(NDATA send_data, NDATA receive_data, PDATA gameplay, void **cached_packets);
-void write_shutdown(int gameplay_pipe, const char *err_str, int err_size);
-int cache_chat(PKT_SND_CHAT * packet);
-int send_cached_chat();
-void nonexit_net_cleanup(NDATA send_data, NDATA receive_data, PDATA gameplay, void **cached_packets);
+int update_gameplay(PacketInbox *inbox, uint32_t type, void *packet, uint64_t timestamp, uint64_t received);
+int init_router(int *max_fd, NDATA send, NDATA receive, PDATA gameplay,
+				pthread_t *thread_receive, pthread_t *thread_send, char * ip);
+void stop_threads(NDATA send, NDATA receive, pthread_t thread_send, pthread_t thread_receive);
+void net_cleanup(NDATA send_data, NDATA receive_data, PDATA gameplay);
+void write_shutdown(PacketRing *gameplay_ring, const char *err_str);
+
 
 #endif
 
@@ -0,0 +1,198 @@
+/** @ingroup Network */
+/** @{ */
+
+/**
+ * Latest-wins mailboxes for the packets the network router passes to gameplay, and the
+ * inbox that decides which packet types use them.
+ *
+ * @file PacketMailbox.cpp
+ */
+
+/** @} */
+#include "PacketMailbox.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAILBOX_FRESH	4	/**< Set in middle when the middle buffer holds a packet the reader hasn't taken. */
+
+extern uint32_t packet_sizes[NUM_PACKETS + 1];
+
+/**
+ * The packet types that describe the current state of the game, for which only the
+ * latest packet matters. All other types are queued.
+ */
+static const uint32_t latest_types[] = {
+	G_STATUS,
+	P_OBJSTATUS,
+	P_POSUPDATE,
+	G_ALLPOSUPDATE
+};
+
+/**
+ * Creates an empty mailbox.
+ *
+ * @param[in] size The size of the packets it holds.
+ *
+ * @return The mailbox, or NULL if it couldn't be allocated.
+ *
+ * @designer
+ * @author
+ */
+PacketMailbox *create_mailbox(uint32_t size)
+{
+	PacketMailbox *box = (PacketMailbox *)calloc(1, sizeof(PacketMailbox));
+
+	if(!box || !(box->data = (unsigned char *)calloc(3, size)))
+	{
+		perror("create_mailbox: calloc");
+		free(box);
+		return NULL;
+	}
+
+	box->size   = size;
+	box->front  = 0;
+	box->middle = 1;
+	box->back   = 2;
+	return box;
+}
+
+/**
+ * Frees a mailbox. Neither thread may use it afterwards.
+ *
+ * @param[in] box The mailbox to free; may be NULL.
+ *
+ * @designer
+ * @author
+ */
+void destroy_mailbox(PacketMailbox *box)
+{
+	if(!box)
+		return;
+
+	free(box->data);
+	free(box);
+}
+
+/**
+ * Puts a packet in the mailbox, replacing any packet the reader hasn't taken yet.
+ *
+ * Packets older than the newest one posted are dropped, since UDP can deliver them out
+ * of order.
+ *
+ * @param[in] box       The mailbox to write to.
+ * @param[in] packet    The packet.
+ * @param[in] timestamp The packet's timestamp.
+ * @param[in] received  When the packet reached the socket, in CLOCK_REALTIME ns, or 0 if unknown.
+ *
+ * @return true if the packet was posted, false if it was older than the last one.
+ *
+ * @designer
+ * @author
+ */
+bool mailbox_post(PacketMailbox *box, const void *packet, uint64_t timestamp, uint64_t received)
+{
+	unsigned int old;
+
+	if(timestamp <= box->newest)
+		return false;
+
+	box->newest = timestamp;
+	memcpy(box->data + (size_t)box->back * box->size, packet, box->size);
+	box->timestamps[box->back] = timestamp;
+	box->received[box->back]   = received;
+
+	old = __atomic_exchange_n(&box->middle, box->back | MAILBOX_FRESH, __ATOMIC_ACQ_REL);
+	box->back = old & ~MAILBOX_FRESH;
+	return true;
+}
+
+/**
+ * Takes the latest packet from the mailbox if one has been posted since the last take.
+ *
+ * @param[in]  box       The mailbox to read from.
+ * @param[out] timestamp Receives the packet's timestamp; may be NULL.
+ * @param[out] received  Receives when the packet reached the socket, or 0; may be NULL.
+ *
+ * @return The packet, good until the next take, or NULL if there's nothing new.
+ *
+ * @designer
+ * @author
+ */
+void *mailbox_take(PacketMailbox *box, uint64_t *timestamp, uint64_t *received)
+{
+	unsigned int old;
+
+	if(!(__atomic_load_n(&box->middle, __ATOMIC_RELAXED) & MAILBOX_FRESH))
+		return NULL;
+
+	old = __atomic_exchange_n(&box->middle, box->front, __ATOMIC_ACQ_REL);
+	box->front = old & ~MAILBOX_FRESH;
+
+	if(timestamp)
+		*timestamp = box->timestamps[box->front];
+	if(received)
+		*received = box->received[box->front];
+	return box->data + (size_t)box->front * box->size;
+}
+
+/**
+ * Creates the queue and the mailboxes the network router fills for gameplay.
+ *
+ * @return The inbox, or NULL if it couldn't be allocated.
+ *
+ * @designer
+ * @author
+ */
+PacketInbox *create_inbox()
+{
+	PacketInbox *inbox = (PacketInbox *)calloc(1, sizeof(PacketInbox));
+	unsigned int i;
+
+	if(!inbox)
+	{
+		perror("create_inbox: calloc");
+		return NULL;
+	}
+
+	if(!(inbox->queue = create_ring()))
+	{
+		destroy_inbox(inbox);
+		return NULL;
+	}
+
+	for(i = 0; i < sizeof(latest_types) / sizeof(latest_types[0]); ++i)
+	{
+		uint32_t type = latest_types[i];
+
+		if(!(inbox->latest[type - 1] = create_mailbox(packet_sizes[type - 1])))
+		{
+			destroy_inbox(inbox);
+			return NULL;
+		}
+	}
+
+	return inbox;
+}
+
+/**
+ * Frees an inbox, its queue and its mailboxes.
+ *
+ * @param[in] inbox The inbox to free; may be NULL.
+ *
+ * @designer
+ * @author
+ */
+void destroy_inbox(PacketInbox *inbox)
+{
+	unsigned int i;
+
+	if(!inbox)
+		return;
+
+	destroy_ring(inbox->queue);
+	for(i = 0; i < NUM_PACKETS; ++i)
+		destroy_mailbox(inbox->latest[i]);
+	free(inbox);
+}
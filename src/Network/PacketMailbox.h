@@ -0,0 +1,59 @@
+/** @ingroup Network */
+/** @{ */
+/**
+ * @file PacketMailbox.h
+ */
+/** @} */
+#ifndef PACKET_MAILBOX_H
+#define PACKET_MAILBOX_H
+
+#include <stdint.h>
+#include "Packets.h"
+#include "PacketRing.h"
+
+/**
+ * Holds the latest packet of one type from one thread for another thread.
+ *
+ * The packet is triple buffered. The writer fills its own buffer and swaps it for the
+ * middle one, and the reader swaps its own buffer for the middle one when the middle one
+ * is fresh. Neither side ever waits for the other, and a packet the reader hasn't taken
+ * yet is simply replaced.
+ *
+ * @struct PacketMailbox
+ */
+typedef struct
+{
+	unsigned int	middle;			/**< The middle buffer's index, or'd with MAILBOX_FRESH if it's unread. Swapped by both sides. */
+	unsigned int	back;			/**< The buffer the writer fills. Only the writer uses it. */
+	unsigned int	front;			/**< The buffer the reader last took. Only the reader uses it. */
+	uint64_t		newest;			/**< The newest timestamp posted. Only the writer uses it. */
+	uint64_t		timestamps[3];	/**< The timestamp of each buffer's packet. */
+	uint64_t		received[3];	/**< When each buffer's packet reached the socket, in CLOCK_REALTIME ns, or 0. */
+	uint32_t		size;			/**< The size of the packet. */
+	unsigned char	*data;			/**< Three buffers of size bytes. */
+} PacketMailbox;
+
+/**
+ * Everything the network router passes to gameplay.
+ *
+ * Packets that describe the current state (positions, statuses) go in a mailbox for
+ * their type, where only the latest is kept. Every other packet is an event that must
+ * not be lost, and goes through the queue in the order it arrived.
+ *
+ * @struct PacketInbox
+ */
+typedef struct
+{
+	PacketRing		*queue;					/**< Event packets, in order. */
+	PacketMailbox	*latest[NUM_PACKETS];	/**< The mailbox for each packet type that is latest-wins, or NULL. */
+} PacketInbox;
+
+PacketMailbox *create_mailbox(uint32_t size);
+void destroy_mailbox(PacketMailbox *box);
+bool mailbox_post(PacketMailbox *box, const void *packet, uint64_t timestamp, uint64_t received);
+void *mailbox_take(PacketMailbox *box, uint64_t *timestamp, uint64_t *received);
+
+PacketInbox *create_inbox();
+void destroy_inbox(PacketInbox *inbox);
+
+#endif
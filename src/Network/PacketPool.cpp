@@ -0,0 +1,143 @@
+/** @ingroup Network */
+/** @{ */
+
+/**
+ * Packet buffers for the send and receive threads, so that receiving and sending a
+ * packet doesn't allocate anything once the network is running.
+ *
+ * Each pool is only used by the thread that owns it. The count of buffers that had to come
+ * from the heap is shared by every pool, and is printed when the network shuts down; it
+ * should be 0.
+ *
+ * @file PacketPool.cpp
+ */
+
+/** @} */
+#include "PacketPool.h"
+#include "Packets.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+extern uint32_t packet_sizes[NUM_PACKETS + 1];
+
+static uint64_t heap_allocs = 0;
+
+/**
+ * Creates a pool with every buffer free, each large enough for any packet along with its
+ * type and timestamp.
+ *
+ * @return The pool, or NULL if it couldn't be allocated.
+ *
+ * @designer
+ * @author
+ */
+PacketPool *create_pool()
+{
+	PacketPool *pool = (PacketPool *)calloc(1, sizeof(PacketPool));
+	unsigned int i;
+
+	if(!pool)
+	{
+		perror("create_pool: calloc");
+		return NULL;
+	}
+
+	for(i = 0; i < NUM_PACKETS; ++i)
+	{
+		if(packet_sizes[i] > pool->buffer_size)
+			pool->buffer_size = packet_sizes[i];
+	}
+	pool->buffer_size = (pool->buffer_size + sizeof(uint32_t) + sizeof(uint64_t) + 7) & ~7u;
+
+	if(!(pool->data = (unsigned char *)malloc((size_t)pool->buffer_size * POOL_BUFFERS)))
+	{
+		perror("create_pool: malloc");
+		free(pool);
+		return NULL;
+	}
+
+	for(i = 0; i < POOL_BUFFERS; ++i)
+		pool->free[i] = pool->data + (size_t)i * pool->buffer_size;
+	pool->free_count = POOL_BUFFERS;
+
+	return pool;
+}
+
+/**
+ * Frees a pool. Buffers taken from it must not be used afterwards.
+ *
+ * @param[in] pool The pool to free; may be NULL.
+ *
+ * @designer
+ * @author
+ */
+void destroy_pool(PacketPool *pool)
+{
+	if(!pool)
+		return;
+
+	free(pool->data);
+	free(pool);
+}
+
+/**
+ * Takes a buffer of pool->buffer_size bytes from the pool.
+ *
+ * If the pool has none left, the buffer is allocated from the heap and counted.
+ *
+ * @param[in] pool The calling thread's pool.
+ *
+ * @return The buffer, or NULL if the pool was empty and the heap allocation failed.
+ *
+ * @designer
+ * @author
+ */
+void *pool_get(PacketPool *pool)
+{
+	void *buffer;
+
+	if(pool->free_count)
+		return pool->free[--pool->free_count];
+
+	__atomic_add_fetch(&heap_allocs, 1, __ATOMIC_RELAXED);
+	if(!(buffer = malloc(pool->buffer_size)))
+		perror("pool_get: malloc");
+
+	return buffer;
+}
+
+/**
+ * Gives a buffer taken with pool_get back to the pool it came from.
+ *
+ * @param[in] pool   The calling thread's pool.
+ * @param[in] buffer The buffer; may be NULL.
+ *
+ * @designer
+ * @author
+ */
+void pool_put(PacketPool *pool, void *buffer)
+{
+	unsigned char *bytes = (unsigned char *)buffer;
+
+	if(!bytes)
+		return;
+
+	if(bytes >= pool->data && bytes < pool->data + (size_t)pool->buffer_size * POOL_BUFFERS)
+		pool->free[pool->free_count++] = bytes;
+	else
+		free(buffer);
+}
+
+/**
+ * Gets the number of packet buffers every pool has had to allocate from the heap.
+ *
+ * @return The count since the program started.
+ *
+ * @designer
+ * @author
+ */
+uint64_t packet_heap_allocs()
+{
+	return __atomic_load_n(&heap_allocs, __ATOMIC_RELAXED);
+}
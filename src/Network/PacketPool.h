@@ -0,0 +1,37 @@
+/** @ingroup Network */
+/** @{ */
+/**
+ * @file PacketPool.h
+ */
+/** @} */
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <stdint.h>
+
+#define POOL_BUFFERS	4	/**< Buffers each pool holds. A thread only needs one or two at a time. */
+
+/**
+ * A fixed set of packet buffers belonging to one thread.
+ *
+ * The buffers are allocated with the pool, so taking one and giving it back never touches
+ * the heap. A buffer is only allocated from the heap if every one is in use, and those
+ * allocations are counted by packet_heap_allocs.
+ *
+ * @struct PacketPool
+ */
+typedef struct
+{
+	uint32_t		buffer_size;			/**< The room in each buffer: the largest packet, its type and its timestamp. */
+	unsigned int	free_count;				/**< Buffers not in use. */
+	unsigned char	*free[POOL_BUFFERS];	/**< The buffers not in use. */
+	unsigned char	*data;					/**< POOL_BUFFERS buffers of buffer_size bytes. */
+} PacketPool;
+
+PacketPool *create_pool();
+void destroy_pool(PacketPool *pool);
+void *pool_get(PacketPool *pool);
+void pool_put(PacketPool *pool, void *buffer);
+uint64_t packet_heap_allocs();
+
+#endif
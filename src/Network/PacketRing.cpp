@@ -0,0 +1,289 @@
+/** @ingroup Network */
+/** @{ */
+
+/**
+ * Single writer, single reader packet queues between the gameplay, router, send and
+ * receive threads.
+ *
+ * The writer fills the slot at head and then moves head on; the reader reads the slot
+ * at tail and then moves tail on. Neither index is written by both threads, so no lock
+ * is needed.
+ *
+ * A reader that runs out of packets sets waiting, checks the ring once more and then
+ * sleeps on the eventfd. A writer that finds waiting set after publishing a packet
+ * clears it and writes the eventfd. Both sides store before they load, so at least one
+ * of them sees the other, and a wakeup is never lost.
+ *
+ * @file PacketRing.cpp
+ */
+
+/** @} */
+#include "PacketRing.h"
+#include "Packets.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+
+extern uint32_t packet_sizes[NUM_PACKETS + 1];
+
+#define SHUTDOWN_MESSAGE_SIZE	128	/**< Room kept in each slot for the network's shutdown message. */
+
+/**
+ * Creates an empty ring with slots large enough for any packet.
+ *
+ * @return The ring, or NULL if it couldn't be allocated.
+ *
+ * @designer
+ * @author
+ */
+PacketRing *create_ring()
+{
+	PacketRing *ring = (PacketRing *)calloc(1, sizeof(PacketRing));
+	unsigned int i;
+
+	if(!ring)
+	{
+		perror("create_ring: calloc");
+		return NULL;
+	}
+
+	ring->slot_size = SHUTDOWN_MESSAGE_SIZE;
+	for(i = 0; i < NUM_PACKETS; ++i)
+	{
+		if(packet_sizes[i] > ring->slot_size)
+			ring->slot_size = packet_sizes[i];
+	}
+
+	ring->data = (unsigned char *)malloc((size_t)ring->slot_size * RING_SLOTS);
+	ring->event_fd = eventfd(0, 0);
+
+	if(!ring->data || ring->event_fd == -1)
+	{
+		perror("create_ring");
+		destroy_ring(ring);
+		return NULL;
+	}
+
+	return ring;
+}
+
+/**
+ * Frees a ring. Neither thread may use it afterwards.
+ *
+ * @param[in] ring The ring to free; may be NULL.
+ *
+ * @designer
+ * @author
+ */
+void destroy_ring(PacketRing *ring)
+{
+	if(!ring)
+		return;
+
+	if(ring->event_fd > 0)
+		close(ring->event_fd);
+	free(ring->data);
+	free(ring);
+}
+
+/**
+ * Gets the next free slot for the writer to build a packet in. The packet isn't seen
+ * by the reader until ring_commit.
+ *
+ * @param[in] ring The ring to write to.
+ *
+ * @return The slot, or NULL if the ring is full.
+ *
+ * @designer
+ * @author
+ */
+void *ring_reserve(PacketRing *ring)
+{
+	unsigned int head = ring->head;
+
+	if(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == RING_SLOTS)
+		return NULL;
+
+	return ring->data + (size_t)(head & (RING_SLOTS - 1)) * ring->slot_size;
+}
+
+/**
+ * Gets the number of free slots left for the writer.
+ *
+ * @param[in] ring The ring to write to.
+ *
+ * @return The number of packets that can be written before the ring is full.
+ *
+ * @designer
+ * @author
+ */
+unsigned int ring_space(PacketRing *ring)
+{
+	return RING_SLOTS - (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * Hands the packet in the slot from ring_reserve to the reader, waking it if it is
+ * asleep.
+ *
+ * @param[in] ring      The ring being written to.
+ * @param[in] type      The packet's type.
+ * @param[in] timestamp The packet's timestamp, or 0.
+ *
+ * @designer
+ * @author
+ */
+void ring_commit(PacketRing *ring, uint32_t type, uint64_t timestamp)
+{
+	unsigned int head = ring->head;
+	uint64_t wake = 1;
+
+	ring->types[head & (RING_SLOTS - 1)]      = type;
+	ring->timestamps[head & (RING_SLOTS - 1)] = timestamp;
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+
+	if(__atomic_load_n(&ring->waiting, __ATOMIC_SEQ_CST) && __atomic_exchange_n(&ring->waiting, 0, __ATOMIC_SEQ_CST))
+	{
+		if(write(ring->event_fd, &wake, sizeof(wake)) == -1)
+			perror("ring_commit: write");
+	}
+}
+
+/**
+ * Gets the oldest packet in the ring without taking it out.
+ *
+ * @param[in]  ring      The ring to read from.
+ * @param[out] type      Receives the packet's type.
+ * @param[out] timestamp Receives the packet's timestamp; may be NULL.
+ *
+ * @return The packet, good until ring_release, or NULL if the ring is empty.
+ *
+ * @designer
+ * @author
+ */
+void *ring_peek(PacketRing *ring, uint32_t *type, uint64_t *timestamp)
+{
+	unsigned int tail = ring->tail;
+
+	if(__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+		return NULL;
+
+	*type = ring->types[tail & (RING_SLOTS - 1)];
+	if(timestamp)
+		*timestamp = ring->timestamps[tail & (RING_SLOTS - 1)];
+
+	return ring->data + (size_t)(tail & (RING_SLOTS - 1)) * ring->slot_size;
+}
+
+/**
+ * Takes the packet from ring_peek out of the ring, giving its slot back to the writer.
+ *
+ * @param[in] ring The ring being read from.
+ *
+ * @designer
+ * @author
+ */
+void ring_release(PacketRing *ring)
+{
+	__atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Tells the writer the reader is about to sleep on the ring's eventfd, so the next
+ * packet written wakes it.
+ *
+ * @param[in] ring The ring being read from.
+ *
+ * @return true if the ring is empty and the reader may sleep, false if a packet came
+ *         in first.
+ *
+ * @designer
+ * @author
+ */
+bool ring_arm(PacketRing *ring)
+{
+	ring->armed = true;
+	__atomic_store_n(&ring->waiting, 1, __ATOMIC_SEQ_CST);
+
+	if(__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) != ring->tail)
+	{
+		ring_disarm(ring);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Undoes ring_arm once the reader is awake again. If the writer has already taken the
+ * wakeup, its write to the eventfd is read back so it doesn't wake the reader later.
+ *
+ * @param[in] ring The ring being read from.
+ *
+ * @designer
+ * @author
+ */
+void ring_disarm(PacketRing *ring)
+{
+	uint64_t wake;
+
+	if(!ring->armed)
+		return;
+
+	ring->armed = false;
+	if(__atomic_exchange_n(&ring->waiting, 0, __ATOMIC_SEQ_CST) == 0)
+	{
+		if(read(ring->event_fd, &wake, sizeof(wake)) == -1)
+			perror("ring_disarm: read");
+	}
+}
+
+/**
+ * Sleeps until the writer commits a packet or ring_kick is called. The caller checks the
+ * ring again afterwards, as it may wake without a packet.
+ *
+ * @param[in] ring The ring being read from.
+ *
+ * @designer
+ * @author
+ */
+void ring_wait(PacketRing *ring)
+{
+	uint64_t wake;
+
+	if(!ring_arm(ring))
+		return;
+
+	// Once the reader is armed, the writer clears waiting and writes the eventfd
+	while(read(ring->event_fd, &wake, sizeof(wake)) == -1)
+	{
+		if(errno != EINTR)
+		{
+			perror("ring_wait: read");
+			break;
+		}
+	}
+
+	ring->armed = false;
+	__atomic_store_n(&ring->waiting, 0, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * Wakes the reader if it's sleeping in ring_wait, or makes its next ring_wait return at
+ * once, without a packet. Used to tell the reader to check whether it should stop.
+ *
+ * @param[in] ring The ring being read from.
+ *
+ * @designer
+ * @author
+ */
+void ring_kick(PacketRing *ring)
+{
+	uint64_t wake = 1;
+
+	if(write(ring->event_fd, &wake, sizeof(wake)) == -1)
+		perror("ring_kick: write");
+}
@@ -0,0 +1,52 @@
+/** @ingroup Network */
+/** @{ */
+/**
+ * @file PacketRing.h
+ */
+/** @} */
+#ifndef PACKET_RING_H
+#define PACKET_RING_H
+
+#include <stdint.h>
+
+#define RING_SLOTS	256	/**< Packets each ring holds. Must be a power of two. */
+
+/**
+ * A queue of packets from one thread to one other thread.
+ *
+ * Packets are built and read in place in the ring's slots, so passing one costs a
+ * copy at most and no system calls. The eventfd is only written when the reader has
+ * said it is about to sleep.
+ *
+ * @struct PacketRing
+ */
+typedef struct
+{
+	unsigned int	head;		/**< The next slot to fill. Only the writer moves it. */
+	unsigned int	tail;		/**< The next slot to read. Only the reader moves it. */
+	int				waiting;	/**< Set by the reader before it sleeps; the writer clears it to wake it. */
+	bool			armed;		/**< Whether the reader has set waiting. Only the reader uses it. */
+	int				event_fd;	/**< Written once to wake a sleeping reader. */
+	uint32_t		slot_size;	/**< The room for a packet in each slot. */
+	uint32_t		types[RING_SLOTS];		/**< The packet type in each slot. */
+	uint64_t		timestamps[RING_SLOTS];	/**< The timestamp of each slot's packet. */
+	unsigned char	*data;		/**< RING_SLOTS slots of slot_size bytes. */
+} PacketRing;
+
+PacketRing *create_ring();
+void destroy_ring(PacketRing *ring);
+
+/* Writer */
+void *ring_reserve(PacketRing *ring);
+unsigned int ring_space(PacketRing *ring);
+void ring_commit(PacketRing *ring, uint32_t type, uint64_t timestamp);
+
+/* Reader */
+void *ring_peek(PacketRing *ring, uint32_t *type, uint64_t *timestamp);
+void ring_release(PacketRing *ring);
+bool ring_arm(PacketRing *ring);
+void ring_disarm(PacketRing *ring);
+void ring_wait(PacketRing *ring);
+void ring_kick(PacketRing *ring);
+
+#endif
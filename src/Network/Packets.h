@@ -60,8 +60,9 @@
 #define P_TAGGING        14
 #define P_MIN_POS        15
 #define P_MIN_POS_ALL    16
+#define P_TAGGING_SEEN   17 /**< A tag with the server time the taggee was seen at (see TAG_SEEN_AT). */
 
-#define NUM_PACKETS  16
+#define NUM_PACKETS  17
 
 #define ABHISHEK 		0
 #define AMAN     		1
@@ -151,6 +152,7 @@ typedef uint32_t character_t;
 typedef uint32_t pos_t;
 typedef uint32_t tile_t;
 typedef float	 vel_t;
+typedef uint16_t seq_t;
 
 // Packet Definitions
 
@@ -212,6 +214,7 @@ typedef struct pkt10{
 	pos_t		yPos;
 	vel_t		xVel;
 	vel_t		yVel;
+	seq_t		seq;		/* the client's last movement step at this position */
 } PKT_POS_UPDATE;
 
 typedef struct pkt11{
@@ -221,6 +224,7 @@ typedef struct pkt11{
 	pos_t		yPos[MAX_PLAYERS];
 	vel_t		xVel[MAX_PLAYERS];
 	vel_t		yVel[MAX_PLAYERS];
+	seq_t		ack[MAX_PLAYERS];	/* the last step of each player the position is from, 0 if none */
 } PKT_ALL_POS_UPDATE;
 
 typedef struct pkt12{
@@ -245,6 +249,7 @@ typedef struct pkt14 {
 typedef struct pkt15 {
 	uint32_t data;
 	uint16_t vel;
+	uint16_t seq;
 } PKT_POS_UPDATE_MIN;
 
 typedef struct pkt16 {
@@ -253,6 +258,13 @@ typedef struct pkt16 {
 	uint32_t xPos[11];
 	uint32_t yPos[11];
 	uint16_t vel[32];
+	uint16_t ack[32];
 } PKT_ALL_POS_UPDATE_MIN;
 
+typedef struct pkt17 {
+	playerNo_t	tagger_id; /* the person who tagged */
+	playerNo_t  taggee_id; /* the person who got tagged */
+	uint64_t	seen_at;   /* the server timestamp of the taggee's position on the tagger's screen */
+} PKT_TAGGING_SEEN;
+
 #endif
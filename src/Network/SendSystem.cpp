@@ -12,13 +12,43 @@
 #include "Packets.h"
 #include "GameplayCommunication.h"
 #include "NetworkRouter.h"	
-#include "PipeUtils.h"
 #include "SendSystem.h"
+#include "../Gameplay/prediction.h"
+#include "SnapshotBuffer.h"
+#include "../view.h"
 
 extern int network_ready;
+extern uint32_t packet_sizes[NUM_PACKETS + 1];
 extern unsigned int player_entity;
+extern EntityHandle player_handle;
 
 teamNo_t player_team = 0;
+
+typedef View<MovementComponent, PositionComponent, PlayerComponent, ControllableComponent> LocalPlayerView; /**< The player this client controls. */
+
+/**
+ * Gets a zeroed slot in the ring to the network router to build a packet in. The packet
+ * is sent once it's committed with ring_commit.
+ *
+ * @param[in] ring The ring from the gameplay thread to the network router thread.
+ * @param[in] type The type of packet to build.
+ *
+ * @return The slot, or NULL if the ring is full and the packet has to be dropped.
+ */
+static void *reserve_packet(PacketRing *ring, uint32_t type)
+{
+	void *slot = ring_reserve(ring);
+
+	if(!slot)
+	{
+		fprintf(stderr, "reserve_packet: Ring to the network router is full, dropping packet type %u\n", type);
+		return NULL;
+	}
+
+	memset(slot, 0, packet_sizes[type - 1]);
+	return slot;
+}
+
 /**
  * Checks the world for data and sends out data updates to be passed to the server. Currently sends out\
  * only a position update.
@@ -27,51 +57,67 @@ teamNo_t player_team = 0;
  *					- Ability to specify which update will be sent
  *					
  * @param[in, out]  world  	game world, searched for updates
- * @param[in]		fd 		write file descriptor to the gameplay thread > network router thread
+ * @param[in]		ring 	ring from the gameplay thread to the network router thread
  *
  * @return  void
  *
  * @designer    Ramzi Chennafi
  * @author      Ramzi Chennafi
  */
-void send_location(World *world, int fd) 
+void send_location(World *world, PacketRing *ring) 
 { 
-	PKT_POS_UPDATE * pkt4 = (PKT_POS_UPDATE*)malloc(sizeof(PKT_POS_UPDATE));
-    for (int i = 0; i < MAX_ENTITIES; i++)
+	PKT_POS_UPDATE * pkt4 = (PKT_POS_UPDATE*)reserve_packet(ring, P_POSUPDATE);
+	LocalPlayerView local(world);
+
+	if(!pkt4)
+		return;
+    for (unsigned int n = 0; n < local.size(); n++)
 	{
-		if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_MOVEMENT | COMPONENT_POSITION | COMPONENT_PLAYER | COMPONENT_CONTROLLABLE))
-		{
-			pkt4->xPos = world->position[i].x;
-			pkt4->yPos = world->position[i].y;
-			pkt4->xVel = world->movement[i].movX;
-			pkt4->yVel = world->movement[i].movY;
-			pkt4->floor = world->position[i].level;
-			pkt4->player_number = world->player[i].playerNo;
-		}
+		unsigned int i = local[n];
+		pkt4->xPos = local.get<PositionComponent>(i).x;
+		pkt4->yPos = local.get<PositionComponent>(i).y;
+		pkt4->xVel = local.get<MovementComponent>(i).movX;
+		pkt4->yVel = local.get<MovementComponent>(i).movY;
+		pkt4->floor = local.get<PositionComponent>(i).level;
+		pkt4->player_number = local.get<PlayerComponent>(i).playerNo;
+		pkt4->seq = prediction_sequence();
 	}
-	write_packet(fd, P_POSUPDATE, pkt4);
-    free(pkt4);
+	ring_commit(ring, P_POSUPDATE, 0);
 }
 
 /**
  * Sends a tag packet when the client tags another player.
  *
+ * With TAG_SEEN_AT on, the packet is a P_TAGGING_SEEN carrying the server time of where
+ * the taggee was drawn, so the server can check the tag against its own history at that
+ * moment instead of against where the taggee is now. Otherwise it's a plain P_TAGGING.
+ *
  * @param[in] world  A pointer to the world struct.
- * @param[in] fd     The write end of a pipe to the network router.
+ * @param[in] ring   The ring to the network router.
  * @param[in] taggee The player that the client tagged.
  *
  * @designer Ramzi Chennafi
  * @author   Ramzi Chennafi
  */
-void send_tag(World * world, int fd, unsigned int taggee)
+void send_tag(World * world, PacketRing *ring, unsigned int taggee)
 {
-	PKT_TAGGING * pkt = (PKT_TAGGING*) malloc(sizeof(PKT_TAGGING));
+#if TAG_SEEN_AT
+	PKT_TAGGING_SEEN * pkt = (PKT_TAGGING_SEEN*)reserve_packet(ring, P_TAGGING_SEEN);
+#else
+	PKT_TAGGING * pkt = (PKT_TAGGING*)reserve_packet(ring, P_TAGGING);
+#endif
+
+	if(!pkt)
+		return;
 
 	pkt->tagger_id = world->player[player_entity].playerNo;
 	pkt->taggee_id = taggee;
-
-	write_packet(fd, P_TAGGING, pkt);
-    free(pkt);
+#if TAG_SEEN_AT
+	pkt->seen_at   = shown_snapshot_stamp(taggee);
+	ring_commit(ring, P_TAGGING_SEEN, 0);
+#else
+	ring_commit(ring, P_TAGGING, 0);
+#endif
 }
 /**
  * Checks the world for data and sends out data updates to be passed to the server. Currently sends out\
@@ -83,28 +129,30 @@ void send_tag(World * world, int fd, unsigned int taggee)
  q
  *					
  * @param[in, out]  world  	game world, searched for updates
- * @param[in]		fd 		write file descriptor to the gameplay thread > network router thread
+ * @param[in]		ring 	ring from the gameplay thread to the network router thread
  *
  * @return  void
  *
  * @designer    Ramzi Chennafi
  * @author      Ramzi Chennafi
  */
-void send_intialization(World *world, int fd, char * username)
+void send_intialization(World *world, PacketRing *ring, char * username)
 {
-	PKT_PLAYER_NAME * pkt1 = (PKT_PLAYER_NAME *)malloc(sizeof(PKT_PLAYER_NAME));
-	for (int j = 0; j < MAX_ENTITIES; j++) {
-		if (IN_THIS_COMPONENT(world->mask[j], COMPONENT_PLAYER | COMPONENT_CONTROLLABLE))
-		{
-			player_entity = j;
-			memcpy(pkt1->client_player_name, username, MAX_NAME);
-			memcpy(world->player[j].name, username, MAX_NAME);
-			pkt1->selectedCharacter = world->player[j].character;
-			break;
-		}
+	PKT_PLAYER_NAME * pkt1 = (PKT_PLAYER_NAME *)reserve_packet(ring, P_NAME);
+	View<PlayerComponent, ControllableComponent> controllable(world);
+
+	if(!pkt1)
+		return;
+	for (unsigned int n = 0; n < controllable.size(); n++) {
+		unsigned int j = controllable[n];
+		player_entity = j;
+		player_handle = entity_handle(world, j);
+		memcpy(pkt1->client_player_name, username, MAX_NAME);
+		memcpy(controllable.get<PlayerComponent>(j).name, username, MAX_NAME);
+		pkt1->selectedCharacter = controllable.get<PlayerComponent>(j).character;
+		break;
 	}	
-	write_packet(fd, P_NAME, pkt1);
-	free(pkt1);
+	ring_commit(ring, P_NAME, 0);
 }
 /**
  * Checks the world for data and sends out data updates to be passed to the server. Currently sends out\
@@ -114,16 +162,19 @@ void send_intialization(World *world, int fd, char * username)
  *					- Ability to specify which update will be sent
  *					
  * @param[in, out]  world  	game world, searched for updates
- * @param[in]		fd 		write file descriptor to the gameplay thread > network router thread
+ * @param[in]		ring 	ring from the gameplay thread to the network router thread
  *
  * @return  void
  *
  * @designer    Ramzi Chennafi
  * @author      Ramzi Chennafi
  */
-void move_request(World * world, int fd, floorNo_t floor, pos_t xpos, pos_t ypos)
+void move_request(World * world, PacketRing *ring, floorNo_t floor, pos_t xpos, pos_t ypos)
 {
-	PKT_FLOOR_MOVE_REQUEST * pkt = (PKT_FLOOR_MOVE_REQUEST*)malloc(sizeof(PKT_FLOOR_MOVE_REQUEST));
+	PKT_FLOOR_MOVE_REQUEST * pkt = (PKT_FLOOR_MOVE_REQUEST*)reserve_packet(ring, P_FLOOR_MOVE_REQ);
+
+	if(!pkt)
+		return;
 
 	pkt->player_number = world->player[player_entity].playerNo;
 	pkt->current_floor = world->position[player_entity].level;
@@ -131,14 +182,13 @@ void move_request(World * world, int fd, floorNo_t floor, pos_t xpos, pos_t ypos
 	pkt->desired_xPos = xpos;
 	pkt->desired_yPos = ypos;
 
-	write_packet(fd, P_FLOOR_MOVE_REQ, pkt);
-	free(pkt);
+	ring_commit(ring, P_FLOOR_MOVE_REQ, 0);
 }
 /**
  * Sends an update out specifying the users chosen team and if they're ready for the game to start.
  *			
  * @param[in, out]  world  	game world, searched for updates
- * @param[in]		fd 		write file descriptor to the gameplay thread > network router thread
+ * @param[in]		ring 	ring from the gameplay thread to the network router thread
  * @param[in] 		team    team chosen 
  * @param[in]		ready_status 	PLAYER_STATE_READY or PLAYER_STATE_WAITING, specifed if the player is
  *								is ready to play or has moved to the lobby. PLAYER_STATE_WAITING considered
@@ -149,11 +199,14 @@ void move_request(World * world, int fd, floorNo_t floor, pos_t xpos, pos_t ypos
  * @designer    Ramzi Chennafi
  * @author      Ramzi Chennafi
  */
-void send_status(World * world, int fd, teamNo_t team, int ready_status)
+void send_status(World * world, PacketRing *ring, teamNo_t team, int ready_status)
 {
 	if(player_team != team)
 	{
-		PKT_READY_STATUS * pkt = (PKT_READY_STATUS*)malloc(sizeof(PKT_READY_STATUS));
+		PKT_READY_STATUS * pkt = (PKT_READY_STATUS*)reserve_packet(ring, P_READY_STAT);
+
+		if(!pkt)
+			return;
 
 		pkt->player_number = world->player[player_entity].playerNo;
 		pkt->ready_status = ready_status;
@@ -162,8 +215,7 @@ void send_status(World * world, int fd, teamNo_t team, int ready_status)
 		player_team = team;
 
 		//printf("Changed to team %d\n", team);
-		write_packet(fd, P_READY_STAT, pkt);
-		free(pkt);
+		ring_commit(ring, P_READY_STAT, 0);
 	}
 }
 /**
@@ -174,72 +226,75 @@ void send_status(World * world, int fd, teamNo_t team, int ready_status)
  * @designer Ramzi Chennafi
  * @author   Ramzi Chennafi
  */
-void send_chat(World * world, int fd, char * str)
+void send_chat(World * world, PacketRing *ring, char * str)
 {
 	if(str == NULL)
 		return;
 
-	PKT_SND_CHAT * pkt = (PKT_SND_CHAT*) calloc(1, sizeof(PKT_SND_CHAT));
+	PKT_SND_CHAT * pkt = (PKT_SND_CHAT*)reserve_packet(ring, P_CHAT);
+	LocalPlayerView local(world);
 
-	for (int i = 0; i < MAX_ENTITIES; i++)
+	if(!pkt)
+		return;
+
+	for (unsigned int n = 0; n < local.size(); n++)
 	{
-		if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_MOVEMENT | COMPONENT_POSITION | COMPONENT_PLAYER | COMPONENT_CONTROLLABLE))
-		{
-			pkt->sendingPlayer_number = world->player[i].playerNo;
-			memcpy(pkt->message, str, MAX_MESSAGE);
-			break;
-		}
+		pkt->sendingPlayer_number = local.get<PlayerComponent>(local[n]).playerNo;
+		memcpy(pkt->message, str, MAX_MESSAGE);
+		break;
 	}
 
-	write_packet(fd, P_CHAT, pkt);
-	free(pkt);
+	ring_commit(ring, P_CHAT, 0);
 }
 
 /**
  * Sends an objective packet with the status of tagged objectives..
  *
  * @param[in, out]  world  	game world, searched for updates
- * @param[in]		fd 		write file descriptor to the gameplay thread > network router thread
+ * @param[in]		ring 	ring from the gameplay thread to the network router thread
  *
  * @designer Ramzi Chennafi
  * @author   Ramzi Chennafi
  */
-void send_objectives(World * world, int fd)
+void send_objectives(World * world, PacketRing *ring)
 {
-	PKT_OBJECTIVE_STATUS * obj_status = (PKT_OBJECTIVE_STATUS*) calloc(1, sizeof(PKT_OBJECTIVE_STATUS));
+	PKT_OBJECTIVE_STATUS * obj_status = (PKT_OBJECTIVE_STATUS*)reserve_packet(ring, P_OBJSTATUS);
 	unsigned int obj_idx = (world->position[player_entity].level - 1) * OBJECTIVES_PER_FLOOR; // find the offset into the objectives array
+	View<ObjectiveComponent> objectives(world);
+
+	if(!obj_status)
+		return;
 
-	for(int i = 0; i < MAX_ENTITIES; i++)
+	for (unsigned int n = 0; n < objectives.size(); n++)
 	{
-		if(IN_THIS_COMPONENT(world->mask[i], COMPONENT_OBJECTIVE))
-		{
-			obj_status->objectives_captured[world->objective[i].objectiveID + obj_idx] = world->objective[i].status;
-		}
+		ObjectiveComponent &objective = objectives.get<ObjectiveComponent>(objectives[n]);
+		obj_status->objectives_captured[objective.objectiveID + obj_idx] = objective.status;
 	}
 
-	write_packet(fd, P_OBJSTATUS, obj_status);
-	free(obj_status);
+	ring_commit(ring, P_OBJSTATUS, 0);
 }
 /**
  * Sends a special tile packet containing the most recently placed special tile.
  *
  * @param[in, out]  world  	game world, searched for updates
  * @param[in]		entity	entity of the special tile
- * @param[in]		fd 		write file descriptor to the gameplay thread > network router thread
+ * @param[in]		ring 	ring from the gameplay thread to the network router thread
  *
  * @designer Ramzi Chennafi
  * @author   Ramzi Chennafi
  */
-void send_tiles(World * world, unsigned int entity, int fd)
+void send_tiles(World * world, unsigned int entity, PacketRing *ring)
 {
-	PKT_SPECIAL_TILE * p_tile = (PKT_SPECIAL_TILE*) calloc(1, sizeof(PKT_SPECIAL_TILE));
-	
+	PKT_SPECIAL_TILE * p_tile = (PKT_SPECIAL_TILE*)reserve_packet(ring, P_SPECIAL_TILE);
+
+	if(!p_tile)
+		return;
+
 	p_tile->playerNo = world->player[player_entity].playerNo;
 	p_tile->floor = world->position[entity].level;
 	p_tile->xPos = world->position[entity].x;
 	p_tile->yPos = world->position[entity].y;
 	p_tile->tile = world->tile[entity].type;
 
-	write_packet(fd, P_SPECIAL_TILE, p_tile);
-	free(p_tile);
+	ring_commit(ring, P_SPECIAL_TILE, 0);
 }
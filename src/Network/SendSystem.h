@@ -2,19 +2,22 @@
 #define SEND_SYS_H
 
 #include "Packets.h"
+#include "PacketRing.h"
 #include "../components.h"
 #include "../systems.h"
 #include "../world.h"
 #include "time.h"
 #include <signal.h>
 
-void send_location(World *world, int fd);
-void send_intialization(World *world, int fd, char * username);
-void move_request(World * world, int fd, floorNo_t floor, pos_t xpos, pos_t ypos);
-void send_status(World * world, int fd, teamNo_t team, int ready_status);
-void send_tag(World * world, int fd, unsigned int tagger);
-void send_chat(World * world, int fd, char * str);
-void send_objectives(World * world, int fd);
-void send_tiles(World * world, unsigned int entity, int fd);
+#define TAG_SEEN_AT		0 /**< 1 = send tags as P_TAGGING_SEEN with the time the taggee was seen at, 0 = send P_TAGGING (for servers that don't know P_TAGGING_SEEN) */
+
+void send_location(World *world, PacketRing *ring);
+void send_intialization(World *world, PacketRing *ring, char * username);
+void move_request(World * world, PacketRing *ring, floorNo_t floor, pos_t xpos, pos_t ypos);
+void send_status(World * world, PacketRing *ring, teamNo_t team, int ready_status);
+void send_tag(World * world, PacketRing *ring, unsigned int tagger);
+void send_chat(World * world, PacketRing *ring, char * str);
+void send_objectives(World * world, PacketRing *ring);
+void send_tiles(World * world, unsigned int entity, PacketRing *ring);
 
 #endif
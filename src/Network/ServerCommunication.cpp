@@ -4,7 +4,6 @@
 /**
  * This file contains all methods responsible for communication with the server.
  *
- * @todo Get rid of magic numbers in grab_send_packet
  * @todo Make writing to cnt_errno thread safe
  * @todo Write to network router requesting that keep alive be sent
  * 
@@ -16,7 +15,6 @@
 #include "ServerCommunication.h"
 #include "GameplayCommunication.h"
 #include "NetworkRouter.h"
-#include "PipeUtils.h"
 #include "packet_min_utils.h"
 #include "ServerCommunication.h"
  
@@ -29,13 +27,13 @@ extern int send_failure_fd;
 /**
  * Monitors sockets to receive data from the server.
  *
- * Upon receiving data, the thread writes to the pipe connected to the network
+ * Upon receiving data, the thread writes to the ring read by the network
  * router thread. The thread will return in case of any error condition (wrapper functions
  * are responsible for minor error handling; if the thread returns, network should stop
  * running altogether).
  *
  * @param[in] ndata Pointer to a NETWORK_DATA struct containing socket descriptors and
- *                  the pipe end to the Network Router thread.
+ *                  the ring to the Network Router thread.
  *
  * @return NULL upon termination.
  *
@@ -50,22 +48,20 @@ extern int send_failure_fd;
  	int 				numready;
  	SDLNet_SocketSet 	set = make_socket_set(2, recv_data->tcp_sock, recv_data->udp_sock);
 	int 				res = 0;
-    uint32_t            type;
     recv_cleanup_args   *clean_args;
+    TcpStream           tcp_in;
 
     if(!set)
     {
-        uint32_t err = NUM_PACKETS + 1;
-        write_pipe(recv_data->write_pipe, &err, sizeof(err));
+        write_recv_error(recv_data->ring);
  		return NULL;
     }
 
  	clean_args = (recv_cleanup_args *)malloc(sizeof(recv_cleanup_args));
     if(!clean_args)
     {
-        uint32_t err = NUM_PACKETS + 1;
         set_error(ERR_NO_MEM);
-        write_pipe(recv_data->write_pipe, &err, sizeof(err));
+        write_recv_error(recv_data->ring);
         free_sockset(set, recv_data->tcp_sock, recv_data->udp_sock);
  		return NULL;
     }
@@ -74,12 +70,13 @@ extern int send_failure_fd;
     clean_args->udp_sock = recv_data->udp_sock;
     pthread_cleanup_push(&recv_thread_clean, clean_args);
 
+    stream_reset(&tcp_in);
+
  	while(1)
  	{
  		if((numready = check_sockets(set)) == -1) // write error message to router
         {
-            uint32_t err = NUM_PACKETS + 1;
-            write_pipe(recv_data->write_pipe, &err, sizeof(err));
+            write_recv_error(recv_data->ring);
      	    break;
         }
 
@@ -90,24 +87,45 @@ extern int send_failure_fd;
 
 			if(SDLNet_SocketReady(recv_data->tcp_sock))
 			{
-				if((res = handle_tcp_in(recv_data->write_pipe, recv_data->tcp_sock)) == -1)
+				if((res = handle_tcp_in(recv_data->ring, &tcp_in, recv_data->tcp_sock)) == -1)
                     break;
             }
 
     		if(SDLNet_SocketReady(recv_data->udp_sock))
     		{
-				if((res = handle_udp_in(recv_data->write_pipe, recv_data->udp_sock)) == -1)
+				if((res = handle_udp_in(recv_data->ring, recv_data->pool, recv_data->udp_sock)) == -1)
                     break;
             }
             pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &oldstate);
     	}
  	}
-    uint32_t err = NUM_PACKETS + 1;
-    write_pipe(recv_data->write_pipe, &err, sizeof(err));
+    write_recv_error(recv_data->ring);
     pthread_cleanup_pop(1); // Calls the cleanup handler
     return NULL;
 }
 
+/**
+ * Tells the network router that the receive thread has stopped.
+ *
+ * Writes a packet of type NUM_PACKETS + 1, which the router takes to mean the
+ * network should shut down.
+ *
+ * @param[in] router_ring The ring to the network router thread.
+ *
+ * @designer Shane Spoor
+ * @author   Shane Spoor
+ */
+void write_recv_error(PacketRing *router_ring)
+{
+    if(ring_reserve(router_ring) == NULL)
+    {
+        fprintf(stderr, "write_recv_error: Ring to router is full\n");
+        return;
+    }
+
+    ring_commit(router_ring, NUM_PACKETS + 1, 0);
+}
+
 /**
  * Cleans up the receive thread.
  *
@@ -133,12 +151,15 @@ void recv_thread_clean(void *cleanup_args)
 /**
  * Handles the receipt of TCP data.
  *
- * Receives the TCP packet, if any, and writes it to the network router. Keep alive packets are
- * ignored. On error, it writes an error message (preceded by an packet type indicating an error)
- * and returns -1.
+ * Receives whatever TCP data is waiting with one receive, and writes every whole packet in it
+ * to the network router. The rest of a packet that has only partly arrived stays in @a stream
+ * until the next call. Keep alive packets are ignored. If the router's ring stays full for
+ * TCP_RING_WAIT milliseconds, the router has stopped reading and the packets can't be passed on,
+ * so that's an error too. On error, it returns -1 and the receive thread tells the router.
  *
- * @param[in] router_pipe_fd Descriptor for the write end of the pipe to the network router thread.
- * @param[in] tcp_sock       The TCP socket from which to receive data.
+ * @param[in]      router_ring The ring to the network router thread.
+ * @param[in, out] stream      The TCP data received but not yet passed on.
+ * @param[in]      tcp_sock    The TCP socket from which to receive data.
  *
  * @return 0 on success, or -1 if an error occurred. 
  *
@@ -146,34 +167,67 @@ void recv_thread_clean(void *cleanup_args)
  * @author   Shane Spoor
  *
  */
-int handle_tcp_in(int router_pipe_fd, TCPsocket tcp_sock)
+int handle_tcp_in(PacketRing *router_ring, TcpStream *stream, TCPsocket tcp_sock)
 {
     void *game_packet;
+    unsigned char *space;
+    unsigned int room;
     uint32_t packet_type;
-    uint64_t timestamp;
-    
-    if((game_packet = recv_tcp_packet(tcp_sock, &packet_type, &timestamp)) == NULL)
-        return -1; // If it's a keep alive, ignore and return 0. 
+    int numread;
+    int waited;
+    struct timespec pause = {0, 1000000}; // 1 ms
 
-    if(write_packet(router_pipe_fd, packet_type, game_packet) == -1 ||
-        write_pipe(router_pipe_fd, &timestamp, sizeof(timestamp)) == -1)
+    space = stream_space(stream, &room);
+    if((numread = SDLNet_TCP_Recv(tcp_sock, space, room)) == -1)
     {
-        fprintf(stderr, "handle_tcp_in: Error in write packet\n");
-        set_error(ERR_IPC_FAIL);
-        free(game_packet);
+        fprintf(stderr, "SDLNet_TCP_Recv: %s\n", SDLNet_GetError());
+        set_error(ERR_TCP_RECV_FAIL);
         return -1;
-	}
-    free(game_packet);
+    }
+    else if(numread == 0)
+    {
+        fprintf(stderr, "handle_tcp_in: Connection closed or reset.\n");
+        set_error(ERR_CONN_CLOSED);
+        return -1;
+    }
+    stream_fill(stream, numread);
+
+    while((game_packet = stream_next(stream, &packet_type)) != NULL)
+    {
+        // Unlike UDP, TCP packets mustn't be lost, so wait (a while) for the router to make room
+        for(waited = 0; ring_space(router_ring) == 0; waited++)
+        {
+            if(waited == TCP_RING_WAIT)
+            {
+                fprintf(stderr, "handle_tcp_in: Ring to router has been full for %d ms\n", TCP_RING_WAIT);
+                set_error(ERR_IPC_FAIL);
+                return -1;
+            }
+            nanosleep(&pause, NULL);
+        }
+
+        write_packet(router_ring, packet_type, game_packet, tcp_seq_num++);
+    }
+
+    if(packet_type == INVALID_PACKET_TYPE)
+    {
+        fprintf(stderr, "handle_tcp_in: Received Invalid Packet Type!\n");
+        set_error(ERR_CORRUPTED);
+        return -1;
+    }
+
     return 0;
 }
 
 /**
  * Handles the receipt of UDP packets.
  *
- * Receives the UDP packet and writes it to the network router. On error, it writes an error message 
+ * Receives the UDP packet and writes it to the network router. Minimised position updates are
+ * expanded straight into the router ring's slot. On error, it writes an error message 
  * (preceded by an packet type indicating an error) and returns -1.
  *
- * @param[in] router_pipe_fd Descriptor for the write end of the pipe to the network router thread.
+ * @param[in] router_ring    The ring to the network router thread.
+ * @param[in] pool           The receive thread's packet buffers.
  * @param[in] udp_sock       The UDP socket from which to receive data.
  * 
  * @return 0 on success, or -1 if an error occurred. 
@@ -183,92 +237,41 @@ int handle_tcp_in(int router_pipe_fd, TCPsocket tcp_sock)
  *
  * @date March 12, 2014
  */
-int handle_udp_in(int router_pipe_fd, UDPsocket udp_sock)
+int handle_udp_in(PacketRing *router_ring, PacketPool *pool, UDPsocket udp_sock)
 {
     void *game_packet;
+    void *slot;
     uint32_t packet_type;
     uint64_t timestamp;
 
-    if((game_packet = recv_udp_packet(udp_sock, &packet_type, &timestamp)) == NULL)
+    if((game_packet = recv_udp_packet(udp_sock, pool, &packet_type, &timestamp)) == NULL)
         return (packet_type == INVALID_PACKET_TYPE) - 1; // If it's a corrupted packet, that's fine; return 0
 
-	// if it's a min pos update, decapsulate it first
-	if(packet_type == P_MIN_POS)
-	{
-		packet_type = P_POSUPDATE;
-		game_packet = (void *)decapsulate_pos_update((PKT_POS_UPDATE_MIN *)game_packet);
-	}
-
-	else if (packet_type == P_MIN_POS_ALL)
+	// if it's a min pos update, decapsulate it into the ring; a full ring drops it like any datagram
+	if(packet_type == P_MIN_POS || packet_type == P_MIN_POS_ALL)
 	{
-		packet_type = G_ALLPOSUPDATE;
-		game_packet = decapsulate_all_pos_update((PKT_ALL_POS_UPDATE_MIN *)game_packet);
+		if((slot = ring_reserve(router_ring)) != NULL)
+		{
+			if(packet_type == P_MIN_POS)
+			{
+				packet_type = P_POSUPDATE;
+				decapsulate_pos_update((PKT_POS_UPDATE_MIN *)game_packet, (PKT_POS_UPDATE *)slot);
+			}
+			else
+			{
+				packet_type = G_ALLPOSUPDATE;
+				decapsulate_all_pos_update((PKT_ALL_POS_UPDATE_MIN *)game_packet, (PKT_ALL_POS_UPDATE *)slot);
+			}
+			ring_commit(router_ring, packet_type, timestamp);
+		}
 	}
-	
-    if(write_packet(router_pipe_fd, packet_type, game_packet) == -1 ||
-        write_pipe(router_pipe_fd, &timestamp, sizeof(timestamp)) == -1)
-    {
-        fprintf(stderr, "handle_udp_in: Error in write packet\n");
-        set_error(ERR_IPC_FAIL);
-        free(game_packet);
-        return -1;
-    }
+	else
+		write_packet(router_ring, packet_type, game_packet, timestamp);
 
-    free(game_packet);
+    pool_put(pool, game_packet);
     return 0;
 }
 
-/**
- * Reads a packet from the specified TCP socket.
- *
- * The function stores the packet in an allocated buffer if it's read successfully
- * and stores the packet type and timestamp in the variables passed by the caller.
- *
- * @param[in]  sock        The TCP socket from which to read.
- * @param[out] packet_type Holds the packet type on successful return. It may hold an invalid
- *                         packet type on failure.
- * @param[out] timestamp   Holds the timestamp on successful return.
- *
- * @return  A data buffer containing the packet on success and NULL on failure.
- *
- * @designer Shane Spoor
- * @author   Shane Spoor
- *
- * @date February 18th, 2014
- */
-void *recv_tcp_packet(TCPsocket sock, uint32_t *packet_type, uint64_t *timestamp)
-{
-	void     *packet;
-    uint32_t packet_size;
-
-	if(recv_tcp(sock, packet_type, sizeof(uint32_t)) == -1)
-        return NULL;
-	
-    if(*packet_type == P_KEEPALIVE)
-        return NULL;
-
-	if(*packet_type <= 1 || *packet_type > NUM_PACKETS)
-	{
-		fprintf(stderr, "recv_tcp_packet: Received Invalid Packet Type!\n");
-		set_error(ERR_CORRUPTED);
-        *packet_type = INVALID_PACKET_TYPE; // set this to a known invalid value
-		return NULL; 
-	}
-
-	packet_size = packet_sizes[(*packet_type) - 1];
-	if((packet = malloc(packet_size)) == NULL)
-	{
-		perror("recv_ tcp_packet: malloc");
-		set_error(ERR_NO_MEM);
-		return NULL;
-	}
-
-	recv_tcp(sock, packet, packet_size);
-	*timestamp = tcp_seq_num++;
-    //printf("Type: %d\n", *packet_type);
-	return packet;
-}
-
 /**
  * Receives and processes a UDP packet containing a packet type, game data,
  * and a timestamp.
@@ -279,7 +282,11 @@ void *recv_tcp_packet(TCPsocket sock, uint32_t *packet_type, uint64_t *timestamp
  * if the function receives an invalid timestamp. Note that the timestamp is not checked
  * for validity.
  *
+ * The datagram is received into a buffer from @a pool, and the packet is moved to the
+ * start of it. The caller gives the buffer back with pool_put.
+ *
  * @param[in]  sock        The UDP socket to receive data from.
+ * @param[in]  pool        The calling thread's packet buffers.
  * @param[out] packet_type Receives the packet type.
  * @param[out] timestamp   Receives the timestamp.
  *
@@ -294,81 +301,42 @@ void *recv_tcp_packet(TCPsocket sock, uint32_t *packet_type, uint64_t *timestamp
  *
  * @date Febuary 15, 2014
  */
-void *recv_udp_packet(UDPsocket sock, uint32_t *packet_type, uint64_t *timestamp)
+void *recv_udp_packet(UDPsocket sock, PacketPool *pool, uint32_t *packet_type, uint64_t *timestamp)
 {
-	void      *packet;
 	uint32_t  packet_size;
-    UDPpacket *pktdata = SDLNet_AllocPacket(MAX_UDP_RECV + sizeof(*packet_type) + sizeof(*timestamp));
-
-	if(recv_udp(sock, pktdata) == -1)
-		return NULL;
+    UDPpacket pktdata;
 
-	*packet_type 	= *((uint32_t *)pktdata->data);
-    if(*packet_type < 1 || *packet_type > NUM_PACKETS) // Impossible packet type; packet is corrupted
+    *packet_type = 0;
+    memset(&pktdata, 0, sizeof(pktdata));
+    if((pktdata.data = (Uint8 *)pool_get(pool)) == NULL)
     {
-		fprintf(stderr, "recv_udp_packet: Received Invalid Packet Type!\n");
-        set_error(ERR_CORRUPTED);
-        *packet_type = INVALID_PACKET_TYPE; // set this to a known invalid value
-        return NULL;
+		set_error(ERR_NO_MEM);
+		return NULL;
     }
+    pktdata.maxlen = pool->buffer_size;
 
-	packet_size 	= packet_sizes[(*packet_type) - 1];
-	packet			= malloc(packet_size);
-
-	if(!packet)
+	if(recv_udp(sock, &pktdata) == -1)
 	{
-        perror("recv_udp_packet: malloc");
-		set_error(ERR_NO_MEM); 
+		pool_put(pool, pktdata.data);
 		return NULL;
 	}
-	
-	memcpy(packet, pktdata->data + sizeof(uint32_t), packet_size);
-    memcpy(timestamp, pktdata->data + packet_size + sizeof(uint32_t), sizeof(*timestamp));
-	*timestamp = *((uint64_t *)(pktdata->data + packet_size + sizeof(uint32_t)));
-
-	SDLNet_FreePacket(pktdata);    
-	return packet;
-}
 
-/**
- * Reads the specified amount of data from a TCP socket.
- *
- * @param[in]  tcp_socket The TCP socket from which to receive data.
- * @param[out] buf        The buffer into which the data will be read.
- * @param[in]  bufsize    The size (in bytes) of buf.cd
- *
- * @return ERR_RECV_FAILED if SDLNet_TCP_Recv returns an error, and ERR_CONN_CLOSED if no
- *         data was read (i.e., received a RST or a FIN). Returns 0 on success.
- *
- * @designer Shane Spoor
- * @author   Shane Spoor
- *
- * @date Febuary 21, 2014
- */
-int recv_tcp(TCPsocket sock, void *buf, size_t bufsize)
-{
-    int numread = 0;
-    int lastread = 0;
-    while((unsigned int)numread < bufsize)
+	memcpy(packet_type, pktdata.data, sizeof(*packet_type));
+    if(*packet_type < 1 || *packet_type > NUM_PACKETS || // Impossible packet type; packet is corrupted
+       (packet_size = datagram_packet_size(*packet_type, pktdata.len)) == 0)
     {
-	    lastread = SDLNet_TCP_Recv(sock, buf, bufsize);
+		fprintf(stderr, "recv_udp_packet: Received Invalid Packet Type!\n");
+        set_error(ERR_CORRUPTED);
+        *packet_type = INVALID_PACKET_TYPE; // set this to a known invalid value
+		pool_put(pool, pktdata.data);
+        return NULL;
+    }
 
-        if(lastread == -1)
-        {
-            fprintf(stderr, "SDLNet_TCP_Recv: %s\n", SDLNet_GetError());
-            set_error(ERR_TCP_RECV_FAIL);
-            return -1;
-        }
-        else if(lastread == 0){
-            fprintf(stderr, "recv_tcp: Connection closed or reset.\n");
-            set_error(ERR_CONN_CLOSED);
-            return -1;
-        }
+    memcpy(timestamp, pktdata.data + packet_size + sizeof(uint32_t), sizeof(*timestamp));
+	memmove(pktdata.data, pktdata.data + sizeof(uint32_t), packet_size);
+	memset(pktdata.data + packet_size, 0, packet_sizes[*packet_type - 1] - packet_size); // fields an older server leaves off
 
-        numread += lastread;
-    }
-	
-	return 0;
+	return pktdata.data;
 }
 
 /**
@@ -398,15 +366,15 @@ int recv_udp (UDPsocket sock, UDPpacket *udp_packet)
 
 
 /**
- * Frees the socket set upon cancellation of the receive thread.
- *
- * Sends data received from the network router pipe to the server.
+ * Sends data received from the network router ring to the server.
  * 
- * The thread gets the data from the pipe and determines the protocol (UDP or TCP)
- * to use, then sends the packet on corresponding socket.
+ * The thread gets the data from the ring and determines the protocol (UDP or TCP)
+ * to use. UDP packets are sent straight from the ring's slot. Once it wakes, the thread
+ * takes every packet that's waiting, and the TCP ones are collected and sent together
+ * with one send, so a burst of chat or status packets costs one system call.
  *
- * @param[in] ndata NETWORK_DATA containing a tcp socket, udp socket and a file
- *                  descriptor to the network router send pipe.
+ * @param[in] ndata NETWORK_DATA containing a tcp socket, udp socket and the ring
+ *                  from the network router.
  *
  * @return  NULL upon termination
  *
@@ -419,46 +387,50 @@ void* send_thread_func(void* ndata){
 
 	NDATA snd_data = (NDATA) ndata;
 
-	int protocol = 0;
+	TcpStream tcp_out;
 	uint32_t type = 0;
 	void * data;
+	unsigned char * pending;
+	unsigned int count;
 	uint64_t error = 1;
+	bool failed = false;
 
-	while(1){	
-    	data = grab_send_packet(&type, snd_data->read_pipe);
-    	if(data == NULL){
-            write(send_failure_fd, &error, sizeof(uint64_t));
-            break;
-		}
-		
-		protocol = get_protocol(type);
-		if(protocol == TCP)
+	stream_reset(&tcp_out);
+
+	while(!failed){	
+    	if((data = grab_send_packet(&type, snd_data)) == NULL)
+			break;
+
+		// A packet of an invalid type ends the batch; grab_send_packet catches it next time round
+		do
 		{
-			if(send_tcp(&type, snd_data->tcp_sock, sizeof(uint32_t)) == -1)
-            {
-                fprintf(stderr, "Failed to send packet type over TCP.\n");
-                write(send_failure_fd, &error, sizeof(uint64_t));
-                break;
-            }
-			if(send_tcp(data, snd_data->tcp_sock, packet_sizes[type - 1]) == -1)
-            {
-                fprintf(stderr, "Failed to send packet over TCP.\n");
-                write(send_failure_fd, &error, sizeof(uint64_t));
-                break;
-            }
-		}
-		else if(protocol == UDP)
+			if(get_protocol(type) == UDP)
+			{
+				if(send_udp(data, &type, snd_data->udp_sock, packet_sizes[type - 1] + sizeof(uint32_t), snd_data->pool) == -1)
+				{
+					fprintf(stderr, "Failed to send packet over UDP.\n");
+					failed = true;
+					break;
+				}
+			}
+			else if(stream_append(&tcp_out, type, data) == -1)
+				break; // no room; it goes in the next batch
+
+			ring_release(snd_data->ring);
+		} while((data = ring_peek(snd_data->ring, &type, NULL)) != NULL && type > 0 && type <= NUM_PACKETS);
+
+		if(!failed && (count = stream_pending(&tcp_out, &pending)) > 0)
 		{
-			if(send_udp(data, &type, snd_data->udp_sock, packet_sizes[type - 1] + sizeof(uint32_t)) == -1)
-            {
-                fprintf(stderr, "Failed to send packet over UDP.\n");
-                write(send_failure_fd, &error, sizeof(uint64_t));
-                break;
-            }
+			if(send_tcp(pending, snd_data->tcp_sock, count) == -1)
+			{
+				fprintf(stderr, "Failed to send packets over TCP.\n");
+				failed = true;
+			}
+			stream_consume(&tcp_out, count);
 		}
 	}
 
-    free(data);
+	write(send_failure_fd, &error, sizeof(uint64_t));
 	return NULL;
 }
 
@@ -494,13 +466,15 @@ int send_tcp(void * data, TCPsocket sock, uint32_t size){
 /**
  * Sends the specified data over a UDP socket.
  *
- * Allocates the UDP packet, sends it, and frees the packet upon completion.
+ * Builds the datagram in a buffer from @a pool, minimising position updates on the way,
+ * sends it, and gives the buffer back upon completion.
  * If sending the packet was unsuccessful, the function prints an error message.
  *
- * @param[in] data Pointer to the data packet to send over UDP.
+ * @param[in] data Pointer to the data packet to send over UDP. It isn't changed.
  * @param[in] type The type of packet to send.
  * @param[in] sock The socket on which to send the data.
  * @param[in] size The size of the packet.
+ * @param[in] pool The send thread's packet buffers.
  *
  * @return <ul>
  *              <li>Returns 0 on success.</li>
@@ -512,99 +486,82 @@ int send_tcp(void * data, TCPsocket sock, uint32_t size){
  *
  * @date Febuary 15, 2014
  */
-int send_udp(void * data, uint32_t * type, UDPsocket sock, uint32_t size){
+int send_udp(void * data, uint32_t * type, UDPsocket sock, uint32_t size, PacketPool *pool){
 
     int numsent;
+    UDPpacket pktdata;
+
+    memset(&pktdata, 0, sizeof(pktdata));
+    if((pktdata.data = (Uint8 *)pool_get(pool)) == NULL)
+        return -1;
+    pktdata.maxlen = pool->buffer_size;
+
     if(*type == P_POSUPDATE)
     {
     	*type = P_MIN_POS;
-    	data = encapsulate_pos_update((PKT_POS_UPDATE *)data);
+    	encapsulate_pos_update((PKT_POS_UPDATE *)data, (PKT_POS_UPDATE_MIN *)(pktdata.data + sizeof(uint32_t)));
 		size = packet_sizes[*type - 1] + sizeof(uint32_t);
 	}
 	else if(*type == G_ALLPOSUPDATE)
 	{
 		*type = P_MIN_POS_ALL;
-		data = encapsulate_all_pos_update((PKT_ALL_POS_UPDATE *)data);
+		encapsulate_all_pos_update((PKT_ALL_POS_UPDATE *)data, (PKT_ALL_POS_UPDATE_MIN *)(pktdata.data + sizeof(uint32_t)));
 		size = packet_sizes[*type - 1] + sizeof(uint32_t);
 	}
-    
-    UDPpacket *pktdata = alloc_packet(size);
-    memcpy(pktdata->data, type, sizeof(uint32_t));
-    memcpy(pktdata->data + sizeof(uint32_t), data, size - sizeof(uint32_t));
-    pktdata->len = size;
-    pktdata->channel = 0;
-
-    numsent=SDLNet_UDP_Send(sock, pktdata->channel, pktdata);
+	else
+		memcpy(pktdata.data + sizeof(uint32_t), data, size - sizeof(uint32_t));
+
+    memcpy(pktdata.data, type, sizeof(uint32_t));
+    pktdata.len = size;
+    pktdata.channel = 0;
+
+    numsent=SDLNet_UDP_Send(sock, pktdata.channel, &pktdata);
+    pool_put(pool, pktdata.data);
     if(numsent < 0) {
         fprintf(stderr,"SDLNet_UDP_Send: %s\n", SDLNet_GetError());
         return -1;
     }
 
-    SDLNet_FreePacket(pktdata);
     return 0;
 }
 
 
 /**
- * Grabs the first packet on the pipe to be sent by the send thread.
+ * Waits for the first packet in the ring to be sent by the send thread.
+ *
+ * The packet stays in the ring until the caller releases it with ring_release.
  *
- * @param[out] type Receives the type of packet to send.
- * @param[in]  fd   The read descriptor for the pipe between network router/send thread.
- * @param[out] ret  If the function is successful, this holds 1; otherwise, it will hold -1.
+ * @param[out] type     Receives the type of packet to send.
+ * @param[in]  snd_data The send thread's data, holding the ring from the network router and
+ *                      the router's stop flag.
  *
- * @return The packet on success or NULL on failure.
+ * @return The packet on success, or NULL on failure or once the router says to stop.
  *
  * @designer Ramzi Chennafi
  * @author   Ramzi Chennafi
  *
  * @date Febuary 20 2014
  */
-void *grab_send_packet(uint32_t *type, int fd){
+void *grab_send_packet(uint32_t *type, NDATA snd_data){
 
-	*type = read_type(fd);
-	if(*type >= 90)
-    {
-        set_error(ERR_IPC_FAIL);
-		return NULL;
-	}
+	void *data;
 
-	uint32_t size = packet_sizes[*type - 1];
+	while((data = ring_peek(snd_data->ring, type, NULL)) == NULL)
+	{
+		if(__atomic_load_n(&snd_data->stop, __ATOMIC_ACQUIRE))
+			return NULL;
+		ring_wait(snd_data->ring);
+	}
 
-	void * data = read_packet(fd, size); // reads data
-    if(data == NULL)
+	if(*type == 0 || *type > NUM_PACKETS)
     {
         set_error(ERR_IPC_FAIL);
-        return NULL;
-    }
+		return NULL;
+	}
 
 	return data;
 }
 
-/**
- * Creates a UDP packet of size @a size.
- *
- * If the function fails, it prints an error message before returning. 
- *
- * @param[in] size The size of the packet to create.
- *
- * @return A UDPpacket pointer on success or NULL on failure.
- *
- * @designer Ramzi Chennafi
- * @author Ramzi Chennafi
- *
- * @date Febuary 15, 2014
- */
-UDPpacket *alloc_packet(uint32_t size){
-
-	UDPpacket *pktdata = SDLNet_AllocPacket(size);
-
-	if(!pktdata) {
-	    fprintf(stderr, "SDLNet_AllocPacket: %s\n", SDLNet_GetError());
-	    return NULL;
-	}
-
-	return pktdata;
-}
 /**
  * Creates an IPaddress struct holding the IP address and port information for the SDL network functions
  *
@@ -727,6 +684,7 @@ int get_protocol(uint32_t type)
 		case P_FLOOR_MOVE_REQ:
 		case P_FLOOR_MOVE:
 		case P_TAGGING:
+		case P_TAGGING_SEEN:
 			protocol = UDP;	
 			break;
 	}
@@ -14,11 +14,16 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sched.h>
+#include "PacketRing.h"
+#include "PacketPool.h"
+#include "TcpStream.h"
 
 
 #define INFINITE_TIMEOUT -1   /**< Tells SDL to wait for an "infinite" (49 day) timeout */
 #define MAX_TCP_RECV     2944 /**< Max TCP "packet" size from server to client (PKT_GAME_STATUS)*/
-#define MAX_UDP_RECV     644  /**< Max UDP packet size from server to client (PKT_ALL_POS_UPDATE)*/	
+#define MAX_UDP_RECV     708  /**< Max UDP packet size from server to client (PKT_ALL_POS_UPDATE)*/	
+#define TCP_RING_WAIT    1000 /**< Max milliseconds to wait for room in the router's ring for a TCP packet */
 
 #define ERR_NO_CONN       1  /**< The TCP connection could not be opened. */
 #define ERR_CONN_CLOSED   2  /**< The TCP connection was closed. */
@@ -48,27 +53,25 @@ typedef struct cleanup_args
 void *recv_thread_func(void *ndata);
 void recv_thread_clean(void *cleanup_args);
 void *send_thread_func(void *ndata);
+void write_recv_error(PacketRing *router_ring);
 
 /* Socket send functions */
 int send_tcp(void * data, TCPsocket sock, uint32_t type);
-int send_udp(void * data, uint32_t * type, UDPsocket sock, uint32_t size);
+int send_udp(void * data, uint32_t * type, UDPsocket sock, uint32_t size, PacketPool *pool);
 
-void* grab_send_packet(uint32_t *type, int fd);
+void* grab_send_packet(uint32_t *type, struct NETWORK_DATA *snd_data);
 
 /* Socket receive functions */
 int recv_udp (UDPsocket sock, UDPpacket *udp_packet);
-int recv_tcp (TCPsocket sock, void *buf, size_t bufsize);
-void *recv_udp_packet(UDPsocket sock, uint32_t *packet_type, uint64_t *timestamp);
-void *recv_tcp_packet(TCPsocket sock, uint32_t *packet_type, uint64_t *timestamp);
-int handle_tcp_in(int router_pipe_fd, TCPsocket tcp_sock);
-int handle_udp_in(int router_pipe_fd, UDPsocket udp_sock);
+void *recv_udp_packet(UDPsocket sock, PacketPool *pool, uint32_t *packet_type, uint64_t *timestamp);
+int handle_tcp_in(PacketRing *router_ring, TcpStream *stream, TCPsocket tcp_sock);
+int handle_udp_in(PacketRing *router_ring, PacketPool *pool, UDPsocket udp_sock);
 
 int get_protocol(uint32_t type);
 /* Socket creation and utilities */
 void free_sockset(SDLNet_SocketSet set, TCPsocket tcpsock, UDPsocket udpsock);
 TCPsocket initiate_tcp();
 UDPsocket initiate_udp(uint16_t port);
-UDPpacket *alloc_packet(uint32_t size);
 int resolve_host(IPaddress *ip_addr, const uint16_t port, const char *host_ip_string);
 
 /* Socket select functions */
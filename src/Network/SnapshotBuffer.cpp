@@ -0,0 +1,257 @@
+/** @ingroup Network */
+/** @{ */
+
+/**
+ * Keeps the recent position updates of each remote player so they can be drawn
+ * moving smoothly between them, rather than jumping each time an update arrives.
+ *
+ * Updates are stamped on the simulation clock when they arrived at the socket, if the
+ * network backend knows, or else when gameplay takes them. Each step, a remote
+ * player is put where the updates say it was INTERPOLATION_DELAY ms earlier,
+ * between the two updates either side of that time. If the updates have stopped
+ * coming, the player is carried on from the last one by its velocity for a while.
+ *
+ * Each update also keeps the server's timestamp, so the client can tell the server
+ * which moment of a player's history was on screen, such as when tagging it.
+ *
+ * @file SnapshotBuffer.cpp
+ */
+
+/** @} */
+#include "SnapshotBuffer.h"
+#include "../world.h"
+
+#include <string.h>
+#include <time.h>
+
+/**
+ * One position update of a remote player.
+ *
+ * @struct Snapshot
+ */
+typedef struct
+{
+	double		time;	/**< The simulation clock when it arrived, in ms. */
+	uint64_t	stamp;	/**< The server's timestamp on the update. */
+	float		x;
+	float		y;
+	float		movX;
+	float		movY;
+} Snapshot;
+
+/**
+ * The recent updates of one remote player, oldest to newest.
+ *
+ * @struct SnapshotRing
+ */
+typedef struct
+{
+	Snapshot		snapshots[SNAPSHOTS_PER_PLAYER];
+	unsigned int	newest;	/**< The slot of the newest update. */
+	unsigned int	count;	/**< The number of updates kept. */
+	uint64_t		shown;	/**< The server time of the position last sampled. */
+} SnapshotRing;
+
+static SnapshotRing rings[MAX_PLAYERS];	/**< The updates of each player, by server player number. */
+static double snapshot_clock = 0;		/**< The simulation clock, in ms. */
+
+/**
+ * Moves the snapshot clock on by one simulation step. Called at the start of each
+ * movement step.
+ *
+ * @designer
+ * @author
+ */
+void advance_snapshot_clock()
+{
+	snapshot_clock += STEP_MS;
+}
+
+/**
+ * Works out how long ago an update reached the socket.
+ *
+ * @param[in] received When the update reached the socket, in CLOCK_REALTIME ns, or 0 if
+ *                     it isn't known.
+ *
+ * @return The age in ms, from 0 to INTERPOLATION_DELAY; 0 if it isn't known.
+ *
+ * @designer
+ * @author
+ */
+double snapshot_age(uint64_t received)
+{
+	struct timespec now;
+	double age;
+
+	if(received == 0 || clock_gettime(CLOCK_REALTIME, &now) == -1)
+		return 0;
+
+	age = ((double)now.tv_sec * 1e9 + now.tv_nsec - (double)received) / 1e6;
+	if(age < 0)
+		return 0;
+	return age > INTERPOLATION_DELAY ? INTERPOLATION_DELAY : age;
+}
+
+/**
+ * Keeps a position update for a remote player, stamped with the time it arrived.
+ *
+ * Updates are kept in the order they come; one that seems to have arrived no later than
+ * the newest one kept replaces it.
+ *
+ * @param[in] playerNo The server's player number.
+ * @param[in] stamp    The server's timestamp on the update.
+ * @param[in] age      How many ms ago the update arrived, from snapshot_age.
+ * @param[in] x        The player's x position.
+ * @param[in] y        The player's y position.
+ * @param[in] movX     The player's velocity across.
+ * @param[in] movY     The player's velocity down.
+ *
+ * @designer
+ * @author
+ */
+void push_snapshot(unsigned int playerNo, uint64_t stamp, double age, float x, float y, float movX, float movY)
+{
+	SnapshotRing *ring;
+	Snapshot *snapshot;
+	double time = snapshot_clock - age;
+
+	if(playerNo >= MAX_PLAYERS)
+		return;
+
+	ring = &rings[playerNo];
+
+	// two updates at the same time: the later one wins
+	if(ring->count > 0 && ring->snapshots[ring->newest].time >= time)
+	{
+		time = ring->snapshots[ring->newest].time;
+	}
+	else
+	{
+		ring->newest = (ring->newest + 1) & (SNAPSHOTS_PER_PLAYER - 1);
+		if(ring->count < SNAPSHOTS_PER_PLAYER)
+			ring->count++;
+	}
+
+	snapshot = &ring->snapshots[ring->newest];
+	snapshot->time  = time;
+	snapshot->stamp = stamp;
+	snapshot->x     = x;
+	snapshot->y     = y;
+	snapshot->movX  = movX;
+	snapshot->movY  = movY;
+}
+
+/**
+ * Finds where a remote player should be now: where its updates put it
+ * INTERPOLATION_DELAY ms ago.
+ *
+ * Between two updates the position is blended from one to the other. Before the
+ * oldest update the player stays at it. After the newest, the player is carried on
+ * by the newest update's velocity for up to EXTRAPOLATION_LIMIT ms and then held.
+ * The server time of the position is kept for shown_snapshot_stamp.
+ *
+ * @param[in]  playerNo The server's player number.
+ * @param[out] x        Set to the player's x position.
+ * @param[out] y        Set to the player's y position.
+ *
+ * @return false if there are no updates for the player.
+ *
+ * @designer
+ * @author
+ */
+bool sample_snapshot(unsigned int playerNo, float *x, float *y)
+{
+	SnapshotRing *ring;
+	const Snapshot *before, *after;
+	double time = snapshot_clock - INTERPOLATION_DELAY;
+	double ahead;
+	float blend;
+	unsigned int n, slot;
+
+	if(playerNo >= MAX_PLAYERS || rings[playerNo].count == 0)
+		return false;
+
+	ring = &rings[playerNo];
+	after = &ring->snapshots[ring->newest];
+
+	// late: carry on from the newest update
+	if(time >= after->time)
+	{
+		ahead = time - after->time;
+		if(ahead > EXTRAPOLATION_LIMIT)
+			ahead = EXTRAPOLATION_LIMIT;
+
+		*x = after->x + after->movX * STEP_SCALE * ahead / STEP_MS;
+		*y = after->y + after->movY * STEP_SCALE * ahead / STEP_MS;
+		ring->shown = after->stamp;
+		return true;
+	}
+
+	// walk back to the newest update that isn't after the time
+	for(n = 1; n < ring->count; ++n)
+	{
+		slot   = (ring->newest - n) & (SNAPSHOTS_PER_PLAYER - 1);
+		before = &ring->snapshots[slot];
+
+		if(before->time <= time)
+		{
+			blend = (float)((time - before->time) / (after->time - before->time));
+			*x = before->x + (after->x - before->x) * blend;
+			*y = before->y + (after->y - before->y) * blend;
+			// stamps come from the server, so they can be out of order even when the arrival times aren't
+			ring->shown = before->stamp + (int64_t)((int64_t)(after->stamp - before->stamp) * blend);
+			return true;
+		}
+		after = before;
+	}
+
+	// early: hold at the oldest update
+	*x = after->x;
+	*y = after->y;
+	ring->shown = after->stamp;
+	return true;
+}
+
+/**
+ * Gets the server time of where a player was last drawn, so the server can look the
+ * player up in its own history at the moment the client saw.
+ *
+ * @param[in] playerNo The server's player number.
+ *
+ * @return The server's timestamp of the position last sampled, or 0 if there is none.
+ *
+ * @designer
+ * @author
+ */
+uint64_t shown_snapshot_stamp(unsigned int playerNo)
+{
+	if(playerNo >= MAX_PLAYERS || rings[playerNo].count == 0)
+		return 0;
+
+	return rings[playerNo].shown;
+}
+
+/**
+ * Forgets a player's updates, for when it leaves the floor.
+ *
+ * @param[in] playerNo The server's player number.
+ *
+ * @designer
+ * @author
+ */
+void clear_snapshots(unsigned int playerNo)
+{
+	if(playerNo < MAX_PLAYERS)
+		rings[playerNo].count = 0;
+}
+
+/**
+ * Forgets every player's updates, for when the client changes floors.
+ *
+ * @designer
+ * @author
+ */
+void clear_all_snapshots()
+{
+	memset(rings, 0, sizeof(rings));
+}
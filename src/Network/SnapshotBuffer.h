@@ -0,0 +1,25 @@
+/** @ingroup Network */
+/** @{ */
+/**
+ * @file SnapshotBuffer.h
+ */
+/** @} */
+#ifndef SNAPSHOT_BUFFER_H
+#define SNAPSHOT_BUFFER_H
+
+#include "Packets.h"
+#include <stdint.h>
+
+#define SNAPSHOTS_PER_PLAYER	16		/**< Position updates kept per player. Must be a power of two. */
+#define INTERPOLATION_DELAY		100		/**< How far behind the latest update remote players are drawn, in ms. */
+#define EXTRAPOLATION_LIMIT		250		/**< Longest ms a remote player is carried on by its velocity when updates stop. */
+
+void advance_snapshot_clock();
+double snapshot_age(uint64_t received);
+void push_snapshot(unsigned int playerNo, uint64_t stamp, double age, float x, float y, float movX, float movY);
+bool sample_snapshot(unsigned int playerNo, float *x, float *y);
+uint64_t shown_snapshot_stamp(unsigned int playerNo);
+void clear_snapshots(unsigned int playerNo);
+void clear_all_snapshots();
+
+#endif
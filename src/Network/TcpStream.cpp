@@ -0,0 +1,214 @@
+/** @ingroup Network */
+/** @{ */
+
+/**
+ * Framing of the TCP stream to and from the server.
+ *
+ * Each packet on the stream is its type followed by packet_sizes[type - 1] bytes. Keep
+ * alives have no body. A receive fills the buffer with whatever has arrived, however
+ * many packets (or parts of them) that is, and the packets are then read straight out
+ * of the buffer. Outgoing packets are collected the same way so that everything
+ * waiting goes out in one send.
+ *
+ * @file TcpStream.cpp
+ */
+
+/** @} */
+#include "TcpStream.h"
+#include "Packets.h"
+#include "ServerCommunication.h"
+
+#include <string.h>
+
+extern uint32_t packet_sizes[NUM_PACKETS + 1];
+
+/**
+ * Empties a stream.
+ *
+ * @param[out] stream The stream.
+ *
+ * @designer
+ * @author
+ */
+void stream_reset(TcpStream *stream)
+{
+	stream->start = 0;
+	stream->end   = 0;
+}
+
+/**
+ * Moves the bytes not yet taken to the front of the buffer.
+ *
+ * @param[in, out] stream The stream.
+ *
+ * @designer
+ * @author
+ */
+static void stream_compact(TcpStream *stream)
+{
+	if(stream->start == 0)
+		return;
+
+	memmove(stream->data, stream->data + stream->start, stream->end - stream->start);
+	stream->end  -= stream->start;
+	stream->start = 0;
+}
+
+/**
+ * Gets the free space at the end of the buffer for a receive to fill.
+ *
+ * The space is always large enough for the rest of any packet that is partly buffered.
+ *
+ * @param[in, out] stream The stream.
+ * @param[out]     room   Receives the number of bytes free.
+ *
+ * @return Where to put the received bytes.
+ *
+ * @designer
+ * @author
+ */
+unsigned char *stream_space(TcpStream *stream, unsigned int *room)
+{
+	stream_compact(stream);
+	*room = TCP_STREAM_SIZE - stream->end;
+	return stream->data + stream->end;
+}
+
+/**
+ * Adds bytes that were received into the space from stream_space.
+ *
+ * @param[in, out] stream The stream.
+ * @param[in]      count  The number of bytes received.
+ *
+ * @designer
+ * @author
+ */
+void stream_fill(TcpStream *stream, unsigned int count)
+{
+	stream->end += count;
+}
+
+/**
+ * Takes the next whole packet off the stream, skipping keep alives.
+ *
+ * The packet is left in the buffer, where it stays until the next stream_space. It may
+ * not be aligned, so copy it before reading its fields.
+ *
+ * @param[in, out] stream The stream.
+ * @param[out]     type   Receives the packet's type. It's 0 if the rest of the stream is
+ *                        only part of a packet, or INVALID_PACKET_TYPE if the stream is
+ *                        corrupted.
+ *
+ * @return The packet, or NULL if there is no whole packet left or the stream is corrupted.
+ *
+ * @designer
+ * @author
+ */
+void *stream_next(TcpStream *stream, uint32_t *type)
+{
+	uint32_t size;
+	void *packet;
+
+	while(stream->end - stream->start >= sizeof(*type))
+	{
+		memcpy(type, stream->data + stream->start, sizeof(*type));
+		if(*type == P_KEEPALIVE)
+		{
+			stream->start += sizeof(*type);
+			continue;
+		}
+
+		if(*type <= 1 || *type > NUM_PACKETS)
+		{
+			*type = INVALID_PACKET_TYPE;
+			return NULL;
+		}
+
+		size = packet_sizes[*type - 1];
+		if(stream->end - stream->start < sizeof(*type) + size)
+			break;
+
+		packet = stream->data + stream->start + sizeof(*type);
+		stream->start += sizeof(*type) + size;
+		return packet;
+	}
+
+	*type = 0;
+	return NULL;
+}
+
+/**
+ * Gets the space left for packets to be added.
+ *
+ * @param[in] stream The stream.
+ *
+ * @return The number of bytes that can still be added.
+ *
+ * @designer
+ * @author
+ */
+unsigned int stream_room(TcpStream *stream)
+{
+	return TCP_STREAM_SIZE - (stream->end - stream->start);
+}
+
+/**
+ * Adds a packet and its type to the end of the stream.
+ *
+ * @param[in, out] stream The stream.
+ * @param[in]      type   The packet's type.
+ * @param[in]      packet The packet.
+ *
+ * @return 0 on success, or -1 if there isn't room; send what's pending and try again.
+ *
+ * @designer
+ * @author
+ */
+int stream_append(TcpStream *stream, uint32_t type, const void *packet)
+{
+	uint32_t size = packet_sizes[type - 1];
+
+	if(stream_room(stream) < sizeof(type) + size)
+		return -1;
+
+	if(TCP_STREAM_SIZE - stream->end < sizeof(type) + size)
+		stream_compact(stream);
+
+	memcpy(stream->data + stream->end, &type, sizeof(type));
+	memcpy(stream->data + stream->end + sizeof(type), packet, size);
+	stream->end += sizeof(type) + size;
+	return 0;
+}
+
+/**
+ * Gets the bytes waiting to be sent.
+ *
+ * @param[in]  stream The stream.
+ * @param[out] data   Receives the first byte waiting.
+ *
+ * @return The number of bytes waiting.
+ *
+ * @designer
+ * @author
+ */
+unsigned int stream_pending(TcpStream *stream, unsigned char **data)
+{
+	*data = stream->data + stream->start;
+	return stream->end - stream->start;
+}
+
+/**
+ * Removes bytes that have been sent from the front of the stream.
+ *
+ * @param[in, out] stream The stream.
+ * @param[in]      count  The number of bytes sent.
+ *
+ * @designer
+ * @author
+ */
+void stream_consume(TcpStream *stream, unsigned int count)
+{
+	stream->start += count;
+	if(stream->start == stream->end)
+		stream_reset(stream);
+}
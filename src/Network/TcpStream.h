@@ -0,0 +1,44 @@
+/** @ingroup Network */
+/** @{ */
+/**
+ * @file TcpStream.h
+ */
+/** @} */
+#ifndef TCP_STREAM_H
+#define TCP_STREAM_H
+
+#include <stdint.h>
+
+#define TCP_STREAM_SIZE	12288	/**< Bytes each stream buffers; room for several of the largest packets. */
+
+/**
+ * A buffer of the TCP byte stream to or from the server, which is a packet type
+ * followed by that packet, over and over.
+ *
+ * Reading, as many bytes as the socket has are added at once and then taken off a
+ * packet at a time. Writing, packets are added one at a time and then as many bytes
+ * as the socket takes are sent at once.
+ *
+ * @struct TcpStream
+ */
+typedef struct
+{
+	unsigned int	start;	/**< The first byte not yet taken. */
+	unsigned int	end;	/**< One past the last byte added. */
+	unsigned char	data[TCP_STREAM_SIZE];
+} TcpStream;
+
+void stream_reset(TcpStream *stream);
+
+/* Reading */
+unsigned char *stream_space(TcpStream *stream, unsigned int *room);
+void stream_fill(TcpStream *stream, unsigned int count);
+void *stream_next(TcpStream *stream, uint32_t *type);
+
+/* Writing */
+unsigned int stream_room(TcpStream *stream);
+int stream_append(TcpStream *stream, uint32_t type, const void *packet);
+unsigned int stream_pending(TcpStream *stream, unsigned char **data);
+void stream_consume(TcpStream *stream, unsigned int count);
+
+#endif
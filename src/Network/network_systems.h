@@ -10,6 +10,7 @@
 #include <cstring>
 #include <sys/poll.h>
 #include <climits>
+#include "PacketMailbox.h"
 
 #define CLIENT_PLAYER    0 			/**< The client's player's entity number (may also be passed into the function) */
 #define UNASSIGNED       4294967295	/**< The player's number has not yet been assigned. */
@@ -26,13 +27,14 @@
 
 typedef struct _objective_cache
 {
-	char  obj_state;
-	short entity_no;
+	char  		 obj_state;
+	EntityHandle entity;	/**< The objective's entity on the current floor. */
 } objective_cache;
 
 int init_client_update(World *world);
-int client_update_system(World *world, int net_pipe);
-void client_update_pos(World *world, void *packet);
+unsigned int player_lookup(World *world, unsigned int playerNo);
+int client_update_system(World *world, PacketInbox *inbox);
+void client_update_pos(World *world, void *packet, uint64_t timestamp, uint64_t received);
 void client_update_status(World *world, void *packet);
 int client_update_info(World *world, void *packet);
 void client_update_chat(World *world, void *packet);
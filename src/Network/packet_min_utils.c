@@ -19,10 +19,13 @@
  * significantly increasing network performance.
  *	
  *	There are 4 functions implemented here (see their comments for more information):
- *		PKT_POS_UPDATE_MIN_MIN encapsulate_pos_update(PKT_POS_UPDATE_MIN old_pkt);
- *		PKT_POS_UPDATE_MIN decapsulate_pos_update(PKT_POS_UPDATE_MIN_MIN pkt);
- *		PKT_ALL_POS_UPDATE_MIN_MIN encapsulate_all_pos_update(PKT_ALL_POS_UPDATE_MIN old_pkt);
- *		PKT_ALL_POS_UPDATE_MIN decapsulate_all_pos_update(PKT_ALL_POS_UPDATE_MIN_MIN pkt);
+ *		void encapsulate_pos_update(const PKT_POS_UPDATE *old_pkt, PKT_POS_UPDATE_MIN *pkt);
+ *		void decapsulate_pos_update(const PKT_POS_UPDATE_MIN *pkt, PKT_POS_UPDATE *old_pkt);
+ *		void encapsulate_all_pos_update(const PKT_ALL_POS_UPDATE *old_pkt, PKT_ALL_POS_UPDATE_MIN *pkt);
+ *		void decapsulate_all_pos_update(const PKT_ALL_POS_UPDATE_MIN *pkt, PKT_ALL_POS_UPDATE *old_pkt);
+ *
+ *	Each one writes into a packet the caller provides (a ring slot, say) and allocates
+ *	nothing, so converting packets never touches the heap.
  *	
  *	There are also 2 new structures here:
  *		PKT_POS_UPDATE_MIN:
@@ -57,28 +60,20 @@
  */
 
 /**
- * This encapsulates the data from an old packet into a new packet and frees the old packet, no
- * questions asked.
+ * This encapsulates the data from an old packet into a new packet, no questions asked.
  *
- * This function returns NULL if memory couldn't be allocated, but otherwise always returns
- * a successfully encapsulated packet. If there is data that is out of bounds, (for example
- * a position higher than 4096) it will overflow silently. The structure returned can be 
- * easily sent over the network.
+ * If there is data that is out of bounds, (for example a position higher than 4096) it
+ * will overflow silently. The structure written can be easily sent over the network.
  *
  * @param old_pkt Pointer to the PKT_POS_UPDATE_ packet to be encapsulated. Must be valid.
- * @return Pointer to the encapsulated PKT_POS_UPDATE_MIN. Returns NULL if the packet couldn't be 
- *         allocated.
+ * @param pkt     Pointer to the PKT_POS_UPDATE_MIN to write the encapsulated packet into.
  *
  * @designer Clark Allenby
  * @author   Clark Allenby
  */
-PKT_POS_UPDATE_MIN *encapsulate_pos_update(PKT_POS_UPDATE *old_pkt) {
-	PKT_POS_UPDATE_MIN *pkt = (PKT_POS_UPDATE_MIN *)malloc(sizeof(PKT_POS_UPDATE_MIN));
+void encapsulate_pos_update(const PKT_POS_UPDATE *old_pkt, PKT_POS_UPDATE_MIN *pkt) {
 	uint32_t n_xPos, n_yPos, n_xVel, n_yVel;
 	
-	if(!pkt)
-		return NULL;
-	
 	n_xPos = (uint32_t)round(old_pkt->xPos / GRANULARITY_POS);
 	n_yPos = (uint32_t)round(old_pkt->yPos / GRANULARITY_POS);
 	n_xVel = (uint32_t)round(old_pkt->xVel * GRANULARITY_VEL + FACTOR);
@@ -98,31 +93,24 @@ PKT_POS_UPDATE_MIN *encapsulate_pos_update(PKT_POS_UPDATE *old_pkt) {
 	pkt->vel <<= 8;
 	pkt->vel |= n_yVel & 0xFF;
 	
-	free(old_pkt);
-	return pkt;
+	pkt->seq = old_pkt->seq;
 }
 
 /**
  * This decapsulates a new packet into an old packet, allowing for
  * easy implementation to existing code.
  *
- * This function fails only if memory can't be allocated and always returns with a valid
- * structure. Note that the actual transmitted data may be wrong.
+ * This function always writes a valid structure. Note that the actual transmitted data
+ * may be wrong.
  *
- * @param pkt Pointer to the PKT_POS_UPDATE_MIN packet to be decapsulated. Must be valid.
- * @return Pointer to the decapsulated PKT_POS_UPDATE_. This may contain incorrect
- *         or impossible values (according to game rules). Returns NULL if the packet 
- *         couldn't be allocated.
+ * @param pkt     Pointer to the PKT_POS_UPDATE_MIN packet to be decapsulated. Must be valid.
+ * @param old_pkt Pointer to the PKT_POS_UPDATE_ to write the decapsulated packet into. This
+ *                may contain incorrect or impossible values (according to game rules).
  *
  * @designer Clark Allenby
  * @author   Clark Allenby
  */
-PKT_POS_UPDATE *decapsulate_pos_update(PKT_POS_UPDATE_MIN *pkt) {
-	PKT_POS_UPDATE *old_pkt = (PKT_POS_UPDATE *)malloc(sizeof(PKT_POS_UPDATE));
-	
-	if(!old_pkt)
-		return NULL;
-	
+void decapsulate_pos_update(const PKT_POS_UPDATE_MIN *pkt, PKT_POS_UPDATE *old_pkt) {
 	old_pkt->floor = (pkt->data >> 27) & 0x1F;
 	old_pkt->player_number = (pkt->data >> 22) & 0x1F;
 	old_pkt->xPos = (float)(GRANULARITY_POS * ((pkt->data >> 11) & 0x7FF));
@@ -131,19 +119,15 @@ PKT_POS_UPDATE *decapsulate_pos_update(PKT_POS_UPDATE_MIN *pkt) {
 	old_pkt->xVel = (float)((((pkt->vel >> 8) & 0xFF) - FACTOR) / GRANULARITY_VEL);
 	old_pkt->yVel = (float)(((pkt->vel & 0xFF) - FACTOR) / GRANULARITY_VEL);
 	
-	free(pkt);
-	
-	return old_pkt;
+	old_pkt->seq = pkt->seq;
 }
 
 /**
  * This encapsulates the data from an old packet into a new packet, no
  * questions asked.
  *
- * This function returns NULL if memory can't be allocated, but otherwise returns with
- * a successful packet. If there is data that is out of bounds, (for example a position
- * higher than 4096) it will overflow silently. The structure returned can be easily sent
- * over the network.
+ * If there is data that is out of bounds, (for example a position higher than 4096) it
+ * will overflow silently. The structure written can be easily sent over the network.
  *
  * Revisions: <ul>
  *					<li>March 22, 2014 - Shane Spoor - Uses loops instead of hard coding
@@ -151,19 +135,15 @@ PKT_POS_UPDATE *decapsulate_pos_update(PKT_POS_UPDATE_MIN *pkt) {
  *            </ul>
  *
  * @param old_pkt Pointer to the PKT_ALL_POS_UPDATE packet to be encapsulated. Must be valid.
- * @return Pointer to the encapsulated PKT_ALL_POS_UPDATE_MIN, or NULL if the memory couldn't be allocated.
+ * @param pkt     Pointer to the PKT_ALL_POS_UPDATE_MIN to write the encapsulated packet into.
  *
  * @designer Clark Allenby
  * @author   Clark Allenby
  */
-PKT_ALL_POS_UPDATE_MIN *encapsulate_all_pos_update(PKT_ALL_POS_UPDATE *old_pkt) {
-	PKT_ALL_POS_UPDATE_MIN *pkt = (PKT_ALL_POS_UPDATE_MIN*)malloc(sizeof (PKT_ALL_POS_UPDATE_MIN));
+void encapsulate_all_pos_update(const PKT_ALL_POS_UPDATE *old_pkt, PKT_ALL_POS_UPDATE_MIN *pkt) {
 	int i, j;
 	uint32_t n_xPos[32], n_yPos[32], n_xVel, n_yVel, and_mask;
 	
-	if(!pkt)
-		return NULL;
-	
 	pkt->floor = (uint8_t)old_pkt->floor;
 	pkt->players_on_floor = 0;
 	for (i = 0; i < 32; i++) {
@@ -176,6 +156,7 @@ PKT_ALL_POS_UPDATE_MIN *encapsulate_all_pos_update(PKT_ALL_POS_UPDATE *old_pkt)
 		pkt->vel[i] <<= 8;
 		pkt->vel[i] |= n_yVel & 0xFF;
 		pkt->players_on_floor |= (old_pkt->players_on_floor[i]) << i;
+		pkt->ack[i] = old_pkt->ack[i];
 	}
 	
 	memset(&pkt->xPos, 0x00, sizeof(uint32_t) * 11);
@@ -204,45 +185,38 @@ PKT_ALL_POS_UPDATE_MIN *encapsulate_all_pos_update(PKT_ALL_POS_UPDATE *old_pkt)
 		pkt->yPos[j] |= (n_yPos[i + 2] & 0x7FF) << (10 - j);
 		pkt->yPos[j] |= (n_yPos[i + 3] & (0x7FE - (1 << j))) >> (j + 1);
 	}
-
-	free(old_pkt);
-	return pkt;
 }
 
 /**
  * This decapsulates a new packet into an old packet, allowing for
  * easy implementation to existing code.
  *
- * This function returns NULL if memory can't be allocated, but otherwise
- * returns with a valid structure. Note that the actual transmitted data may be wrong.
+ * This function always writes a valid structure. Note that the actual transmitted data
+ * may be wrong.
  *
  * Revisions: <ul>
  *					<li>March 22, 2014 - Shane Spoor - Uses loops instead of hard coding
  *                      each step, and returns a pointer to the packet.</li>
  *            </ul>
  *
- * @param pkt Pointer to the PKT_ALL_POS_UPDATE_MIN packet to be decapsulated. Must be valid.
- * @return Pointer to the decapsulated PKT_ALL_POS_UPDATE. This may contain incorrect
- *         or impossible values (according to game rules). Returns NULL if the packet
- *         couldn't be allocated.
+ * @param pkt     Pointer to the PKT_ALL_POS_UPDATE_MIN packet to be decapsulated. Must be valid.
+ * @param old_pkt Pointer to the PKT_ALL_POS_UPDATE to write the decapsulated packet into. This
+ *                may contain incorrect or impossible values (according to game rules).
  *
  * @designer Clark Allenby
  * @author   Clark Allenby
  */
-PKT_ALL_POS_UPDATE *decapsulate_all_pos_update(PKT_ALL_POS_UPDATE_MIN *pkt) {
-	PKT_ALL_POS_UPDATE *old_pkt = (PKT_ALL_POS_UPDATE*)malloc(sizeof(PKT_ALL_POS_UPDATE));
+void decapsulate_all_pos_update(const PKT_ALL_POS_UPDATE_MIN *pkt, PKT_ALL_POS_UPDATE *old_pkt) {
 	int i, j;
 	uint32_t temp, and_mask;
 	
-	if(!old_pkt)
-		return NULL;
-	
 	old_pkt->floor = (floorNo_t)pkt->floor;
 	
 	for (i = 0; i < 32; i++) {
 		old_pkt->players_on_floor[i] = (pkt->players_on_floor >> i) & 0x1;
 		old_pkt->xVel[i] = (float)((((pkt->vel[i] >> 8) & 0xFF) - FACTOR) / GRANULARITY_VEL);
 		old_pkt->yVel[i] = (float)(((pkt->vel[i] & 0xFF) - FACTOR) / GRANULARITY_VEL);
+		old_pkt->ack[i] = pkt->ack[i];
 	}
 	
 	old_pkt->xPos[0] = (float)(GRANULARITY_POS * ((pkt->xPos[0] >> 21) & 0x7FF));
@@ -274,8 +248,5 @@ PKT_ALL_POS_UPDATE *decapsulate_all_pos_update(PKT_ALL_POS_UPDATE_MIN *pkt) {
 		temp =  (pkt->yPos[j] << (j + 1)) & (0x7FE - (1 << j));
 		temp += (pkt->yPos[j + 1] >> (31 - j)) & and_mask;
 	}
-	
-	free(pkt);
-	return old_pkt;
 }
 
@@ -12,9 +12,9 @@
 #define GRANULARITY_POS 2.0
 #define FACTOR 128
 
-PKT_POS_UPDATE_MIN *encapsulate_pos_update(PKT_POS_UPDATE *old_pkt);
-PKT_POS_UPDATE *decapsulate_pos_update(PKT_POS_UPDATE_MIN *pkt);
-PKT_ALL_POS_UPDATE_MIN *encapsulate_all_pos_update(PKT_ALL_POS_UPDATE *old_pkt);
-PKT_ALL_POS_UPDATE *decapsulate_all_pos_update(PKT_ALL_POS_UPDATE_MIN *pkt);
+void encapsulate_pos_update(const PKT_POS_UPDATE *old_pkt, PKT_POS_UPDATE_MIN *pkt);
+void decapsulate_pos_update(const PKT_POS_UPDATE_MIN *pkt, PKT_POS_UPDATE *old_pkt);
+void encapsulate_all_pos_update(const PKT_ALL_POS_UPDATE *old_pkt, PKT_ALL_POS_UPDATE_MIN *pkt);
+void decapsulate_all_pos_update(const PKT_ALL_POS_UPDATE_MIN *pkt, PKT_ALL_POS_UPDATE *old_pkt);
 
 #endif
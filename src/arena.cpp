@@ -0,0 +1,129 @@
+/**
+ * A bump allocator for memory that is all released at the same time.
+ *
+ * The blocks are kept when the arena is reset, so filling it up again doesn't go
+ * back to the heap unless it needs more than last time.
+ *
+ * @file arena.cpp
+ */
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Allocates memory from the arena. The memory is not cleared.
+ *
+ * @param arena 	The arena.
+ * @param size 		The number of bytes needed.
+ *
+ * @return The memory, or NULL if a new block couldn't be allocated.
+ *
+ * @designer
+ * @author
+ */
+void *arena_alloc(Arena *arena, size_t size) {
+	ArenaBlock *block = arena->current;
+	ArenaBlock *added;
+	size_t block_size;
+	void *memory;
+	
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	
+	//move on to the blocks kept from before the last reset until one has room
+	while (block != NULL && block->size - block->used < size) {
+		block = block->next;
+		if (block != NULL) {
+			block->used = 0;
+		}
+	}
+	
+	if (block == NULL) {
+		block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+		
+		//the header is padded out so the first allocation is aligned
+		added = (ArenaBlock*)malloc(((sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1)) + block_size);
+		if (added == NULL) {
+			perror("arena_alloc: malloc");
+			return NULL;
+		}
+		added->size = block_size;
+		added->used = 0;
+		added->next = NULL;
+		
+		//skipped blocks stay at the front of the list, the new block goes on the end
+		if (arena->first == NULL) {
+			arena->first = added;
+		}
+		else {
+			for (block = arena->current; block->next != NULL; block = block->next);
+			block->next = added;
+		}
+		block = added;
+	}
+	
+	memory = (char*)block + ((sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1)) + block->used;
+	block->used += size;
+	arena->current = block;
+	
+	return memory;
+}
+
+/**
+ * Copies a string into the arena.
+ *
+ * @param arena 	The arena.
+ * @param string 	The string to copy.
+ *
+ * @return The copy, or NULL if there was no memory for it.
+ *
+ * @designer
+ * @author
+ */
+char *arena_strdup(Arena *arena, const char *string) {
+	size_t length = strlen(string) + 1;
+	char *copy = (char*)arena_alloc(arena, length);
+	
+	if (copy != NULL) {
+		memcpy(copy, string, length);
+	}
+	return copy;
+}
+
+/**
+ * Releases everything allocated from the arena at once. The blocks are kept for
+ * the next round of allocations.
+ *
+ * @param arena 	The arena.
+ *
+ * @designer
+ * @author
+ */
+void arena_reset(Arena *arena) {
+	arena->current = arena->first;
+	if (arena->current != NULL) {
+		arena->current->used = 0;
+	}
+}
+
+/**
+ * Releases everything allocated from the arena and gives its blocks back to the heap.
+ *
+ * @param arena 	The arena.
+ *
+ * @designer
+ * @author
+ */
+void arena_free(Arena *arena) {
+	ArenaBlock *block = arena->first;
+	ArenaBlock *next;
+	
+	while (block != NULL) {
+		next = block->next;
+		free(block);
+		block = next;
+	}
+	arena->first = NULL;
+	arena->current = NULL;
+}
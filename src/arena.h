@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE	(64 * 1024)	//bytes in a block, unless one allocation needs more
+#define ARENA_ALIGN			16			//every allocation starts on this boundary
+
+//One chunk of arena memory. The allocations follow the header.
+typedef struct ArenaBlock {
+	struct ArenaBlock	*next;
+	size_t				size;	//bytes after the header
+	size_t				used;	//bytes handed out
+} ArenaBlock;
+
+//A bump allocator. Memory is handed out from the blocks in order and only given
+//back all at once, by arena_reset or arena_free.
+typedef struct {
+	ArenaBlock	*first;
+	ArenaBlock	*current;	//the block allocations are coming from
+} Arena;
+
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strdup(Arena *arena, const char *string);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+
+#endif
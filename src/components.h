@@ -5,7 +5,8 @@
 #include "Graphics/components.h"
 #include "Input/components.h"
 
-/* Each components needs to be added here */
+/* Each components needs to be added here. Masks are 64 bits wide (see ComponentMask in
+ * world.h), so components past 1 << 30 have to be written as 1ULL << n. */
 typedef enum {
 	COMPONENT_EMPTY = 0,
 	COMPONENT_MOUSE = 1 << 0,
@@ -26,7 +27,11 @@ typedef enum {
 	COMPONENT_MENU_ITEM = 1 << 15,
 	COMPONENT_STILE = 1 << 16,
 	COMPONENT_POWERUP = 1 << 17,
-	COMPONENT_CUTSCENE = 1 << 18
+	COMPONENT_CUTSCENE = 1 << 18,
+	COMPONENT_STATIC = 1 << 19
 } Components;
 
+/* The number of components above, not counting COMPONENT_EMPTY */
+#define NUM_COMPONENTS 20
+
 #endif
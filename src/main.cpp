@@ -14,14 +14,15 @@
 
 bool running;
 unsigned int player_entity;
-int send_router_fd[2];
-int rcv_router_fd[2];
-int game_net_signalfd;
+EntityHandle player_handle = INVALID_HANDLE;
+PacketRing *send_router_ring;
+PacketInbox *rcv_router_inbox;
 int network_ready = 0;
 FowComponent *fow;
 int window_width = WIDTH;
 int window_height = HEIGHT;
 SDL_Window *window;
+float step_alpha = 0;	//how far into the next simulation step the clock is, for drawing between steps
 
 
 int main(int argc, char* argv[]) {
@@ -71,6 +72,9 @@ int main(int argc, char* argv[]) {
 
 	FPS fps;
 	fps.init();
+	
+	double step_time = 0;	//time that has passed and not been simulated yet, in ms
+	unsigned int last_ticks = SDL_GetTicks();
 
 	running = true;
 	player_entity = -1;
@@ -81,9 +85,30 @@ int main(int argc, char* argv[]) {
 	while (running)
 	{
 		unsigned int current_time;
+		
+		//sync point: apply the creates, destroys and component changes the systems queued last frame
+		apply_commands(world);
+		
+		//forget the player if their entity was destroyed out from under us
+		if (player_entity < MAX_ENTITIES && entity_from_handle(world, player_handle) != player_entity) {
+			player_entity = MAX_ENTITIES;
+		}
+		
 		KeyInputSystem(world);
 		MouseInputSystem(world);
-		movement_system(world, fps, send_router_fd[WRITE]);
+		
+		//run the simulation in fixed steps for the time that has passed
+		current_time = SDL_GetTicks();
+		step_time += current_time - last_ticks;
+		last_ticks = current_time;
+		if (step_time > MAX_STEPS_PER_FRAME * STEP_MS) {
+			step_time = MAX_STEPS_PER_FRAME * STEP_MS;
+		}
+		while (step_time >= STEP_MS) {
+			movement_system(world, send_router_ring);
+			step_time -= STEP_MS;
+		}
+		step_alpha = step_time / STEP_MS;
 
 		if (player_entity < MAX_ENTITIES) {
 			map_render(surface, world, player_entity);
@@ -115,9 +140,9 @@ int main(int argc, char* argv[]) {
 			if((current_time - begin_time) >= (1000/SEND_FREQUENCY))
 			{
 				begin_time = SDL_GetTicks();
-				send_location(world, send_router_fd[WRITE]);
+				send_location(world, send_router_ring);
 			}
-			client_update_system(world, rcv_router_fd[READ]);
+			client_update_system(world, rcv_router_inbox);
 		}
 
 		fps.limit();
@@ -130,7 +155,7 @@ int main(int argc, char* argv[]) {
 	cleanup_sound();
 	cleanup_fonts();
 	
-	destroy_world(world);
+	cleanup_world(world);
 	free(world);
 	IMG_Quit();
 	SDL_Quit();
@@ -0,0 +1,196 @@
+/**
+ * A microbenchmark for overlap_boxes, the batched overlap test the collision checks
+ * use, against the one-collider-at-a-time test they used before it.
+ *
+ * Both are run over the same random colliders and boxes, for both readings of x and y.
+ * The hit bits are compared first, then each is timed. Build it with "make overlap_bench"
+ * and run bin/overlap_bench [colliders] [queries].
+ *
+ * @file overlap_bench.cpp
+ */
+#include "world.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_COLLIDERS	64		/**< The default number of colliders tested against each box. */
+#define BENCH_QUERIES	200000	/**< The default number of boxes timed. */
+#define BENCH_BOXES		1024	/**< The number of different boxes the queries cycle through. */
+#define BENCH_AREA		2048	/**< The colliders and boxes are placed in a square this many pixels across. */
+
+unsigned int background;	//world.cpp keeps the menu's background alive; the menu isn't linked in here
+
+/**
+ * Tests colliders against a box one at a time, the way the collision checks did before
+ * overlap_boxes.
+ *
+ * @param box 		The box.
+ * @param x 		The colliders' x positions.
+ * @param y 		The colliders' y positions.
+ * @param width 	The colliders' widths.
+ * @param height 	The colliders' heights.
+ * @param active 	Whether each collider is active.
+ * @param count 	The number of colliders.
+ * @param hits 		Filled with one bit per collider, as overlap_boxes does.
+ *
+ * @return The number of colliders that overlap the box.
+ *
+ * @designer
+ * @author
+ */
+__attribute__((noinline))
+static unsigned int overlap_scalar(const OverlapBox *box, const float *x, const float *y, const int *width, const int *height, const bool *active, unsigned int count, unsigned long long *hits) {
+	unsigned int found = 0;
+	unsigned int i;
+	bool hit;
+
+	memset(hits, 0, sizeof(unsigned long long) * ((count + 63) / 64));
+	for (i = 0; i < count; i++) {
+		if (!active[i]) {
+			continue;
+		}
+		if (box->reading == BOX_CENTRE) {
+			hit = x[i] - width[i] / 2 < box->right && x[i] + width[i] / 2 > box->left &&
+				y[i] - height[i] / 2 < box->bottom && y[i] + height[i] / 2 > box->top;
+		}
+		else {
+			hit = x[i] < box->right && x[i] + width[i] > box->left && y[i] < box->bottom && y[i] + height[i] > box->top;
+		}
+		if (hit) {
+			hits[i >> 6] |= 1ULL << (i & 63);
+			found++;
+		}
+	}
+	return found;
+}
+
+/**
+ * Gets a random number in a range.
+ *
+ * @param low 	The lowest value.
+ * @param high 	The highest value.
+ *
+ * @return The number.
+ *
+ * @designer
+ * @author
+ */
+static float random_between(float low, float high) {
+	return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+/**
+ * Gets the time in nanoseconds, for timing the runs.
+ *
+ * @return The time.
+ *
+ * @designer
+ * @author
+ */
+static double now_ns() {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/**
+ * Fills the colliders and boxes, checks the two tests agree and times them.
+ *
+ * @param argc 	The number of arguments.
+ * @param argv 	The number of colliders and the number of queries, both optional.
+ *
+ * @return 0 if the tests agree, 1 if they don't or the arguments are bad.
+ *
+ * @designer
+ * @author
+ */
+int main(int argc, char *argv[]) {
+	unsigned int count = argc > 1 ? (unsigned int)atoi(argv[1]) : BENCH_COLLIDERS;
+	unsigned int queries = argc > 2 ? (unsigned int)atoi(argv[2]) : BENCH_QUERIES;
+	unsigned int words, i, q, reading, mismatches = 0;
+	unsigned long long *hits, *expected, checksum;
+	float *x, *y;
+	int *width, *height;
+	bool *active;
+	OverlapBox boxes[BENCH_BOXES];
+	double start, simd_ns, scalar_ns;
+
+	if (count == 0 || queries == 0) {
+		fprintf(stderr, "usage: %s [colliders] [queries]\n", argv[0]);
+		return 1;
+	}
+
+	words = (count + 63) / 64;
+	x = (float*)malloc(sizeof(float) * count);
+	y = (float*)malloc(sizeof(float) * count);
+	width = (int*)malloc(sizeof(int) * count);
+	height = (int*)malloc(sizeof(int) * count);
+	active = (bool*)malloc(sizeof(bool) * count);
+	hits = (unsigned long long*)malloc(sizeof(unsigned long long) * words);
+	expected = (unsigned long long*)malloc(sizeof(unsigned long long) * words);
+	if (!x || !y || !width || !height || !active || !hits || !expected) {
+		fprintf(stderr, "overlap_bench: out of memory\n");
+		return 1;
+	}
+
+	srand(1);
+	for (i = 0; i < count; i++) {
+		x[i] = random_between(0, BENCH_AREA);
+		y[i] = random_between(0, BENCH_AREA);
+		width[i] = rand() % 64 + 1;
+		height[i] = rand() % 64 + 1;
+		active[i] = rand() % 8 != 0;
+	}
+	for (i = 0; i < BENCH_BOXES; i++) {
+		boxes[i].left = random_between(0, BENCH_AREA);
+		boxes[i].top = random_between(0, BENCH_AREA);
+		boxes[i].right = boxes[i].left + random_between(16, 256);
+		boxes[i].bottom = boxes[i].top + random_between(16, 256);
+	}
+
+	for (reading = BOX_CENTRE; reading <= BOX_CORNER; reading++) {
+		for (i = 0; i < BENCH_BOXES; i++) {
+			boxes[i].reading = reading;
+			overlap_boxes(&boxes[i], x, y, width, height, active, count, hits);
+			overlap_scalar(&boxes[i], x, y, width, height, active, count, expected);
+			if (memcmp(hits, expected, sizeof(unsigned long long) * words) != 0) {
+				mismatches++;
+			}
+		}
+
+		//the hit counts are summed so neither loop can be thrown away
+		checksum = 0;
+		start = now_ns();
+		for (q = 0; q < queries; q++) {
+			checksum += overlap_boxes(&boxes[q % BENCH_BOXES], x, y, width, height, active, count, hits);
+		}
+		simd_ns = (now_ns() - start) / queries;
+
+		start = now_ns();
+		for (q = 0; q < queries; q++) {
+			checksum -= overlap_scalar(&boxes[q % BENCH_BOXES], x, y, width, height, active, count, expected);
+		}
+		scalar_ns = (now_ns() - start) / queries;
+
+		printf("%s: %u colliders, overlap_boxes %.1f ns, scalar %.1f ns, %.2fx%s\n",
+			reading == BOX_CENTRE ? "centre" : "corner", count, simd_ns, scalar_ns, scalar_ns / simd_ns,
+			checksum == 0 ? "" : " (hit counts differ)");
+		if (checksum != 0) {
+			mismatches++;
+		}
+	}
+
+	printf("%u mismatches\n", mismatches);
+
+	free(x);
+	free(y);
+	free(width);
+	free(height);
+	free(active);
+	free(hits);
+	free(expected);
+	return mismatches != 0;
+}
@@ -7,7 +7,7 @@
 #include "Graphics/systems.h"
 #include "Input/systems.h"
 
-#include "Network/PipeUtils.h"
+#include "Network/PacketRing.h"
 #include "Network/GameplayCommunication.h"
 #include "Network/SendSystem.h"
 #include "Network/Packets.h"
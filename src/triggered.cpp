@@ -10,6 +10,7 @@
 #include "Graphics/text.h"
 #include "Network/Packets.h"
 #include "Graphics/map.h"
+#include "view.h"
 
 #define DEBUG_SKINS     1 //1 = on, 0 = off
 #define ALT_SKIN_CHANCE 3 //chance to roll an alternate skin
@@ -17,9 +18,9 @@
 extern bool running;
 extern SDL_Surface *map_surface;
 extern unsigned int player_entity;
-extern int send_router_fd[];
-extern int rcv_router_fd[];
-extern int game_net_signalfd;
+extern EntityHandle player_handle;
+extern PacketRing *send_router_ring;
+extern PacketInbox *rcv_router_inbox;
 static int character;
 static char username[MAX_NAME];
 static char serverip[MAXIP];
@@ -141,28 +142,27 @@ bool menu_click(World *world, unsigned int entity) {
 
 		FILE * keymapFile = fopen("assets/Input/keymap.txt", "w+");
 
-		for(int i = 0; i < MAX_ENTITIES; i++) {
+		View<TextFieldComponent> text_fields(world);
+		for (unsigned int n = 0; n < text_fields.size(); n++) {
 			
-			if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_TEXTFIELD)) {
-								
+			TextFieldComponent *field = &text_fields.get<TextFieldComponent>(text_fields[n]);
 
-				if (strcmp(world->text[i].name, "keymap_up") == 0) {
-					fprintf(keymapFile, "C_UP %s\n", world->text[i].text);
-				}
-				else if (strcmp(world->text[i].name, "keymap_down") == 0) {
-					fprintf(keymapFile, "C_DOWN %s\n", world->text[i].text);
-				}
-				else if (strcmp(world->text[i].name, "keymap_left") == 0) {
-					fprintf(keymapFile, "C_LEFT %s\n", world->text[i].text);
-				}
-				else if (strcmp(world->text[i].name, "keymap_right") == 0) {
-					fprintf(keymapFile, "C_RIGHT %s\n", world->text[i].text);
-				}
-				else if (strcmp(world->text[i].name, "keymap_action") == 0) {
-					fprintf(keymapFile, "C_ACTION %s\n", world->text[i].text);
-				}
-				
+			if (strcmp(field->name, "keymap_up") == 0) {
+				fprintf(keymapFile, "C_UP %s\n", field->text);
+			}
+			else if (strcmp(field->name, "keymap_down") == 0) {
+				fprintf(keymapFile, "C_DOWN %s\n", field->text);
+			}
+			else if (strcmp(field->name, "keymap_left") == 0) {
+				fprintf(keymapFile, "C_LEFT %s\n", field->text);
+			}
+			else if (strcmp(field->name, "keymap_right") == 0) {
+				fprintf(keymapFile, "C_RIGHT %s\n", field->text);
 			}
+			else if (strcmp(field->name, "keymap_action") == 0) {
+				fprintf(keymapFile, "C_ACTION %s\n", field->text);
+			}
+			
 		}
 		fclose(keymapFile);
 		
@@ -172,26 +172,25 @@ bool menu_click(World *world, unsigned int entity) {
 
 		FILE * keymapFile = fopen("assets/Input/keymap.txt", "w+");
 
-		for(int i = 0; i < MAX_ENTITIES; i++) {
+		View<TextFieldComponent> text_fields(world);
+		for (unsigned int n = 0; n < text_fields.size(); n++) {
 			
-			if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_TEXTFIELD)) {
-							
+			TextFieldComponent *field = &text_fields.get<TextFieldComponent>(text_fields[n]);
 
-				if (strcmp(world->text[i].name, "keymap_up") == 0) {
-					fprintf(keymapFile, "C_UP W\n");
-				}
-				else if (strcmp(world->text[i].name, "keymap_down") == 0) {
-					fprintf(keymapFile, "C_DOWN S\n");
-				}
-				else if (strcmp(world->text[i].name, "keymap_left") == 0) {
-					fprintf(keymapFile, "C_LEFT A\n");
-				}
-				else if (strcmp(world->text[i].name, "keymap_right") == 0) {
-					fprintf(keymapFile, "C_RIGHT D\n");
-				}
-				else if (strcmp(world->text[i].name, "keymap_action") == 0) {
-					fprintf(keymapFile, "C_ACTION SPACE\n");
-				}
+			if (strcmp(field->name, "keymap_up") == 0) {
+				fprintf(keymapFile, "C_UP W\n");
+			}
+			else if (strcmp(field->name, "keymap_down") == 0) {
+				fprintf(keymapFile, "C_DOWN S\n");
+			}
+			else if (strcmp(field->name, "keymap_left") == 0) {
+				fprintf(keymapFile, "C_LEFT A\n");
+			}
+			else if (strcmp(field->name, "keymap_right") == 0) {
+				fprintf(keymapFile, "C_RIGHT D\n");
+			}
+			else if (strcmp(field->name, "keymap_action") == 0) {
+				fprintf(keymapFile, "C_ACTION SPACE\n");
 			}
 		}
 		fclose(keymapFile);
@@ -912,7 +911,7 @@ bool menu_click(World *world, unsigned int entity) {
 	}
 	else if (strcmp(world->button[entity].label, "setup_play") == 0) {
 
-		unsigned int i;
+		unsigned int n;
 
 		stop_music();
 		
@@ -922,18 +921,18 @@ bool menu_click(World *world, unsigned int entity) {
 		}
 		stop_all_effects();
 
-		for(i = 0; i < MAX_ENTITIES; i++) {
+		View<TextFieldComponent> text_fields(world);
+		for(n = 0; n < text_fields.size(); n++) {
 
-			if (IN_THIS_COMPONENT(world->mask[i], COMPONENT_TEXTFIELD)) {
-
-				if (strcmp(world->text[i].name, "setup_username") == 0) {
-					memcpy(username, world->text[i].text, MAX_NAME);
-				}
-				else if (strcmp(world->text[i].name, "setup_serverip") == 0) {
-					memcpy(serverip, world->text[i].text, MAXIP);
-				}
+			TextFieldComponent *field = &text_fields.get<TextFieldComponent>(text_fields[n]);
 
+			if (strcmp(field->name, "setup_username") == 0) {
+				memcpy(username, field->text, MAX_NAME);
 			}
+			else if (strcmp(field->name, "setup_serverip") == 0) {
+				memcpy(serverip, field->text, MAXIP);
+			}
+
 		}
 
 		//printf("Username: %s\n", username);
@@ -1016,16 +1015,18 @@ bool menu_click(World *world, unsigned int entity) {
 		
 		destroy_menu(world);
 		
-		world->mask[player_entity] ^= COMPONENT_COMMAND;
+		enable_component(world, player_entity, COMPONENT_COMMAND);
 		
 	}
 	else if (strcmp(world->button[entity].label, "ingame_exit") == 0) {
 		
-		uint32_t err = NUM_PACKETS + 1;
-        write_pipe(send_router_fd[WRITE], &err, sizeof(err));
+		if (ring_reserve(send_router_ring)) {
+			ring_commit(send_router_ring, NUM_PACKETS + 1, 0); //tells the network router to shut down
+		}
         reset_fog_of_war(fow);
 		destroy_world(world);
 		player_entity = MAX_ENTITIES;
+		player_handle = INVALID_HANDLE;
 		map_surface = 0;
 		cleanup_map();
 		create_main_menu(world);
@@ -1057,15 +1058,19 @@ void animation_end(World *world, unsigned int entity) {
 
 		map_init(world, "assets/Graphics/map/map_00/map00.txt", "assets/Graphics/map/map_00/tiles.txt");
 		player_entity = create_player(world, 620, 420, true, COLLISION_HACKER, 0, &pkt);
+		if (player_entity == MAX_ENTITIES) {
+			printf("Error creating the player!\n");
+			return;
+		}
+		player_handle = entity_handle(world, player_entity);
 		setup_character_animation(world, character, player_entity);
 		////NETWORK CODE
-		game_net_signalfd 	= eventfd(0, EFD_SEMAPHORE);
 
 
 
-		init_client_network(send_router_fd, rcv_router_fd, serverip);
+		init_client_network(&send_router_ring, &rcv_router_inbox, serverip);
 		init_client_update(world);
-		send_intialization(world, send_router_fd[WRITE], username);
+		send_intialization(world, send_router_ring, username);
 		create_objective(world, 620, 380, 40, 40, 0, 0);
 	}
 	//LOADING SCREEN ENDED
@@ -1112,20 +1117,28 @@ void cutscene_end(World *world, unsigned int entity) {
 
 		map_init(world, "assets/Graphics/map/map_00/map00.txt", "assets/Graphics/map/map_00/tiles.txt");
 		player_entity = create_player(world, 620, 420, true, COLLISION_HACKER, 0, &pkt);
+		if (player_entity == MAX_ENTITIES) {
+			printf("Error creating the player!\n");
+			return;
+		}
+		player_handle = entity_handle(world, player_entity);
 		setup_character_animation(world, character, player_entity);
 		////NETWORK CODE
-		game_net_signalfd 	= eventfd(0, EFD_SEMAPHORE);
 
 
 
-		init_client_network(send_router_fd, rcv_router_fd, serverip);
+		init_client_network(&send_router_ring, &rcv_router_inbox, serverip);
 		init_client_update(world);
-		send_intialization(world, send_router_fd[WRITE], username);
+		send_intialization(world, send_router_ring, username);
 		
 	}
 	else if (cutscene->id == CUTSCENE_VAN_INTRO) {
 		
-		unsigned int e = create_entity(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION);
+		unsigned int e = create_ui_entity(world, COMPONENT_RENDER_PLAYER | COMPONENT_POSITION | COMPONENT_ANIMATION);
+		
+		if (e == MAX_ENTITIES) {
+			return;
+		}
 		
 		world->position[e].x = 0;
 		world->position[e].y = 0;
@@ -0,0 +1,194 @@
+/**
+ * Typed queries over the world's components.
+ *
+ * A system names the components it works on as types, and the mask is built from
+ * them at compile time:
+ *
+ *     View<PositionComponent, MovementComponent> movers(world);
+ *     for(i = 0; i < movers.size(); i++) {
+ *         entity = movers[i];
+ *         movers.get<PositionComponent>(entity).x += movers.get<MovementComponent>(entity).movX;
+ *     }
+ *
+ * Each view type keeps its matching entities, in entity order, between frames and
+ * only looks at the sets again once an entity has joined or left one of them. A view
+ * built while another of the same type is still alive, such as one in a function
+ * called from a loop over the first, gets a list of its own built from scratch, so
+ * the first one's list isn't changed under it.
+ *
+ * The list is a snapshot. A system that adds or removes components, or destroys
+ * entities, while walking it must check has() before touching an entity, unless it
+ * queues the change with defer_destroy and friends for the sync point.
+ *
+ * @file view.h
+ */
+#ifndef VIEW_H
+#define VIEW_H
+
+#include "world.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//Stands in for components that are only a flag in the mask and have no data.
+struct MenuItemTag {};
+
+/**
+ * Ties a component type to its bit in the mask and its array in the world.
+ */
+template <typename T>
+struct ComponentInfo;
+
+#define COMPONENT_INFO(type, bit, member) \
+	template <> struct ComponentInfo<type> { \
+		static const ComponentMask mask = bit; \
+		static ComponentPages<type> &pages(World *world) { return world->member; } \
+	}
+
+COMPONENT_INFO(MouseComponent,			COMPONENT_MOUSE,			mouse);
+COMPONENT_INFO(TextFieldComponent,		COMPONENT_TEXTFIELD,		text);
+COMPONENT_INFO(ButtonComponent,			COMPONENT_BUTTON,			button);
+COMPONENT_INFO(CommandComponent,		COMPONENT_COMMAND,			command);
+COMPONENT_INFO(PositionComponent,		COMPONENT_POSITION,			position);
+COMPONENT_INFO(LevelComponent,			COMPONENT_LEVEL,			level);
+COMPONENT_INFO(CollisionComponent,		COMPONENT_COLLISION,		collision);
+COMPONENT_INFO(MovementComponent,		COMPONENT_MOVEMENT,			movement);
+COMPONENT_INFO(ControllableComponent,	COMPONENT_CONTROLLABLE,		controllable);
+COMPONENT_INFO(RenderPlayerComponent,	COMPONENT_RENDER_PLAYER,	renderPlayer);
+COMPONENT_INFO(PlayerComponent,			COMPONENT_PLAYER,			player);
+COMPONENT_INFO(TagComponent,			COMPONENT_TAG,				tag);
+COMPONENT_INFO(AnimationComponent,		COMPONENT_ANIMATION,		animation);
+COMPONENT_INFO(WormholeComponent,		COMPONENT_WORMHOLE,			wormhole);
+COMPONENT_INFO(ObjectiveComponent,		COMPONENT_OBJECTIVE,		objective);
+COMPONENT_INFO(TileComponent,			COMPONENT_STILE,			tile);
+COMPONENT_INFO(PowerUpComponent,		COMPONENT_POWERUP,			powerup);
+COMPONENT_INFO(CutsceneComponent,		COMPONENT_CUTSCENE,			cutscene);
+
+template <>
+struct ComponentInfo<MenuItemTag> {
+	static const ComponentMask mask = COMPONENT_MENU_ITEM;
+};
+
+#undef COMPONENT_INFO
+
+/**
+ * The mask of a list of component types.
+ */
+template <typename... Ts>
+struct MaskOf;
+
+template <>
+struct MaskOf<> {
+	static const ComponentMask value = COMPONENT_EMPTY;
+};
+
+template <typename T, typename... Ts>
+struct MaskOf<T, Ts...> {
+	static const ComponentMask value = ComponentInfo<T>::mask | MaskOf<Ts...>::value;
+};
+
+/**
+ * The entities that have every one of the components Ts.
+ */
+template <typename... Ts>
+class View {
+public:
+	static const ComponentMask mask = MaskOf<Ts...>::value;
+
+	explicit View(World *world) : world(world), cache(take_list()) {
+		refresh_view(world, mask, cache);
+	}
+
+	View(const View &other) : world(other.world), cache(take_list()) {
+		refresh_view(world, mask, cache);
+	}
+
+	~View() {
+		give_back(cache);
+	}
+
+	//number of entities in the view
+	unsigned int size() const {
+		return cache->count;
+	}
+
+	//the i'th entity in the view, in entity order
+	unsigned int operator[](unsigned int i) const {
+		return cache->entities[i];
+	}
+
+	//whether the entity is still in the world and still has every component in the view
+	bool has(unsigned int entity) const {
+		return entity < world->capacity && IN_THIS_COMPONENT(world->mask[entity], mask);
+	}
+
+	//the entity's component of type T
+	template <typename T>
+	T &get(unsigned int entity) const {
+		static_assert((mask & ComponentInfo<T>::mask) == ComponentInfo<T>::mask, "the view does not have this component");
+		return ComponentInfo<T>::pages(world)[entity];
+	}
+
+	//the whole array of components of type T
+	template <typename T>
+	ComponentPages<T> &pages() const {
+		static_assert((mask & ComponentInfo<T>::mask) == ComponentInfo<T>::mask, "the view does not have this component");
+		return ComponentInfo<T>::pages(world);
+	}
+
+private:
+	World		*world;
+	ViewCache	*cache;
+
+	View &operator=(const View &);
+
+	//one list per view type, kept for the life of the program
+	static ViewCache *shared_list() {
+		static ViewCache cache;
+		return &cache;
+	}
+
+	//the number of live views using the shared list
+	static unsigned int &shared_users() {
+		static unsigned int users = 0;
+		return users;
+	}
+
+	//the shared list if no other view of this type has it, or else a list of the view's own
+	static ViewCache *take_list() {
+		ViewCache *own;
+
+		if (shared_users() > 0) {
+			if ((own = (ViewCache*)calloc(1, sizeof(ViewCache))) != NULL) {
+				return own;
+			}
+			perror("View: calloc");
+		}
+		shared_users()++;
+		return shared_list();
+	}
+
+	static void give_back(ViewCache *list) {
+		if (list == shared_list()) {
+			shared_users()--;
+		}
+		else {
+			free(list->entities);
+			free(list);
+		}
+	}
+};
+
+/**
+ * Builds a view over the world.
+ *
+ * @param world The world struct containing all entities.
+ *
+ * @return The entities that have every one of the components Ts.
+ */
+template <typename... Ts>
+View<Ts...> view(World *world) {
+	return View<Ts...>(world);
+}
+
+#endif
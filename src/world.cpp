@@ -5,7 +5,10 @@
  */
 
 #include "world.h"
+#include "view.h"
 #include "Gameplay/powerups.h"
+#include "Gameplay/level.h"
+#include "Graphics/map.h"
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_keycode.h>
@@ -13,27 +16,415 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define BODY_CELL_SIZE TILE_WIDTH	//the collider grid has a cell per map tile
+#define BODY_COMPONENTS (COMPONENT_COLLISION | COMPONENT_POSITION | COMPONENT_STATIC)	//the sets the body store is built from
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define MATCH_SSE2
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define MATCH_AVX2
+#endif
+#endif
 
 extern unsigned int background;	//this is here because we need to keep the background loaded while in the menu.
 									//this needs to be cleaned up when the destroy_world function is called.
 /**
- * This function initializes every mask to be 0, so that there are no components.
+ * This function empties the world. No pages are allocated until the first entity
+ * is created.
  * 
- * @param world The world struct containing the entity masks to be zeroed.
+ * @param world The world struct to initialize.
  *
  * @designer
  * @author 
  */
 void init_world(World* world) {
 	int i;
-	for(i = 0; i < MAX_ENTITIES; ++i) {
-		world->mask[i] = COMPONENT_EMPTY;
+	
+	memset(world, 0, sizeof(World));
+	for(i = 0; i < MAX_LEVELS; i++) {
+		world->levels[i] = MAX_ENTITIES;
+	}
+}
+
+/**
+ * Allocates one page of a component array.
+ *
+ * @param components 	The component array.
+ * @param page 			The page to allocate.
+ *
+ * @return true if the page was allocated.
+ *
+ * @designer
+ * @author
+ */
+template <typename T>
+static bool alloc_component_page(ComponentPages<T> &components, unsigned int page) {
+	if (components.pages[page] == NULL) {
+		components.pages[page] = (T*)calloc(ENTITY_PAGE_SIZE, sizeof(T));
+	}
+	return components.pages[page] != NULL;
+}
+
+/**
+ * Frees one page of a component array.
+ *
+ * @param components 	The component array.
+ * @param page 			The page to free.
+ *
+ * @designer
+ * @author
+ */
+template <typename T>
+static void free_component_page(ComponentPages<T> &components, unsigned int page) {
+	free(components.pages[page]);
+	components.pages[page] = NULL;
+}
+
+/**
+ * Frees the component storage of a page. The generation page is kept so that handles
+ * into the page stay stale if it is allocated again.
+ *
+ * @param world The world struct containing all entities.
+ * @param page 	The page to free.
+ *
+ * @designer
+ * @author
+ */
+static void release_page(World *world, unsigned int page) {
+	int i;
+	
+	free_component_page(world->mask, page);
+	free_component_page(world->position, page);
+	free_component_page(world->command, page);
+	free_component_page(world->movement, page);
+	free_component_page(world->collision, page);
+	free_component_page(world->controllable, page);
+	free_component_page(world->level, page);
+	free_component_page(world->mouse, page);
+	free_component_page(world->text, page);
+	free_component_page(world->button, page);
+	free_component_page(world->renderPlayer, page);
+	free_component_page(world->player, page);
+	free_component_page(world->tag, page);
+	free_component_page(world->animation, page);
+	free_component_page(world->wormhole, page);
+	free_component_page(world->objective, page);
+	free_component_page(world->tile, page);
+	free_component_page(world->cutscene, page);
+	free_component_page(world->powerup, page);
+	
+	for(i = 0; i < NUM_COMPONENTS; i++) {
+		free_component_page(world->sets[i].index, page);
+	}
+	
+	world->free_slots[page] = 0;
+	world->free_pages &= ~(1ULL << page);
+	world->ui_pages &= ~(1ULL << page);
+}
+
+/**
+ * Allocates the storage for a set of components on one page. Storage that is already
+ * there is kept.
+ *
+ * @param world 		The world struct containing all entities.
+ * @param page 			The page to allocate on.
+ * @param components 	The components that need storage.
+ *
+ * @return true if every component has storage on the page.
+ *
+ * @designer
+ * @author
+ */
+static bool alloc_components(World *world, unsigned int page, ComponentMask components) {
+	bool ok = true;
+	
+	if (components & COMPONENT_POSITION)		ok = ok && alloc_component_page(world->position, page);
+	if (components & COMPONENT_COMMAND)			ok = ok && alloc_component_page(world->command, page);
+	if (components & COMPONENT_MOVEMENT)		ok = ok && alloc_component_page(world->movement, page);
+	if (components & COMPONENT_COLLISION)		ok = ok && alloc_component_page(world->collision, page);
+	if (components & COMPONENT_CONTROLLABLE)	ok = ok && alloc_component_page(world->controllable, page);
+	if (components & COMPONENT_LEVEL)			ok = ok && alloc_component_page(world->level, page);
+	if (components & COMPONENT_MOUSE)			ok = ok && alloc_component_page(world->mouse, page);
+	if (components & COMPONENT_TEXTFIELD)		ok = ok && alloc_component_page(world->text, page);
+	if (components & COMPONENT_BUTTON)			ok = ok && alloc_component_page(world->button, page);
+	if (components & COMPONENT_RENDER_PLAYER)	ok = ok && alloc_component_page(world->renderPlayer, page);
+	if (components & COMPONENT_PLAYER)			ok = ok && alloc_component_page(world->player, page);
+	if (components & COMPONENT_TAG)				ok = ok && alloc_component_page(world->tag, page);
+	if (components & COMPONENT_ANIMATION)		ok = ok && alloc_component_page(world->animation, page);
+	if (components & COMPONENT_WORMHOLE)		ok = ok && alloc_component_page(world->wormhole, page);
+	if (components & COMPONENT_OBJECTIVE)		ok = ok && alloc_component_page(world->objective, page);
+	if (components & COMPONENT_STILE)			ok = ok && alloc_component_page(world->tile, page);
+	if (components & COMPONENT_CUTSCENE)		ok = ok && alloc_component_page(world->cutscene, page);
+	if (components & COMPONENT_POWERUP)			ok = ok && alloc_component_page(world->powerup, page);
+	
+	return ok;
+}
+
+/**
+ * Gets the components a page gives storage to up front, for UI pages or gameplay pages.
+ *
+ * @param ui Whether the page holds menu and cutscene entities.
+ *
+ * @return The components to allocate.
+ *
+ * @designer
+ * @author
+ */
+static ComponentMask page_components(bool ui) {
+	return ui ? (UI_COMPONENTS | SHARED_COMPONENTS) : ~(ComponentMask)UI_COMPONENTS;
+}
+
+/**
+ * Resizes the dense list of every component set. Each list can hold one entry per
+ * entity slot, so adding to a set never has to allocate.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param slots 	The number of entity slots the lists must hold.
+ *
+ * @return true if every list was resized.
+ *
+ * @designer
+ * @author
+ */
+static bool resize_sets(World *world, unsigned int slots) {
+	unsigned int *dense;
+	int i;
+	
+	for(i = 0; i < NUM_COMPONENTS; i++) {
+		dense = (unsigned int*)realloc(world->sets[i].dense, sizeof(unsigned int) * (slots > 0 ? slots : 1));
+		if (dense == NULL) {
+			return false;
+		}
+		world->sets[i].dense = dense;
+	}
+	return true;
+}
+
+/**
+ * Grows the world by one page of entity slots.
+ *
+ * @param world The world struct containing all entities.
+ * @param ui 	Whether the page is for menu and cutscene entities.
+ *
+ * @return true if the world grew, or false if it is at MAX_ENTITIES or out of memory.
+ *
+ * @designer
+ * @author
+ */
+static bool add_page(World *world, bool ui) {
+	unsigned int page = world->num_pages;
+	bool ok = true;
+	int i;
+	
+	if (page >= MAX_ENTITY_PAGES) {
+		return false;
+	}
+	
+	ok = ok && alloc_component_page(world->mask, page);
+	ok = ok && alloc_component_page(world->generation, page);
+	ok = ok && alloc_components(world, page, page_components(ui));
+	
+	for(i = 0; i < NUM_COMPONENTS; i++) {
+		ok = ok && alloc_component_page(world->sets[i].index, page);
+	}
+	ok = ok && resize_sets(world, (page + 1) * ENTITY_PAGE_SIZE);
+	
+	if (!ok) {
+		perror("add_page: calloc");
+		release_page(world, page);
+		return false;
+	}
+	
+	world->free_slots[page] = ~0ULL;
+	world->free_pages |= 1ULL << page;
+	if (ui) {
+		world->ui_pages |= 1ULL << page;
+	}
+	world->num_pages++;
+	world->capacity = world->num_pages * ENTITY_PAGE_SIZE;
+	return true;
+}
+
+/**
+ * Frees the pages at the end of the world that no longer hold any entities, so
+ * memory follows the live entity count back down.
+ *
+ * @param world The world struct containing all entities.
+ *
+ * @designer
+ * @author
+ */
+static void release_empty_pages(World *world) {
+	while (world->num_pages > 0 && world->free_slots[world->num_pages - 1] == ~0ULL) {
+		world->num_pages--;
+		release_page(world, world->num_pages);
+	}
+	world->capacity = world->num_pages * ENTITY_PAGE_SIZE;
+	
+	//shrinking can't fail to find memory; if it does the old lists are still good
+	resize_sets(world, world->capacity);
+}
+
+/**
+ * Frees every page of the world, including the generation pages. The world needs
+ * init_world before it is used again.
+ *
+ * @param world The world struct to clean up.
+ *
+ * @designer
+ * @author
+ */
+void cleanup_world(World *world) {
+	unsigned int page;
+	int i;
+	
+	destroy_world(world);
+	for(page = 0; page < MAX_ENTITY_PAGES; page++) {
+		release_page(world, page);
+		free_component_page(world->generation, page);
+	}
+	for(i = 0; i < NUM_COMPONENTS; i++) {
+		free(world->sets[i].dense);
+		world->sets[i].dense = NULL;
+	}
+	world->num_pages = 0;
+	world->capacity = 0;
+	
+	free(world->bodies.entity);
+	free(world->bodies.grid.entries);
+	memset(&world->bodies, 0, sizeof(BodyStore));
+	free(world->batch.hits);
+	memset(&world->batch, 0, sizeof(BodyBatch));
+	free(world->integrator.entity);
+	memset(&world->integrator, 0, sizeof(MoverBatch));
+	
+	free(world->commands.commands);
+	memset(&world->commands, 0, sizeof(CommandBuffer));
+	
+	arena_free(&world->floor_arena);
+}
+
+/**
+ * Checks whether an entity slot is on the free list.
+ *
+ * @param world  The world struct containing all entities.
+ * @param entity The entity slot to check. Must be below the world's capacity.
+ *
+ * @return true if nothing is using the slot.
+ *
+ * @designer
+ * @author
+ */
+static bool entity_slot_free(World *world, unsigned int entity) {
+	return (world->free_slots[entity >> ENTITY_PAGE_SHIFT] >> (entity & ENTITY_PAGE_MASK)) & 1;
+}
+
+/**
+ * Takes the lowest free slot of the right kind of page off the free bitmap. If every
+ * page of that kind is full, an empty page of the other kind is taken over, and if
+ * there is none the world grows by a page.
+ *
+ * The lowest slot is handed out so that entities are still created in the same order
+ * the old linear scan produced; the render systems draw in entity order.
+ *
+ * @param world The world struct containing all entities.
+ * @param ui 	Whether the entity is a menu or cutscene entity.
+ *
+ * @return The entity number, or MAX_ENTITIES if the world cannot grow any further.
+ *
+ * @designer
+ * @author
+ */
+static unsigned int alloc_entity_slot(World *world, bool ui) {
+	unsigned long long candidates = world->free_pages & (ui ? world->ui_pages : ~world->ui_pages);
+	unsigned int page;
+	unsigned int bit;
+	
+	if (candidates == 0) {
+		for(page = 0; page < world->num_pages; page++) {
+			if (world->free_slots[page] == ~0ULL && alloc_components(world, page, page_components(ui))) {
+				break;
+			}
+		}
+		
+		if (page < world->num_pages) {
+			if (ui) {
+				world->ui_pages |= 1ULL << page;
+			}
+			else {
+				world->ui_pages &= ~(1ULL << page);
+			}
+		}
+		else if (!add_page(world, ui)) {
+			return MAX_ENTITIES;
+		}
+		candidates = 1ULL << page;
+	}
+	
+	page = __builtin_ctzll(candidates);
+	bit = __builtin_ctzll(world->free_slots[page]);
+	
+	world->free_slots[page] &= ~(1ULL << bit);
+	if (world->free_slots[page] == 0) {
+		world->free_pages &= ~(1ULL << page);
+	}
+	
+	return (page << ENTITY_PAGE_SHIFT) + bit;
+}
+
+/**
+ * Takes a slot of the right kind and gives it its components.
+ *
+ * @param world 		The world struct containing all entities.
+ * @param attributes 	The component mask to apply to the entity.
+ * @param ui 			Whether the entity goes on the UI pages.
+ *
+ * @return 	The entity number, or MAX_ENTITIES if all of the entities are in use or
+ *			its components couldn't be allocated.
+ *
+ * @designer
+ * @author
+ */
+static unsigned int create_entity_on(World* world, ComponentMask attributes, bool ui) {
+	unsigned int entity = alloc_entity_slot(world, ui);
+	
+	if (entity == MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
+	world->mask[entity] = COMPONENT_EMPTY;
+	if (!enable_component(world, entity, attributes)) {
+		destroy_entity(world, entity);
+		return MAX_ENTITIES;
 	}
+	return entity;
+}
+
+/**
+ * This function takes the first unused entity off the free slot bitmap in constant time.
+ * Menu items and cutscenes are put on the UI pages, everything else on the gameplay pages.
+ *
+ * @param world 		The world struct containing all entities.
+ * @param attributes 	The component mask to apply to the entity.
+ *
+ * @return 	The entity number if there was an entity available, or MAX_ENTITIES if all
+ *			of the entities are in use or its components couldn't be allocated.
+ *
+ * @designer
+ * @author
+ */
+unsigned int create_entity(World* world, ComponentMask attributes) {
+	return create_entity_on(world, attributes, (attributes & UI_ENTITY_COMPONENTS) != 0);
 }
 
 /**
- * This function loops through the masks of all the entities and finds the first one
- * that is not used.
+ * Creates an entity on the UI pages even though it is not a menu item or cutscene, for
+ * the props a cutscene puts on screen with it. Entities are drawn in entity order, so
+ * props have to be on the same pages as the cutscene to layer with it.
  *
  * @param world 		The world struct containing all entities.
  * @param attributes 	The component mask to apply to the entity.
@@ -44,54 +435,123 @@ void init_world(World* world) {
  * @designer
  * @author
  */
-unsigned int create_entity(World* world, unsigned int attributes) {
-	unsigned int entity;
-	for(entity = 0; entity < MAX_ENTITIES; entity++) {
-		if (world->mask[entity] == COMPONENT_EMPTY) {
-			world->mask[entity] = attributes;
-			return entity;
-		}
+unsigned int create_ui_entity(World* world, ComponentMask attributes) {
+	return create_entity_on(world, attributes, true);
+}
+
+/**
+ * Creates a handle for an entity that can be held across frames.
+ *
+ * The handle stops resolving once the entity is destroyed, even if its slot is
+ * handed out again.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param entity 	The entity to get a handle for.
+ *
+ * @return The handle, or INVALID_HANDLE if the entity is not in use.
+ *
+ * @designer
+ * @author
+ */
+EntityHandle entity_handle(World *world, unsigned int entity) {
+	if (entity >= world->capacity || entity_slot_free(world, entity)) {
+		return INVALID_HANDLE;
 	}
-	return MAX_ENTITIES;
+	return (world->generation[entity] << ENTITY_INDEX_BITS) | entity;
 }
 
 /**
- * [Brief description (one sentence)]
+ * Resolves a handle back to the entity it was created for.
  *
- * [Detailed description (if necessary)]
+ * @param world 	The world struct containing all entities.
+ * @param handle 	A handle from entity_handle.
+ *
+ * @return The entity number, or MAX_ENTITIES if the entity has since been destroyed.
+ *
+ * @designer
+ * @author
+ */
+unsigned int entity_from_handle(World *world, EntityHandle handle) {
+	unsigned int entity = handle & ENTITY_INDEX_MASK;
+	
+	if (handle == INVALID_HANDLE || entity >= world->capacity || entity_slot_free(world, entity)) {
+		return MAX_ENTITIES;
+	}
+	if (world->generation[entity] != (handle >> ENTITY_INDEX_BITS)) {
+		return MAX_ENTITIES;
+	}
+	return entity;
+}
+
+/**
+ * Creates the level of a floor and puts it in the level registry.
+ *
+ * The tiles and the wall bitmap are copied into one allocation from the floor arena.
  *
  * @param world
- * @param map
+ * @param map		The collision type of each tile, row by row.
  * @param width
  * @param height
  * @param tileSize
+ * @param floor		The floor ID.
  *
- * @return
+ * @return The level entity, or MAX_ENTITIES if it couldn't be made.
  *
  * @designer
  * @author
  */
-unsigned int create_level(World* world, int** map, int width, int height, int tileSize, int floor) {
+unsigned int create_level(World* world, const int* map, int width, int height, int tileSize, int floor) {
 	
 	unsigned int entity = 0;
-	int i = 0;
-	int n = 0;
+	LevelComponent *level;
+	int stride = (width + 63) / 64;
+	size_t tile_bytes = sizeof(int) * width * height;
+	int x, y;
+	
+	if (floor < 0 || floor >= MAX_LEVELS) {
+		printf("Floor %d is outside the level registry.\n", floor);
+		return MAX_ENTITIES;
+	}
 	
 	entity = create_entity(world, COMPONENT_LEVEL);
 	
-	world->level[entity].map = (int**)malloc(sizeof(int*) * width);
-	for (i = 0; i < width; i++) {
-		world->level[entity].map[i] = (int*)malloc(sizeof(int) * height);
-		for (n = 0; n < height; n++) {
-			
-			world->level[entity].map[i][n] = map[i][n];
-			
+	if (entity == MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
+	level = &(world->level[entity]);
+	
+	//the bitmap goes after the tiles, rounded up so its words are aligned
+	tile_bytes = (tile_bytes + sizeof(unsigned long long) - 1) & ~(sizeof(unsigned long long) - 1);
+	level->map = (int*)arena_alloc(&world->floor_arena, tile_bytes + sizeof(unsigned long long) * stride * height);
+	if (level->map == NULL) {
+		disable_component(world, entity, COMPONENT_LEVEL);
+		destroy_entity(world, entity);
+		return MAX_ENTITIES;
+	}
+	level->walls = (unsigned long long*)((char*)level->map + tile_bytes);
+	
+	memcpy(level->map, map, sizeof(int) * width * height);
+	memset(level->walls, 0, sizeof(unsigned long long) * stride * height);
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			if (map[y * width + x] == L_WALL) {
+				level->walls[y * stride + (x >> 6)] |= 1ULL << (x & 63);
+			}
 		}
 	}
-	world->level[entity].levelID = floor;
-	world->level[entity].width = width;
-	world->level[entity].height = height;
-	world->level[entity].tileSize = tileSize;
+	
+	level->wall_stride = stride;
+	level->static_start = NULL;
+	level->statics = NULL;
+	level->num_static = 0;
+	level->static_found = NULL;
+	level->static_types = NULL;
+	level->levelID = floor;
+	level->width = width;
+	level->height = height;
+	level->tileSize = tileSize;
+	world->levels[floor] = entity;
 	
 	return entity;
 }
@@ -141,11 +601,17 @@ unsigned int create_player(World* world, int x, int y, bool controllable, int co
 	movement.movX = 0;
 	movement.movY = 0;
 	movement.friction = 0.30;
+	movement.prevX = x;
+	movement.prevY = y;
+	movement.offsetX = 0;
+	movement.offsetY = 0;
 	
 	command.commands[C_UP] = false;
 	command.commands[C_DOWN] = false;
 	command.commands[C_LEFT] = false;
 	command.commands[C_RIGHT] = false;
+	command.commands[C_ACTION] = false;
+	command.commands[C_TILE] = false;
 	
 	control.active = true;
 
@@ -168,10 +634,8 @@ unsigned int create_player(World* world, int x, int y, bool controllable, int co
 	powerup.duration = 0;
 	powerup.type = PU_NONE;
 
-	for(entity = 0; entity < MAX_ENTITIES; ++entity) {
-		if (world->mask[entity] == COMPONENT_EMPTY) {
-			if (controllable) {
-				world->mask[entity] =	COMPONENT_POSITION | 
+	if (controllable) {
+		entity = create_entity(world,	COMPONENT_POSITION | 
 										COMPONENT_RENDER_PLAYER | 
 										COMPONENT_COMMAND | 
 										COMPONENT_MOVEMENT | 
@@ -179,31 +643,33 @@ unsigned int create_player(World* world, int x, int y, bool controllable, int co
 										COMPONENT_CONTROLLABLE |
 										COMPONENT_PLAYER |
 										COMPONENT_ANIMATION |
-										COMPONENT_POWERUP;
-			} else {
-				world->mask[entity] =	COMPONENT_POSITION | 
+										COMPONENT_POWERUP);
+	} else {
+		entity = create_entity(world,	COMPONENT_POSITION | 
 										COMPONENT_RENDER_PLAYER | 
 										COMPONENT_ANIMATION |
 										COMPONENT_COLLISION | 
 										COMPONENT_MOVEMENT |
 										COMPONENT_PLAYER |
-										COMPONENT_POWERUP;
-			}
-			world->position[entity] = pos;
-			world->renderPlayer[entity] = render;
-			world->command[entity] = command;
-			world->movement[entity] = movement;
-			world->collision[entity] = collision;
-			world->player[entity] = player;
-			world->powerup[entity] = powerup;
-
-			if (controllable) {
-				world->controllable[entity] = control;
-			}
-			return entity;
-		}
+										COMPONENT_POWERUP);
+	}
+	
+	if (entity == MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
+	world->position[entity] = pos;
+	world->renderPlayer[entity] = render;
+	world->command[entity] = command;
+	world->movement[entity] = movement;
+	world->collision[entity] = collision;
+	world->player[entity] = player;
+	world->powerup[entity] = powerup;
+
+	if (controllable) {
+		world->controllable[entity] = control;
 	}
-	return MAX_ENTITIES;
+	return entity;
 }
 
 //creates a target for the hackers
@@ -260,6 +726,10 @@ unsigned int create_stair(World* world, int targetLevel, int targetX, int target
 	
 	entity = create_entity(world, COMPONENT_POSITION | COMPONENT_COLLISION | COMPONENT_WORMHOLE);
 	
+	if (entity == MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
 	world->position[entity].x = x;
 	world->position[entity].y = y;
 	world->position[entity].width = width;
@@ -283,6 +753,10 @@ unsigned int create_stair(World* world, int targetLevel, int targetX, int target
 unsigned int create_block(World* world, int x, int y, int width, int height, int level) {
 	unsigned int entity = create_entity(world, COMPONENT_POSITION | COMPONENT_COLLISION);
 	
+	if (entity == MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
 	world->position[entity].x = x;
 	world->position[entity].y = y;
 	world->position[entity].width = width;
@@ -304,6 +778,10 @@ unsigned int create_powerup(World * world, float x, float y, int width, int heig
 	
 	entity = create_entity(world, COMPONENT_POSITION | COMPONENT_COLLISION);
 	
+	if (entity == MAX_ENTITIES) {
+		return MAX_ENTITIES;
+	}
+	
 	world->position[entity].x = x;
 	world->position[entity].y = y;
 	world->position[entity].width = width;
@@ -323,7 +801,8 @@ unsigned int create_powerup(World * world, float x, float y, int width, int heig
 /**
  * Clean up is easy.
  *
- * [Detailed description (if necessary)]
+ * Frees the entity's resources and returns its slot to the free list. Destroying
+ * an entity that is not in use does nothing.
  * 
  * TODO: free all memory on heap. Memory leaks suck.
  *
@@ -337,6 +816,10 @@ void destroy_entity(World* world, const unsigned int entity) {
 
 	int i, j;
 	
+	if (entity >= world->capacity || entity_slot_free(world, entity)) {
+		return;
+	}
+	
 	if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_ANIMATION)) {
 		
 		//printf("animation count: %d\n", world->animation[entity].animation_count);
@@ -344,9 +827,6 @@ void destroy_entity(World* world, const unsigned int entity) {
 		for(i = 0; i < world->animation[entity].animation_count; i++) {
 			//printf("-- count %s: %d\n", world->animation[entity].animations[i].name, world->animation[entity].animations[i].surface_count);
 			
-			free(world->animation[entity].animations[i].name);
-			
-			
 			for(j = 0; j < world->animation[entity].animations[i].surface_count; j++) {
 				
 				SDL_FreeSurface(world->animation[entity].animations[i].surfaces[j]);
@@ -355,9 +835,15 @@ void destroy_entity(World* world, const unsigned int entity) {
 				
 			}
 			
-			free(world->animation[entity].animations[i].surfaces);
+			//the floor's arrays go with the floor arena
+			if (!world->animation[entity].floor) {
+				free(world->animation[entity].animations[i].name);
+				free(world->animation[entity].animations[i].surfaces);
+			}
+		}
+		if (!world->animation[entity].floor) {
+			free(world->animation[entity].animations);
 		}
-		free(world->animation[entity].animations);
 		
 		//we have already free'd the surface so make sure it isn't free'd again.
 		world->renderPlayer[entity].playerSurface = NULL;
@@ -381,14 +867,18 @@ void destroy_entity(World* world, const unsigned int entity) {
 	}
 	if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_LEVEL)) {
 		
-		for (i = 0; i < world->level[entity].width; i++) {
-			free(world->level[entity].map[i]);
+		//the map belongs to the floor arena
+		if (world->levels[world->level[entity].levelID] == entity) {
+			world->levels[world->level[entity].levelID] = MAX_ENTITIES;
 		}
-		
-		free(world->level[entity].map);
 	}
 	
-	world->mask[entity] = COMPONENT_EMPTY;
+	disable_component(world, entity, world->mask[entity]);
+	
+	//put the slot back on the free list and invalidate any handles to it
+	world->generation[entity] = (world->generation[entity] + 1) & ENTITY_INDEX_MASK;
+	world->free_slots[entity >> ENTITY_PAGE_SHIFT] |= 1ULL << (entity & ENTITY_PAGE_MASK);
+	world->free_pages |= 1ULL << (entity >> ENTITY_PAGE_SHIFT);
 }
 
 /**
@@ -403,38 +893,1840 @@ void destroy_entity(World* world, const unsigned int entity) {
 void destroy_world(World *world) {
 	unsigned int entity;
 	
-	for(entity = 0; entity < MAX_ENTITIES; entity++) {
+	for(entity = 0; entity < world->capacity; entity++) {
 		destroy_entity(world, entity);
 	}
+	release_empty_pages(world);
+	arena_reset(&world->floor_arena);
 	background = MAX_ENTITIES + 1;
 }
 
 void destroy_world_not_player(World *world) {
+	unsigned long long doomed[MAX_ENTITY_PAGES];
+	unsigned long long bits;
+	unsigned int page;
+	
+	match_all(world, COMPONENT_EMPTY, COMPONENT_PLAYER | COMPONENT_STILE, doomed);
+	for(page = 0; page < world->num_pages; page++) {
+		for(bits = doomed[page]; bits != 0; bits &= bits - 1) {
+			destroy_entity(world, (page << ENTITY_PAGE_SHIFT) + __builtin_ctzll(bits));
+		}
+	}
+	release_empty_pages(world);
+	
+	//everything left is the players and their tiles, none of which come from the floor arena
+	arena_reset(&world->floor_arena);
+}
+
+
+
+
+/**
+ * Gets the set of entities that have a component.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param component A single component bit.
+ *
+ * @return The component's set.
+ *
+ * @designer
+ * @author
+ */
+ComponentSet *component_set(World *world, ComponentMask component) {
+	return &world->sets[__builtin_ctzll(component)];
+}
+
+/**
+ * Picks the smallest set out of the components in a mask. Every entity that has all
+ * of the components is in that set, so it is the cheapest one for a system to walk.
+ *
+ * @param world The world struct containing all entities.
+ * @param mask 	The components the system needs. Must not be COMPONENT_EMPTY.
+ *
+ * @return The set with the fewest entities.
+ *
+ * @designer
+ * @author
+ */
+ComponentSet *smallest_set(World *world, ComponentMask mask) {
+	ComponentSet *smallest = component_set(world, mask & -mask);
+	ComponentSet *set;
+	
+	for(mask &= mask - 1; mask != 0; mask &= mask - 1) {
+		set = component_set(world, mask & -mask);
+		if (set->count < smallest->count) {
+			smallest = set;
+		}
+	}
+	return smallest;
+}
+
+/**
+ * A function that tests one page of masks. Bit i of the result is set if entity i of
+ * the page has every required component and none of the excluded ones.
+ */
+typedef unsigned long long (*MatchPage)(const ComponentMask *masks, ComponentMask required, ComponentMask excluded);
+
+#if defined(MATCH_SSE2)
+/**
+ * Tests one page of masks, two at a time.
+ *
+ * SSE2 has no 64-bit compare, so the halves of each mask are compared separately and
+ * then ANDed with each other.
+ *
+ * @param masks 	The page of masks.
+ * @param required 	The components an entity must have.
+ * @param excluded 	The components an entity must not have.
+ *
+ * @return One bit per entity in the page.
+ *
+ * @designer
+ * @author
+ */
+static unsigned long long match_page_sse2(const ComponentMask *masks, ComponentMask required, ComponentMask excluded) {
+	const __m128i care = _mm_set1_epi64x(required | excluded);
+	const __m128i want = _mm_set1_epi64x(required);
+	unsigned long long matches = 0;
+	__m128i eq;
+	int i;
+	
+	for(i = 0; i < ENTITY_PAGE_SIZE; i += 2) {
+		eq = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128((const __m128i*)&masks[i]), care), want);
+		eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+		matches |= (unsigned long long)_mm_movemask_pd(_mm_castsi128_pd(eq)) << i;
+	}
+	return matches;
+}
+#else
+/**
+ * Tests one page of masks, one at a time.
+ *
+ * @param masks 	The page of masks.
+ * @param required 	The components an entity must have.
+ * @param excluded 	The components an entity must not have.
+ *
+ * @return One bit per entity in the page.
+ *
+ * @designer
+ * @author
+ */
+static unsigned long long match_page_scalar(const ComponentMask *masks, ComponentMask required, ComponentMask excluded) {
+	unsigned long long matches = 0;
+	int i;
+	
+	for(i = 0; i < ENTITY_PAGE_SIZE; i++) {
+		if ((masks[i] & (required | excluded)) == required) {
+			matches |= 1ULL << i;
+		}
+	}
+	return matches;
+}
+#endif
+
+#if defined(MATCH_AVX2)
+/**
+ * Tests one page of masks, four at a time. Only called on CPUs that have AVX2.
+ *
+ * @param masks 	The page of masks.
+ * @param required 	The components an entity must have.
+ * @param excluded 	The components an entity must not have.
+ *
+ * @return One bit per entity in the page.
+ *
+ * @designer
+ * @author
+ */
+__attribute__((target("avx2")))
+static unsigned long long match_page_avx2(const ComponentMask *masks, ComponentMask required, ComponentMask excluded) {
+	const __m256i care = _mm256_set1_epi64x(required | excluded);
+	const __m256i want = _mm256_set1_epi64x(required);
+	unsigned long long matches = 0;
+	__m256i eq;
+	int i;
+	
+	for(i = 0; i < ENTITY_PAGE_SIZE; i += 4) {
+		eq = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_loadu_si256((const __m256i*)&masks[i]), care), want);
+		matches |= (unsigned long long)_mm256_movemask_pd(_mm256_castsi256_pd(eq)) << i;
+	}
+	return matches;
+}
+#endif
+
+/**
+ * Picks the widest page test the CPU can run.
+ *
+ * @return The page test to use.
+ *
+ * @designer
+ * @author
+ */
+static MatchPage pick_match_page() {
+#if defined(MATCH_AVX2)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return match_page_avx2;
+	}
+#endif
+#if defined(MATCH_SSE2)
+	return match_page_sse2;
+#else
+	return match_page_scalar;
+#endif
+}
+
+/**
+ * Finds every entity that has all of the required components and none of the
+ * excluded ones by testing the masks directly, several per instruction.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param required 	The components an entity must have.
+ * @param excluded 	The components an entity must not have.
+ * @param matches 	Filled with one word per page; bit i of word p is entity
+ *					p * ENTITY_PAGE_SIZE + i. Must hold world->num_pages words.
+ *
+ * @return The number of entities that matched.
+ *
+ * @designer
+ * @author
+ */
+unsigned int match_all(World *world, ComponentMask required, ComponentMask excluded, unsigned long long *matches) {
+	static MatchPage match_page = NULL;
+	unsigned int count = 0;
+	unsigned int page;
+	
+	if (match_page == NULL) {
+		match_page = pick_match_page();
+	}
+	
+	for(page = 0; page < world->num_pages; page++) {
+		//free slots have an empty mask, which would match an empty required mask
+		matches[page] = match_page(world->mask.pages[page], required, excluded) & ~world->free_slots[page];
+		count += __builtin_popcountll(matches[page]);
+	}
+	return count;
+}
+
+/**
+ * Used by qsort to put entities in ascending order.
+ */
+static int compare_entities(const void *a, const void *b) {
+	unsigned int ea = *(const unsigned int*)a;
+	unsigned int eb = *(const unsigned int*)b;
+	return (ea > eb) - (ea < eb);
+}
+
+/**
+ * Lists the entities that have every component in a mask, in entity order. Systems
+ * that draw use this since the order of a set changes as entities are removed.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param mask 		The components the entities need.
+ * @param entities 	Filled with the matching entities. Must hold world->capacity entries.
+ *
+ * @return The number of entities found.
+ *
+ * @designer
+ * @author
+ */
+unsigned int collect_entities(World *world, ComponentMask mask, unsigned int *entities) {
+	ComponentSet *set = smallest_set(world, mask);
+	unsigned long long matches[MAX_ENTITY_PAGES];
+	unsigned long long bits;
+	unsigned int count = 0;
+	unsigned int page;
+	unsigned int i;
+	
+	//once the set covers a good part of the world it is cheaper to test every mask
+	//than to sort, and the bitmap already comes out in entity order
+	if (set->count > world->capacity / 8) {
+		match_all(world, mask, COMPONENT_EMPTY, matches);
+		for(page = 0; page < world->num_pages; page++) {
+			for(bits = matches[page]; bits != 0; bits &= bits - 1) {
+				entities[count++] = (page << ENTITY_PAGE_SHIFT) + __builtin_ctzll(bits);
+			}
+		}
+		return count;
+	}
+	
+	for(i = 0; i < set->count; i++) {
+		if (IN_THIS_COMPONENT(world->mask[set->dense[i]], mask)) {
+			entities[count++] = set->dense[i];
+		}
+	}
+	qsort(entities, count, sizeof(unsigned int), compare_entities);
+	return count;
+}
+
+/**
+ * Sums the versions of the sets in a mask. Versions only go up, so the sum changes
+ * whenever an entity joins or leaves any one of the sets.
+ *
+ * @param world The world struct containing all entities.
+ * @param mask 	The components to sum the versions of.
+ *
+ * @return The sum of the versions.
+ *
+ * @designer
+ * @author
+ */
+static unsigned int mask_stamp(World *world, ComponentMask mask) {
+	unsigned int stamp = 0;
+	
+	for(; mask != 0; mask &= mask - 1) {
+		stamp += component_set(world, mask & -mask)->version;
+	}
+	return stamp;
+}
+
+/**
+ * Brings a view's entity list up to date. The list is only rebuilt when an entity
+ * has joined or left one of the mask's sets since it was last built, so a view
+ * that is walked every frame costs nothing until the world changes.
+ *
+ * @param world The world struct containing all entities.
+ * @param mask 	The components the entities need.
+ * @param cache The view's list.
+ *
+ * @designer
+ * @author
+ */
+void refresh_view(World *world, ComponentMask mask, ViewCache *cache) {
+	unsigned int stamp = mask_stamp(world, mask);
+	unsigned int *entities;
+	
+	if (cache->world == world && cache->stamp == stamp && cache->entities != NULL) {
+		return;
+	}
+	
+	if (cache->size < world->capacity) {
+		entities = (unsigned int*)realloc(cache->entities, sizeof(unsigned int) * world->capacity);
+		if (entities == NULL) {
+			perror("refresh_view: realloc");
+			cache->count = 0;
+			cache->world = NULL;
+			return;
+		}
+		cache->entities = entities;
+		cache->size = world->capacity;
+	}
+	
+	if (cache->entities == NULL) {
+		cache->count = 0;
+		return;
+	}
+	
+	cache->count = collect_entities(world, mask, cache->entities);
+	cache->world = world;
+	cache->stamp = stamp;
+}
+
+/**
+ * Removes components from an entity and takes it out of their sets. Components the
+ * entity doesn't have are ignored.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param entity 	The entity to remove the components from.
+ * @param component The components to remove.
+ *
+ * @designer
+ * @author
+ */
+void disable_component(World *world, unsigned int entity, ComponentMask component) {
+	ComponentSet *set;
+	ComponentMask bit;
+	unsigned int last;
+	
+	component &= world->mask[entity];
+	world->mask[entity] &= ~component;
+	
+	for(; component != 0; component &= component - 1) {
+		bit = component & -component;
+		set = component_set(world, bit);
+		
+		//move the last entity into the hole
+		last = set->dense[--set->count];
+		set->dense[set->index[entity]] = last;
+		set->index[last] = set->index[entity];
+		set->version++;
+	}
+}
+
+/**
+ * Adds components to an entity and puts it in their sets. Components the entity
+ * already has are ignored.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param entity 	The entity to add the components to.
+ * @param component The components to add.
+ *
+ * @return false if storage for the components couldn't be allocated, in which case
+ *         the entity is left as it was.
+ *
+ * @designer
+ * @author
+ */
+bool enable_component(World *world, unsigned int entity, ComponentMask component) {
+	ComponentSet *set;
+	ComponentMask bit;
+	
+	component &= ~world->mask[entity];
+	
+	//the page may not have storage for a component that its kind of entity doesn't use
+	if (!alloc_components(world, entity >> ENTITY_PAGE_SHIFT, component)) {
+		perror("enable_component: calloc");
+		return false;
+	}
+	world->mask[entity] |= component;
+	
+	for(; component != 0; component &= component - 1) {
+		bit = component & -component;
+		set = component_set(world, bit);
+		
+		set->index[entity] = set->count;
+		set->dense[set->count++] = entity;
+		set->version++;
+	}
+	return true;
+}
+
+/**
+ * Makes room for a number of rows in the body store. All of the arrays share one
+ * allocation; the rows are rebuilt after this so nothing is copied over.
+ *
+ * @param bodies 	The body store.
+ * @param rows 		The number of rows needed.
+ *
+ * @return true if there is room.
+ *
+ * @designer
+ * @author
+ */
+static bool resize_bodies(BodyStore *bodies, unsigned int rows) {
+	char *block = (char*)malloc(rows * (3 * sizeof(unsigned int) + 2 * sizeof(float) + 7 * sizeof(int) + sizeof(bool)));
+	
+	if (block == NULL) {
+		perror("resize_bodies: malloc");
+		return false;
+	}
+	free(bodies->entity);
+	
+	bodies->entity = (unsigned int*)block;
+	bodies->x = (float*)(bodies->entity + rows);
+	bodies->y = bodies->x + rows;
+	bodies->width = (int*)(bodies->y + rows);
+	bodies->height = bodies->width + rows;
+	bodies->level = bodies->height + rows;
+	bodies->grid.cells = bodies->level + rows;
+	bodies->grid.mark = (unsigned int*)(bodies->grid.cells + 4 * rows);
+	bodies->grid.found = bodies->grid.mark + rows;
+	bodies->active = (bool*)(bodies->grid.found + rows);
+	bodies->size = rows;
+	
+	memset(bodies->grid.mark, 0, sizeof(unsigned int) * rows);
+	bodies->grid.query = 0;
+	return true;
+}
+
+/**
+ * Gets the grid cell a coordinate falls in.
+ *
+ * @param coordinate 	An x or y position in pixels.
+ *
+ * @return The cell, counting from 0 at the map's origin.
+ *
+ * @designer
+ * @author
+ */
+static int body_cell(float coordinate) {
+	return (int)floorf(coordinate / BODY_CELL_SIZE);
+}
+
+/**
+ * Gets the bucket a grid cell on a floor is kept in.
+ *
+ * @param level 	The floor.
+ * @param cx 		The cell across.
+ * @param cy 		The cell down.
+ *
+ * @return The bucket.
+ *
+ * @designer
+ * @author
+ */
+static unsigned int body_bucket(int level, int cx, int cy) {
+	return ((unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u ^ (unsigned int)level * 83492791u) & (BODY_GRID_BUCKETS - 1);
+}
+
+/**
+ * Works out the cells a row covers.
+ *
+ * The queries read x and y two ways: as the centre of the body and as its top left
+ * corner. The row is entered everywhere either reading puts it, and the queries do
+ * the exact test on what the grid hands back.
+ *
+ * @param bodies 	The body store.
+ * @param row 		The row.
+ * @param cells 	Filled with the first and last cell across, then the first and last down.
+ *
+ * @designer
+ * @author
+ */
+static void body_cells(BodyStore *bodies, unsigned int row, int *cells) {
+	cells[0] = body_cell(bodies->x[row] - bodies->width[row] / 2);
+	cells[1] = body_cell(bodies->x[row] + bodies->width[row]);
+	cells[2] = body_cell(bodies->y[row] - bodies->height[row] / 2);
+	cells[3] = body_cell(bodies->y[row] + bodies->height[row]);
+}
+
+/**
+ * Enters a row in every cell it covers.
+ *
+ * @param bodies 	The body store.
+ * @param row 		The row.
+ *
+ * @return false if the grid couldn't grow; the grid is marked incomplete.
+ *
+ * @designer
+ * @author
+ */
+static bool grid_insert(BodyStore *bodies, unsigned int row) {
+	BodyGrid *grid = &bodies->grid;
+	int *cells = &grid->cells[4 * row];
+	BodyGridEntry *grown;
+	unsigned int bucket, entry, i, size;
+	int cx, cy;
+	
+	body_cells(bodies, row, cells);
+	
+	for (cy = cells[2]; cy <= cells[3]; cy++) {
+		for (cx = cells[0]; cx <= cells[1]; cx++) {
+			
+			if (grid->unused == BODY_GRID_END) {
+				size = grid->size ? grid->size * 2 : 1024;
+				grown = (BodyGridEntry*)realloc(grid->entries, sizeof(BodyGridEntry) * size);
+				if (grown == NULL) {
+					perror("grid_insert: realloc, falling back to scanning every body");
+					grid->complete = false;
+					return false;
+				}
+				for (i = grid->size; i < size; i++) {
+					grown[i].next = (i + 1 < size) ? i + 1 : BODY_GRID_END;
+				}
+				grid->entries = grown;
+				grid->unused = grid->size;
+				grid->size = size;
+			}
+			
+			bucket = body_bucket(bodies->level[row], cx, cy);
+			entry = grid->unused;
+			grid->unused = grid->entries[entry].next;
+			
+			grid->entries[entry].row = row;
+			grid->entries[entry].next = grid->head[bucket];
+			grid->head[bucket] = entry;
+		}
+	}
+	return true;
+}
+
+/**
+ * Takes a row out of the cells it was entered in.
+ *
+ * @param bodies 	The body store.
+ * @param row 		The row.
+ * @param level 	The floor the row was entered on.
+ *
+ * @designer
+ * @author
+ */
+static void grid_remove(BodyStore *bodies, unsigned int row, int level) {
+	BodyGrid *grid = &bodies->grid;
+	int *cells = &grid->cells[4 * row];
+	unsigned int *link, entry;
+	int cx, cy;
+	
+	for (cy = cells[2]; cy <= cells[3]; cy++) {
+		for (cx = cells[0]; cx <= cells[1]; cx++) {
+			
+			//take out one entry per cell; two of the row's cells can share a bucket
+			for (link = &grid->head[body_bucket(level, cx, cy)]; *link != BODY_GRID_END; link = &grid->entries[*link].next) {
+				if (grid->entries[*link].row == row) {
+					entry = *link;
+					*link = grid->entries[entry].next;
+					grid->entries[entry].next = grid->unused;
+					grid->unused = entry;
+					break;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Enters every row in the grid from scratch.
+ *
+ * @param bodies 	The body store.
+ *
+ * @designer
+ * @author
+ */
+static void grid_build(BodyStore *bodies) {
+	BodyGrid *grid = &bodies->grid;
+	unsigned int i;
+	
+	memset(grid->head, 0xFF, sizeof(grid->head));
+	for (i = 0; i < grid->size; i++) {
+		grid->entries[i].next = (i + 1 < grid->size) ? i + 1 : BODY_GRID_END;
+	}
+	grid->unused = grid->size ? 0 : BODY_GRID_END;
+	grid->complete = true;
+	
+	for (i = 0; i < bodies->count; i++) {
+		if (!grid_insert(bodies, i)) {
+			return;
+		}
+	}
+}
+
+/**
+ * Moves a row in the grid if its box now covers different cells.
+ *
+ * @param bodies 	The body store.
+ * @param row 		The row, already holding its new position.
+ * @param level 	The floor the row was entered on.
+ *
+ * @designer
+ * @author
+ */
+static void grid_move(BodyStore *bodies, unsigned int row, int level) {
+	int *cells = &bodies->grid.cells[4 * row];
+	int moved[4];
+	
+	body_cells(bodies, row, moved);
+	if (level != bodies->level[row] || moved[0] != cells[0] || moved[1] != cells[1] || moved[2] != cells[2] || moved[3] != cells[3]) {
+		grid_remove(bodies, row, level);
+		grid_insert(bodies, row);
+	}
+}
+
+/**
+ * Copies the position and collision fields of every collider into the body store.
+ * The movement system calls this once a frame before anything moves.
+ *
+ * @param world The world struct containing all entities.
+ *
+ * @designer
+ * @author
+ */
+void sync_bodies(World *world) {
+	View<CollisionComponent, PositionComponent> colliders(world);
+	BodyStore *bodies = &world->bodies;
 	unsigned int entity;
+	unsigned int n, row;
+	
+	unsigned int stamp = mask_stamp(world, BODY_COMPONENTS);
+	int level;
+	
+	//the same colliders as last time, so only the bodies that changed cells move in the grid;
+	//a grid that couldn't grow is built again from scratch
+	if (bodies->built && bodies->grid.complete && bodies->stamp == stamp) {
+		for(n = 0; n < bodies->count; n++) {
+			PositionComponent &position = colliders.get<PositionComponent>(bodies->entity[n]);
+			
+			level = bodies->level[n];
+			bodies->x[n] = position.x;
+			bodies->y[n] = position.y;
+			bodies->width[n] = position.width;
+			bodies->height[n] = position.height;
+			bodies->level[n] = position.level;
+			bodies->active[n] = colliders.get<CollisionComponent>(bodies->entity[n]).active;
+			grid_move(bodies, n, level);
+		}
+		return;
+	}
+	
+	if (bodies->size < colliders.size() && !resize_bodies(bodies, colliders.size())) {
+		bodies->count = 0;
+		bodies->built = false;
+		return;
+	}
+	
+	for(n = 0, row = 0; n < colliders.size(); n++) {
+		entity = colliders[n];
+		PositionComponent &position = colliders.get<PositionComponent>(entity);
+		
+		//baked into their floor's static layer
+		if (IN_THIS_COMPONENT(world->mask[entity], COMPONENT_STATIC)) {
+			continue;
+		}
+		
+		bodies->entity[row] = entity;
+		bodies->x[row] = position.x;
+		bodies->y[row] = position.y;
+		bodies->width[row] = position.width;
+		bodies->height[row] = position.height;
+		bodies->level[row] = position.level;
+		bodies->active[row] = colliders.get<CollisionComponent>(entity).active;
+		row++;
+	}
+	bodies->count = row;
+	bodies->stamp = stamp;
+	bodies->built = true;
+	grid_build(bodies);
+}
+
+/**
+ * Gets the body store for a collision query, rebuilding it first if colliders have
+ * been created or destroyed since it was last built.
+ *
+ * @param world The world struct containing all entities.
+ *
+ * @return The body store.
+ *
+ * @designer
+ * @author
+ */
+BodyStore *collider_bodies(World *world) {
+	if (!world->bodies.built || world->bodies.stamp != mask_stamp(world, BODY_COMPONENTS)) {
+		sync_bodies(world);
+	}
+	return &world->bodies;
+}
+
+/**
+ * Copies an entity's position back into the body store after it has moved.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param entity 	The entity that moved. Entities that aren't colliders are ignored.
+ *
+ * @designer
+ * @author
+ */
+void update_body(World *world, unsigned int entity) {
+	BodyStore *bodies = &world->bodies;
+	int level;
+	unsigned int low = 0;
+	unsigned int high = bodies->count;
+	unsigned int mid;
+	
+	//the rows are in entity order
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (bodies->entity[mid] < entity) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	
+	if (low < bodies->count && bodies->entity[low] == entity) {
+		level = bodies->level[low];
+		bodies->x[low] = world->position[entity].x;
+		bodies->y[low] = world->position[entity].y;
+		bodies->width[low] = world->position[entity].width;
+		bodies->height[low] = world->position[entity].height;
+		bodies->level[low] = world->position[entity].level;
+		grid_move(bodies, low, level);
+	}
+}
+
+/**
+ * Finds the colliders on a floor whose boxes may overlap a box.
+ *
+ * Only the grid cells the box touches are looked at, or every row on the floor if
+ * the grid couldn't grow to hold them all. The rows handed back are candidates in
+ * row order, which is entity order; the caller does the exact test. They stay good
+ * until the next query.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param left 		The left edge of the box.
+ * @param top 		The top edge of the box.
+ * @param right 	The right edge of the box.
+ * @param bottom 	The bottom edge of the box.
+ * @param level 	The floor to look on.
+ * @param rows 		Set to the body store rows found.
+ *
+ * @return The number of rows found.
+ *
+ * @designer
+ * @author
+ */
+unsigned int query_bodies_box(World *world, float left, float top, float right, float bottom, int level, unsigned int **rows) {
+	BodyStore *bodies = collider_bodies(world);
+	BodyGrid *grid = &bodies->grid;
+	unsigned int count = 0;
+	unsigned int entry, row, i;
+	int cx, cy;
+	int cx0 = body_cell(left), cx1 = body_cell(right);
+	int cy0 = body_cell(top), cy1 = body_cell(bottom);
+	
+	*rows = grid->found;
+	if (!bodies->built) {
+		return 0;
+	}
+	
+	if (!grid->complete) {
+		for (row = 0; row < bodies->count; row++) {
+			if (bodies->level[row] == level) {
+				grid->found[count++] = row;
+			}
+		}
+		return count;
+	}
+	
+	//a fresh mark each query, so a row in several of the cells is only returned once
+	if (++grid->query == 0) {
+		memset(grid->mark, 0, sizeof(unsigned int) * bodies->size);
+		grid->query = 1;
+	}
+	
+	for (cy = cy0; cy <= cy1; cy++) {
+		for (cx = cx0; cx <= cx1; cx++) {
+			for (entry = grid->head[body_bucket(level, cx, cy)]; entry != BODY_GRID_END; entry = grid->entries[entry].next) {
+				row = grid->entries[entry].row;
+				
+				if (grid->mark[row] != grid->query && bodies->level[row] == level) {
+					grid->mark[row] = grid->query;
+					
+					//keep the rows sorted; there are only ever a few
+					for (i = count; i > 0 && grid->found[i - 1] > row; i--) {
+						grid->found[i] = grid->found[i - 1];
+					}
+					grid->found[i] = row;
+					count++;
+				}
+			}
+		}
+	}
+	return count;
+}
+
+/**
+ * Finds the colliders on a floor whose boxes may be within a distance of a point.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param x 		The point's x position.
+ * @param y 		The point's y position.
+ * @param radius 	The distance.
+ * @param level 	The floor to look on.
+ * @param rows 		Set to the body store rows found, as for query_bodies_box.
+ *
+ * @return The number of rows found.
+ *
+ * @designer
+ * @author
+ */
+unsigned int query_bodies_radius(World *world, float x, float y, float radius, int level, unsigned int **rows) {
+	return query_bodies_box(world, x - radius, y - radius, x + radius, y + radius, level, rows);
+}
+
+/**
+ * Gets the tile a coordinate falls in, kept on the map.
+ *
+ * @param coordinate 	The x or y position.
+ * @param tileSize 		The size of a tile.
+ * @param tiles 		The number of tiles across or down.
+ *
+ * @return The tile.
+ *
+ * @designer
+ * @author
+ */
+static int static_tile(float coordinate, int tileSize, int tiles) {
+	int tile = (int)floorf(coordinate / tileSize);
+	
+	return tile < 0 ? 0 : (tile >= tiles ? tiles - 1 : tile);
+}
+
+/**
+ * Works out the tiles a static collider is listed under. As in the collider grid,
+ * the box covers both the centre reading and the top left reading of its position.
+ *
+ * @param level 	The floor.
+ * @param position 	The collider's position.
+ * @param tiles 	Filled with the first and last tile across, then the first and last down.
+ *
+ * @designer
+ * @author
+ */
+static void static_tiles(LevelComponent *level, PositionComponent *position, int *tiles) {
+	tiles[0] = static_tile(position->x - position->width / 2, level->tileSize, level->width);
+	tiles[1] = static_tile(position->x + position->width, level->tileSize, level->width);
+	tiles[2] = static_tile(position->y - position->height / 2, level->tileSize, level->height);
+	tiles[3] = static_tile(position->y + position->height, level->tileSize, level->height);
+}
+
+/**
+ * Bakes the colliders on a floor that never move into the floor's static layer.
+ *
+ * Every collider on the floor without movement that isn't a spawned tile is listed,
+ * by handle and collision type, under each tile its box touches. They are tagged
+ * COMPONENT_STATIC, which takes them out of the body store, so the per frame passes
+ * only look at the players and spawned tiles. Call it once the floor's entities have
+ * been created; the layer lives in the floor arena with the rest of the floor.
+ *
+ * @param world The world struct containing all entities.
+ * @param floor The floor ID.
+ *
+ * @designer
+ * @author
+ */
+void bake_static_colliders(World *world, int floor) {
+	View<CollisionComponent, PositionComponent> colliders(world);
+	LevelComponent *level = find_level(world, floor);
+	unsigned int *baked, *next;
+	unsigned int num_baked = 0;
+	unsigned int num_tiles, n, entity, tile;
+	int tiles[4];
+	int x, y;
+	
+	if (level == NULL) {
+		return;
+	}
+	
+	baked = (unsigned int*)malloc(sizeof(unsigned int) * (colliders.size() + 1));
+	next = (unsigned int*)malloc(sizeof(unsigned int) * (level->width * level->height + 1));
+	if (baked == NULL || next == NULL) {
+		perror("bake_static_colliders: malloc");
+		free(baked);
+		free(next);
+		return;
+	}
+	
+	for(n = 0; n < colliders.size(); n++) {
+		entity = colliders[n];
+		
+		if ((world->mask[entity] & (COMPONENT_MOVEMENT | COMPONENT_STILE | COMPONENT_STATIC)) == 0 &&
+			world->position[entity].level == floor) {
+			baked[num_baked++] = entity;
+		}
+	}
+	
+	num_tiles = level->width * level->height;
+	level->static_start = (unsigned int*)arena_alloc(&world->floor_arena, sizeof(unsigned int) * (num_tiles + 1));
+	level->static_found = (unsigned int*)arena_alloc(&world->floor_arena, sizeof(unsigned int) * num_baked);
+	level->static_types = (int*)arena_alloc(&world->floor_arena, sizeof(int) * num_baked);
+	if (level->static_start == NULL || level->static_found == NULL || level->static_types == NULL) {
+		level->statics = NULL;
+		free(baked);
+		free(next);
+		return;
+	}
+	
+	//count the colliders on each tile, then turn the counts into where each tile starts
+	memset(level->static_start, 0, sizeof(unsigned int) * (num_tiles + 1));
+	for(n = 0; n < num_baked; n++) {
+		static_tiles(level, &world->position[baked[n]], tiles);
+		for (y = tiles[2]; y <= tiles[3]; y++) {
+			for (x = tiles[0]; x <= tiles[1]; x++) {
+				level->static_start[y * level->width + x + 1]++;
+			}
+		}
+	}
+	for (tile = 0; tile < num_tiles; tile++) {
+		level->static_start[tile + 1] += level->static_start[tile];
+	}
+	
+	level->statics = (StaticCollider*)arena_alloc(&world->floor_arena, sizeof(StaticCollider) * level->static_start[num_tiles]);
+	if (level->statics == NULL) {
+		free(baked);
+		free(next);
+		return;
+	}
+	
+	//the colliders go in entity order, so each tile's list is in entity order
+	memcpy(next, level->static_start, sizeof(unsigned int) * num_tiles);
+	for(n = 0; n < num_baked; n++) {
+		entity = baked[n];
+		static_tiles(level, &world->position[entity], tiles);
+		for (y = tiles[2]; y <= tiles[3]; y++) {
+			for (x = tiles[0]; x <= tiles[1]; x++) {
+				tile = y * level->width + x;
+				level->statics[next[tile]].entity = entity_handle(world, entity);
+				level->statics[next[tile]].type = world->collision[entity].type;
+				next[tile]++;
+			}
+		}
+	}
+	level->num_static = num_baked;
+	
+	for(n = 0; n < num_baked; n++) {
+		enable_component(world, baked[n], COMPONENT_STATIC);
+	}
+	
+	free(baked);
+	free(next);
+}
+
+/**
+ * Finds the static colliders on a floor whose boxes may overlap a box.
+ *
+ * Only the tiles the box touches are looked at, and colliders that have since been
+ * destroyed or lost their collision are left out. The entities are handed back in
+ * entity order with their collision types; the caller does the exact test. They stay
+ * good until the next query on the floor.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param left 		The left edge of the box.
+ * @param top 		The top edge of the box.
+ * @param right 	The right edge of the box.
+ * @param bottom 	The bottom edge of the box.
+ * @param level 	The floor to look on.
+ * @param entities 	Set to the entities found.
+ * @param types 	Set to their collision types.
+ *
+ * @return The number of entities found.
+ *
+ * @designer
+ * @author
+ */
+unsigned int query_static_box(World *world, float left, float top, float right, float bottom, int level, unsigned int **entities, int **types) {
+	LevelComponent *floor = find_level(world, level);
+	unsigned int *found;
+	int *found_types;
+	unsigned int count = 0;
+	unsigned int e, i, entity;
+	int x, y, x0, x1, y0, y1;
+	
+	*entities = NULL;
+	*types = NULL;
+	if (floor == NULL || floor->statics == NULL) {
+		return 0;
+	}
+	
+	found = *entities = floor->static_found;
+	found_types = *types = floor->static_types;
+	
+	x0 = static_tile(left, floor->tileSize, floor->width);
+	x1 = static_tile(right, floor->tileSize, floor->width);
+	y0 = static_tile(top, floor->tileSize, floor->height);
+	y1 = static_tile(bottom, floor->tileSize, floor->height);
+	
+	for (y = y0; y <= y1; y++) {
+		for (x = x0; x <= x1; x++) {
+			for (e = floor->static_start[y * floor->width + x]; e < floor->static_start[y * floor->width + x + 1]; e++) {
+				entity = entity_from_handle(world, floor->statics[e].entity);
+				
+				if (entity == MAX_ENTITIES || !IN_THIS_COMPONENT(world->mask[entity], COMPONENT_COLLISION | COMPONENT_POSITION | COMPONENT_STATIC)) {
+					continue;
+				}
+				
+				//keep the entities sorted, and only once when they span several tiles
+				for (i = count; i > 0 && found[i - 1] > entity; i--);
+				if (i > 0 && found[i - 1] == entity) {
+					continue;
+				}
+				memmove(&found[i + 1], &found[i], sizeof(unsigned int) * (count - i));
+				memmove(&found_types[i + 1], &found_types[i], sizeof(int) * (count - i));
+				found[i] = entity;
+				found_types[i] = floor->statics[e].type;
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+/**
+ * Makes room for a number of colliders in the batch. Like the body store, every
+ * array shares one allocation and nothing is copied over.
+ *
+ * @param batch 	The batch.
+ * @param size 		The number of colliders needed.
+ *
+ * @return true if there is room. The caller reports a failure.
+ *
+ * @designer
+ * @author
+ */
+static bool resize_batch(BodyBatch *batch, unsigned int size) {
+	unsigned int words = (size + 63) / 64;
+	char *block = (char*)malloc(words * sizeof(unsigned long long) + size * (sizeof(unsigned int) + 2 * sizeof(float) + 3 * sizeof(int) + sizeof(bool)));
+	
+	if (block == NULL) {
+		return false;
+	}
+	free(batch->hits);
+	
+	//the hit words go first so they are aligned
+	batch->hits = (unsigned long long*)block;
+	batch->entity = (unsigned int*)(batch->hits + words);
+	batch->x = (float*)(batch->entity + size);
+	batch->y = batch->x + size;
+	batch->width = (int*)(batch->y + size);
+	batch->height = batch->width + size;
+	batch->type = batch->height + size;
+	batch->active = (bool*)(batch->type + size);
+	batch->size = size;
+	return true;
+}
+
+/**
+ * Gathers the colliders on a floor whose boxes may overlap a box into the world's
+ * batch: the moving ones from the grid and the static ones from the floor's static
+ * layer, merged into entity order.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param left 		The left edge of the box.
+ * @param top 		The top edge of the box.
+ * @param right 	The right edge of the box.
+ * @param bottom 	The bottom edge of the box.
+ * @param level 	The floor to look on.
+ *
+ * @return The batch, good until the next gather, or NULL if it couldn't grow; the
+ *		   colliders are then tested one at a time with scan_colliders.
+ *
+ * @designer
+ * @author
+ */
+BodyBatch *gather_colliders(World *world, float left, float top, float right, float bottom, int level) {
+	BodyBatch *batch = &world->batch;
+	BodyStore *bodies;
+	unsigned int *rows, *statics;
+	int *types;
+	unsigned int num_rows = query_bodies_box(world, left, top, right, bottom, level, &rows);
+	unsigned int num_statics = query_static_box(world, left, top, right, bottom, level, &statics, &types);
+	unsigned int r = 0, s = 0, n, entity;
+	static bool warned = false;
+	
+	bodies = &world->bodies;
+	batch->count = 0;
+	if (batch->size < num_rows + num_statics && !resize_batch(batch, num_rows + num_statics)) {
+		if (!warned) {
+			perror("gather_colliders: malloc");
+			printf("gather_colliders: %u colliders don't fit, testing them one at a time\n", num_rows + num_statics);
+			warned = true;
+		}
+		return NULL;
+	}
+	
+	for (n = 0; r < num_rows || s < num_statics; n++) {
+		if (s >= num_statics || (r < num_rows && bodies->entity[rows[r]] < statics[s])) {
+			batch->entity[n] = bodies->entity[rows[r]];
+			batch->type[n] = world->collision[batch->entity[n]].type;
+			batch->x[n] = bodies->x[rows[r]];
+			batch->y[n] = bodies->y[rows[r]];
+			batch->width[n] = bodies->width[rows[r]];
+			batch->height[n] = bodies->height[rows[r]];
+			batch->active[n] = bodies->active[rows[r]];
+			r++;
+		}
+		else {
+			entity = statics[s];
+			batch->entity[n] = entity;
+			batch->type[n] = types[s];
+			batch->x[n] = world->position[entity].x;
+			batch->y[n] = world->position[entity].y;
+			batch->width[n] = world->position[entity].width;
+			batch->height[n] = world->position[entity].height;
+			batch->active[n] = world->collision[entity].active;
+			s++;
+		}
+	}
+	batch->count = n;
+	return batch;
+}
+
+/**
+ * Tests one collider against a box.
+ *
+ * @param box 		The box.
+ * @param x 		The collider's x position.
+ * @param y 		The collider's y position.
+ * @param width 	The collider's width.
+ * @param height 	The collider's height.
+ *
+ * @return true if they overlap.
+ *
+ * @designer
+ * @author
+ */
+static inline bool overlap_one(const OverlapBox *box, float x, float y, int width, int height) {
+	if (box->reading == BOX_CENTRE) {
+		return x - width / 2 < box->right && x + width / 2 > box->left &&
+			y - height / 2 < box->bottom && y + height / 2 > box->top;
+	}
+	return x < box->right && x + width > box->left && y < box->bottom && y + height > box->top;
+}
+
+/**
+ * A function that tests a run of colliders against a box, setting bit i of hits for
+ * each collider i that overlaps it and is active. The hit words start out cleared.
+ */
+typedef void (*OverlapRun)(const OverlapBox *box, const float *x, const float *y, const int *width, const int *height, const bool *active, unsigned int count, unsigned long long *hits);
+
+/**
+ * Tests the colliders after the last whole group of lanes, one at a time.
+ *
+ * @param box 		The box.
+ * @param x 		The colliders' x positions.
+ * @param y 		The colliders' y positions.
+ * @param width 	The colliders' widths.
+ * @param height 	The colliders' heights.
+ * @param active 	Whether each collider is active.
+ * @param first 	The first collider to test.
+ * @param count 	The number of colliders.
+ * @param hits 		One bit per collider.
+ *
+ * @designer
+ * @author
+ */
+static void overlap_tail(const OverlapBox *box, const float *x, const float *y, const int *width, const int *height, const bool *active, unsigned int first, unsigned int count, unsigned long long *hits) {
+	unsigned int i;
+	
+	for (i = first; i < count; i++) {
+		if (active[i] && overlap_one(box, x[i], y[i], width[i], height[i])) {
+			hits[i >> 6] |= 1ULL << (i & 63);
+		}
+	}
+}
+
+#if defined(MATCH_SSE2)
+/**
+ * Tests colliders against a box, four at a time.
+ *
+ * The widths and heights are halved with a shift, which is the same as the integer
+ * division the scalar test does since they are never negative.
+ *
+ * @param box 		The box.
+ * @param x 		The colliders' x positions.
+ * @param y 		The colliders' y positions.
+ * @param width 	The colliders' widths.
+ * @param height 	The colliders' heights.
+ * @param active 	Whether each collider is active.
+ * @param count 	The number of colliders.
+ * @param hits 		One bit per collider.
+ *
+ * @designer
+ * @author
+ */
+static void overlap_run_sse2(const OverlapBox *box, const float *x, const float *y, const int *width, const int *height, const bool *active, unsigned int count, unsigned long long *hits) {
+	const __m128 left = _mm_set1_ps(box->left);
+	const __m128 top = _mm_set1_ps(box->top);
+	const __m128 right = _mm_set1_ps(box->right);
+	const __m128 bottom = _mm_set1_ps(box->bottom);
+	const int shift = box->reading == BOX_CENTRE ? 1 : 0;
+	const __m128 centre = box->reading == BOX_CENTRE ? _mm_set1_ps(1.0f) : _mm_setzero_ps();
+	__m128 px, py, w, h, hit;
+	unsigned int i, bits;
+	int on;
+	
+	for (i = 0; i + 4 <= count; i += 4) {
+		px = _mm_loadu_ps(&x[i]);
+		py = _mm_loadu_ps(&y[i]);
+		w = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_loadu_si128((const __m128i*)&width[i]), shift));
+		h = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_loadu_si128((const __m128i*)&height[i]), shift));
+		
+		//read from the centre the box runs half a size each way, from the corner a whole size one way
+		hit = _mm_and_ps(_mm_cmplt_ps(_mm_sub_ps(px, _mm_mul_ps(w, centre)), right), _mm_cmpgt_ps(_mm_add_ps(px, w), left));
+		hit = _mm_and_ps(hit, _mm_cmplt_ps(_mm_sub_ps(py, _mm_mul_ps(h, centre)), bottom));
+		hit = _mm_and_ps(hit, _mm_cmpgt_ps(_mm_add_ps(py, h), top));
+		
+		//a byte per flag, so the zero bytes are the inactive colliders
+		memcpy(&on, &active[i], 4);
+		bits = _mm_movemask_ps(hit) & ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_cvtsi32_si128(on), _mm_setzero_si128())) & 0xF;
+		hits[i >> 6] |= (unsigned long long)bits << (i & 63);
+	}
+	overlap_tail(box, x, y, width, height, active, i, count, hits);
+}
+#else
+/**
+ * Tests colliders against a box, one at a time.
+ *
+ * @param box 		The box.
+ * @param x 		The colliders' x positions.
+ * @param y 		The colliders' y positions.
+ * @param width 	The colliders' widths.
+ * @param height 	The colliders' heights.
+ * @param active 	Whether each collider is active.
+ * @param count 	The number of colliders.
+ * @param hits 		One bit per collider.
+ *
+ * @designer
+ * @author
+ */
+static void overlap_run_scalar(const OverlapBox *box, const float *x, const float *y, const int *width, const int *height, const bool *active, unsigned int count, unsigned long long *hits) {
+	overlap_tail(box, x, y, width, height, active, 0, count, hits);
+}
+#endif
+
+#if defined(MATCH_AVX2)
+/**
+ * Tests colliders against a box, eight at a time. Only called on CPUs that have AVX2.
+ *
+ * @param box 		The box.
+ * @param x 		The colliders' x positions.
+ * @param y 		The colliders' y positions.
+ * @param width 	The colliders' widths.
+ * @param height 	The colliders' heights.
+ * @param active 	Whether each collider is active.
+ * @param count 	The number of colliders.
+ * @param hits 		One bit per collider.
+ *
+ * @designer
+ * @author
+ */
+__attribute__((target("avx2")))
+static void overlap_run_avx2(const OverlapBox *box, const float *x, const float *y, const int *width, const int *height, const bool *active, unsigned int count, unsigned long long *hits) {
+	const __m256 left = _mm256_set1_ps(box->left);
+	const __m256 top = _mm256_set1_ps(box->top);
+	const __m256 right = _mm256_set1_ps(box->right);
+	const __m256 bottom = _mm256_set1_ps(box->bottom);
+	const __m128i shift = _mm_cvtsi32_si128(box->reading == BOX_CENTRE ? 1 : 0);
+	const __m256 centre = box->reading == BOX_CENTRE ? _mm256_set1_ps(1.0f) : _mm256_setzero_ps();
+	__m256 px, py, w, h, hit;
+	unsigned int i, bits;
+	
+	for (i = 0; i + 8 <= count; i += 8) {
+		px = _mm256_loadu_ps(&x[i]);
+		py = _mm256_loadu_ps(&y[i]);
+		w = _mm256_cvtepi32_ps(_mm256_sra_epi32(_mm256_loadu_si256((const __m256i*)&width[i]), shift));
+		h = _mm256_cvtepi32_ps(_mm256_sra_epi32(_mm256_loadu_si256((const __m256i*)&height[i]), shift));
+		
+		hit = _mm256_and_ps(_mm256_cmp_ps(_mm256_sub_ps(px, _mm256_mul_ps(w, centre)), right, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(px, w), left, _CMP_GT_OQ));
+		hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_sub_ps(py, _mm256_mul_ps(h, centre)), bottom, _CMP_LT_OQ));
+		hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(py, h), top, _CMP_GT_OQ));
+		
+		bits = _mm256_movemask_ps(hit) & ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i*)&active[i]), _mm_setzero_si128())) & 0xFF;
+		hits[i >> 6] |= (unsigned long long)bits << (i & 63);
+	}
+	//the tail is plain SSE code, which stalls if the upper halves are left dirty
+	_mm256_zeroupper();
+	overlap_tail(box, x, y, width, height, active, i, count, hits);
+}
+#endif
+
+/**
+ * Picks the widest overlap test the CPU can run.
+ *
+ * @return The overlap test to use.
+ *
+ * @designer
+ * @author
+ */
+static OverlapRun pick_overlap_run() {
+#if defined(MATCH_AVX2)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return overlap_run_avx2;
+	}
+#endif
+#if defined(MATCH_SSE2)
+	return overlap_run_sse2;
+#else
+	return overlap_run_scalar;
+#endif
+}
+
+/**
+ * Tests a run of colliders, packed one array per field, against a box several at a
+ * time. Inactive colliders never hit.
+ *
+ * @param box 		The box.
+ * @param x 		The colliders' x positions, read as box->reading says.
+ * @param y 		The colliders' y positions.
+ * @param width 	The colliders' widths.
+ * @param height 	The colliders' heights.
+ * @param active 	Whether each collider is active.
+ * @param count 	The number of colliders.
+ * @param hits 		Filled with one bit per collider, set if it overlaps the box. Must
+ *					hold (count + 63) / 64 words.
+ *
+ * @return The number of colliders that overlap the box.
+ *
+ * @designer
+ * @author
+ */
+unsigned int overlap_boxes(const OverlapBox *box, const float *x, const float *y, const int *width, const int *height, const bool *active, unsigned int count, unsigned long long *hits) {
+	static OverlapRun overlap_run = NULL;
+	unsigned int words = (count + 63) / 64;
+	unsigned int found = 0;
+	unsigned int i;
+	
+	if (overlap_run == NULL) {
+		overlap_run = pick_overlap_run();
+	}
+	
+	memset(hits, 0, sizeof(unsigned long long) * words);
+	overlap_run(box, x, y, width, height, active, count, hits);
+	
+	for (i = 0; i < words; i++) {
+		found += __builtin_popcountll(hits[i]);
+	}
+	return found;
+}
+
+/**
+ * Tests the colliders gathered in a batch against a box, leaving the result in the
+ * batch's hit bits.
+ *
+ * @param batch 	The batch from gather_colliders.
+ * @param box 		The box.
+ *
+ * @return The number of colliders that overlap the box.
+ *
+ * @designer
+ * @author
+ */
+unsigned int overlap_batch(BodyBatch *batch, const OverlapBox *box) {
+	if (batch->count == 0) {
+		return 0;
+	}
+	return overlap_boxes(box, batch->x, batch->y, batch->width, batch->height, batch->active, batch->count, batch->hits);
+}
+
+/**
+ * Finds the first collider on a floor, from an entity on, whose box overlaps a box.
+ * The candidates are tested one at a time, straight from the body store and the
+ * floor's static layer, so nothing is allocated; the collision checks use it in
+ * place of a batch when gather_colliders couldn't grow one.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param box 		The box.
+ * @param level 	The floor to look on.
+ * @param from 		The lowest entity to return.
+ * @param type 		Set to the collider's collision type.
+ *
+ * @return The collider, or MAX_ENTITIES if there are no more. Inactive colliders are
+ *		   skipped, as in overlap_boxes.
+ *
+ * @designer
+ * @author
+ */
+unsigned int scan_colliders(World *world, const OverlapBox *box, int level, unsigned int from, int *type) {
+	BodyStore *bodies;
+	unsigned int *rows, *statics;
+	int *types;
+	unsigned int num_rows = query_bodies_box(world, box->left, box->top, box->right, box->bottom, level, &rows);
+	unsigned int num_statics = query_static_box(world, box->left, box->top, box->right, box->bottom, level, &statics, &types);
+	unsigned int found = MAX_ENTITIES;
+	unsigned int r, s, entity;
+	
+	bodies = &world->bodies;
+	for (r = 0; r < num_rows; r++) {
+		if (bodies->entity[rows[r]] >= from && bodies->active[rows[r]] &&
+			overlap_one(box, bodies->x[rows[r]], bodies->y[rows[r]], bodies->width[rows[r]], bodies->height[rows[r]])) {
+			found = bodies->entity[rows[r]];
+			*type = world->collision[found].type;
+			break;
+		}
+	}
+	
+	//both lists are in entity order, so only a static below the row found can beat it
+	for (s = 0; s < num_statics && statics[s] < found; s++) {
+		entity = statics[s];
+		if (entity >= from && world->collision[entity].active &&
+			overlap_one(box, world->position[entity].x, world->position[entity].y, world->position[entity].width, world->position[entity].height)) {
+			found = entity;
+			*type = types[s];
+			break;
+		}
+	}
+	return found;
+}
+
+/**
+ * Makes room for a number of movers in the world's integrator batch.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param count 	The number of movers this step.
+ *
+ * @return The batch with count lanes, or NULL if it couldn't grow. The caller reports
+ *		   a failure.
+ *
+ * @designer
+ * @author
+ */
+MoverBatch *reserve_movers(World *world, unsigned int count) {
+	MoverBatch *batch = &world->integrator;
+	char *block;
+	
+	if (batch->size < count) {
+		block = (char*)malloc(count * (sizeof(unsigned int) + 8 * sizeof(float)));
+		if (block == NULL) {
+			return NULL;
+		}
+		free(batch->entity);
+		
+		batch->entity = (unsigned int*)block;
+		batch->movX = (float*)(batch->entity + count);
+		batch->movY = batch->movX + count;
+		batch->forceX = batch->movY + count;
+		batch->forceY = batch->forceX + count;
+		batch->maxSpeed = batch->forceY + count;
+		batch->friction = batch->maxSpeed + count;
+		batch->dx = batch->friction + count;
+		batch->dy = batch->dx + count;
+		batch->size = count;
+	}
+	batch->count = count;
+	return batch;
+}
+
+/**
+ * A function that steps a run of movers of the integrator batch.
+ */
+typedef void (*IntegrateRun)(MoverBatch *batch, unsigned int first, unsigned int count);
+
+/**
+ * Steps movers one at a time. Pushes the mover, holds a pushed mover to its top
+ * speed, works out the step's move and then slows it by its friction.
+ *
+ * @param batch 	The batch.
+ * @param first 	The first mover to step.
+ * @param count 	The number of movers.
+ *
+ * @designer
+ * @author
+ */
+static void integrate_tail(MoverBatch *batch, unsigned int first, unsigned int count) {
+	const float scale = (float)STEP_SCALE;
+	float vx, vy, speed, damp;
+	unsigned int i;
 	
-	for(entity = 0; entity < MAX_ENTITIES; entity++) {
-		if(!IN_THIS_COMPONENT(world->mask[entity], COMPONENT_PLAYER) && !IN_THIS_COMPONENT(world->mask[entity], COMPONENT_STILE)) {
-			destroy_entity(world, entity);
+	for (i = first; i < count; i++) {
+		vx = batch->movX[i] + batch->forceX[i];
+		vy = batch->movY[i] + batch->forceY[i];
+		speed = vx * vx + vy * vy;
+		if ((batch->forceX[i] != 0 || batch->forceY[i] != 0) && speed > batch->maxSpeed[i] * batch->maxSpeed[i]) {
+			speed = batch->maxSpeed[i] / sqrtf(speed);
+			vx *= speed;
+			vy *= speed;
 		}
+		
+		batch->dx[i] = vx * scale;
+		batch->dy[i] = vy * scale;
+		
+		damp = 1 - batch->friction[i] * scale;
+		batch->movX[i] = vx * damp;
+		batch->movY[i] = vy * damp;
+	}
+}
+
+#if defined(MATCH_SSE2)
+/**
+ * Steps movers four at a time, the same way integrate_tail does.
+ *
+ * @param batch 	The batch.
+ * @param first 	The first mover to step.
+ * @param count 	The number of movers.
+ *
+ * @designer
+ * @author
+ */
+static void integrate_run_sse2(MoverBatch *batch, unsigned int first, unsigned int count) {
+	const __m128 scale = _mm_set1_ps((float)STEP_SCALE);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 vx, vy, fx, fy, top, speed, clamp, damp;
+	unsigned int i;
+	
+	for (i = first; i + 4 <= count; i += 4) {
+		fx = _mm_loadu_ps(&batch->forceX[i]);
+		fy = _mm_loadu_ps(&batch->forceY[i]);
+		top = _mm_loadu_ps(&batch->maxSpeed[i]);
+		vx = _mm_add_ps(_mm_loadu_ps(&batch->movX[i]), fx);
+		vy = _mm_add_ps(_mm_loadu_ps(&batch->movY[i]), fy);
+		
+		//only the pushed lanes that went over their top speed are scaled back
+		speed = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+		clamp = _mm_and_ps(_mm_or_ps(_mm_cmpneq_ps(fx, zero), _mm_cmpneq_ps(fy, zero)), _mm_cmpgt_ps(speed, _mm_mul_ps(top, top)));
+		speed = _mm_div_ps(top, _mm_sqrt_ps(speed));
+		speed = _mm_or_ps(_mm_and_ps(clamp, speed), _mm_andnot_ps(clamp, one));
+		vx = _mm_mul_ps(vx, speed);
+		vy = _mm_mul_ps(vy, speed);
+		
+		_mm_storeu_ps(&batch->dx[i], _mm_mul_ps(vx, scale));
+		_mm_storeu_ps(&batch->dy[i], _mm_mul_ps(vy, scale));
+		
+		damp = _mm_sub_ps(one, _mm_mul_ps(_mm_loadu_ps(&batch->friction[i]), scale));
+		_mm_storeu_ps(&batch->movX[i], _mm_mul_ps(vx, damp));
+		_mm_storeu_ps(&batch->movY[i], _mm_mul_ps(vy, damp));
+	}
+	integrate_tail(batch, i, count);
+}
+#endif
+
+#if defined(MATCH_AVX2)
+/**
+ * Steps movers eight at a time, the same way integrate_tail does. Only called on CPUs
+ * that have AVX2.
+ *
+ * @param batch 	The batch.
+ * @param first 	The first mover to step.
+ * @param count 	The number of movers.
+ *
+ * @designer
+ * @author
+ */
+__attribute__((target("avx2")))
+static void integrate_run_avx2(MoverBatch *batch, unsigned int first, unsigned int count) {
+	const __m256 scale = _mm256_set1_ps((float)STEP_SCALE);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256 vx, vy, fx, fy, top, speed, clamp, damp;
+	unsigned int i;
+	
+	for (i = first; i + 8 <= count; i += 8) {
+		fx = _mm256_loadu_ps(&batch->forceX[i]);
+		fy = _mm256_loadu_ps(&batch->forceY[i]);
+		top = _mm256_loadu_ps(&batch->maxSpeed[i]);
+		vx = _mm256_add_ps(_mm256_loadu_ps(&batch->movX[i]), fx);
+		vy = _mm256_add_ps(_mm256_loadu_ps(&batch->movY[i]), fy);
+		
+		speed = _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy));
+		clamp = _mm256_and_ps(_mm256_or_ps(_mm256_cmp_ps(fx, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(fy, zero, _CMP_NEQ_UQ)),
+			_mm256_cmp_ps(speed, _mm256_mul_ps(top, top), _CMP_GT_OQ));
+		speed = _mm256_blendv_ps(one, _mm256_div_ps(top, _mm256_sqrt_ps(speed)), clamp);
+		vx = _mm256_mul_ps(vx, speed);
+		vy = _mm256_mul_ps(vy, speed);
+		
+		_mm256_storeu_ps(&batch->dx[i], _mm256_mul_ps(vx, scale));
+		_mm256_storeu_ps(&batch->dy[i], _mm256_mul_ps(vy, scale));
+		
+		damp = _mm256_sub_ps(one, _mm256_mul_ps(_mm256_loadu_ps(&batch->friction[i]), scale));
+		_mm256_storeu_ps(&batch->movX[i], _mm256_mul_ps(vx, damp));
+		_mm256_storeu_ps(&batch->movY[i], _mm256_mul_ps(vy, damp));
+	}
+	//the tail is plain SSE code, which stalls if the upper halves are left dirty
+	_mm256_zeroupper();
+	integrate_tail(batch, i, count);
+}
+#endif
+
+/**
+ * Picks the widest integrator the CPU can run.
+ *
+ * @return The integrator to use.
+ *
+ * @designer
+ * @author
+ */
+static IntegrateRun pick_integrate_run() {
+#if defined(MATCH_AVX2)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return integrate_run_avx2;
 	}
+#endif
+#if defined(MATCH_SSE2)
+	return integrate_run_sse2;
+#else
+	return integrate_tail;
+#endif
 }
 
+/**
+ * Steps every mover in the integrator batch, several at a time: adds each mover's
+ * push to its velocity, holds pushed movers to their top speed, fills in the step's
+ * move and slows each mover by its friction. Collisions are left to the caller, which
+ * sweeps each move and stops the velocity on whatever axis it hit.
+ *
+ * @param batch 	The batch from reserve_movers, filled in by the caller.
+ *
+ * @designer
+ * @author
+ */
+void integrate_movers(MoverBatch *batch) {
+	static IntegrateRun integrate_run = NULL;
+	
+	if (integrate_run == NULL) {
+		integrate_run = pick_integrate_run();
+	}
+	integrate_run(batch, 0, batch->count);
+}
 
+/**
+ * Finds the level of a floor.
+ *
+ * @param world The world struct.
+ * @param floor The floor ID.
+ *
+ * @return The floor's level, or NULL if the floor isn't loaded.
+ *
+ * @designer
+ * @author
+ */
+LevelComponent *find_level(World *world, int floor) {
+	
+	if (floor < 0 || floor >= MAX_LEVELS || world->levels[floor] == MAX_ENTITIES) {
+		return NULL;
+	}
+	
+	return &(world->level[world->levels[floor]]);
+}
 
+/**
+ * Gives a level a new floor ID and moves it in the level registry.
+ *
+ * @param world 	The world struct.
+ * @param entity 	The level entity.
+ * @param floor 	The new floor ID.
+ *
+ * @designer
+ * @author
+ */
+void set_level_floor(World *world, unsigned int entity, int floor) {
+	LevelComponent *level = &(world->level[entity]);
+	
+	if (floor < 0 || floor >= MAX_LEVELS) {
+		printf("Floor %d is outside the level registry.\n", floor);
+		return;
+	}
+	
+	if (world->levels[level->levelID] == entity) {
+		world->levels[level->levelID] = MAX_ENTITIES;
+	}
+	level->levelID = floor;
+	world->levels[floor] = entity;
+}
 
-void disable_component(World *world, unsigned int entity, unsigned int component) {
+/**
+ * Puts a structural change on the end of the command buffer.
+ *
+ * @param world 		The world struct containing all entities.
+ * @param type 			One of the WORLD_CMD_ values.
+ * @param entity 		The entity to change.
+ * @param components 	The components to create, enable or disable.
+ *
+ * @return false if the buffer couldn't grow, in which case the caller should make the change now.
+ *
+ * @designer
+ * @author
+ */
+static bool queue_command(World *world, int type, unsigned int entity, ComponentMask components) {
+	CommandBuffer *buffer = &world->commands;
+	WorldCommand *grown;
+	unsigned int size;
+	
+	if (buffer->count == buffer->size) {
+		size = buffer->size ? buffer->size * 2 : 64;
+		grown = (WorldCommand*)realloc(buffer->commands, sizeof(WorldCommand) * size);
+		if (grown == NULL) {
+			perror("queue_command: realloc");
+			return false;
+		}
+		buffer->commands = grown;
+		buffer->size = size;
+	}
 	
-	if (IN_THIS_COMPONENT(world->mask[entity], component)) {
-		world->mask[entity] ^= component;
+	buffer->commands[buffer->count].type = type;
+	buffer->commands[buffer->count].entity = entity_handle(world, entity);
+	buffer->commands[buffer->count].components = components;
+	buffer->count++;
+	return true;
+}
+
+/**
+ * Destroys an entity at the sync point. Does nothing if the entity is gone by then.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param entity 	The entity to destroy.
+ *
+ * @designer
+ * @author
+ */
+void defer_destroy(World *world, unsigned int entity) {
+	if (entity >= world->capacity) {
+		return;
 	}
 	
+	if (!queue_command(world, WORLD_CMD_DESTROY, entity, COMPONENT_EMPTY)) {
+		destroy_entity(world, entity);
+	}
 }
 
-void enable_component(World *world, unsigned int entity, unsigned int component) {
+/**
+ * Adds components to an entity at the sync point. Storage for them is made now so
+ * their data can be filled in straight away.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param entity 	The entity to add the components to.
+ * @param component The components to add.
+ *
+ * @designer
+ * @author
+ */
+void defer_enable(World *world, unsigned int entity, ComponentMask component) {
+	if (entity >= world->capacity) {
+		return;
+	}
+	
+	if (!alloc_components(world, entity >> ENTITY_PAGE_SHIFT, component)) {
+		perror("defer_enable: calloc");
+		return;
+	}
 	
-	if (!IN_THIS_COMPONENT(world->mask[entity], component)) {
-		world->mask[entity] ^= component;
+	if (!queue_command(world, WORLD_CMD_ENABLE, entity, component)) {
+		enable_component(world, entity, component);
+	}
+}
+
+/**
+ * Removes components from an entity at the sync point.
+ *
+ * @param world 	The world struct containing all entities.
+ * @param entity 	The entity to remove the components from.
+ * @param component The components to remove.
+ *
+ * @designer
+ * @author
+ */
+void defer_disable(World *world, unsigned int entity, ComponentMask component) {
+	if (entity >= world->capacity) {
+		return;
 	}
 	
+	if (!queue_command(world, WORLD_CMD_DISABLE, entity, component)) {
+		disable_component(world, entity, component);
+	}
 }
 
+/**
+ * Applies the queued structural changes in the order they were asked for. This is
+ * the sync point; it is called once a frame from the main loop, while no system is
+ * walking the world.
+ *
+ * Commands for entities that were destroyed in the meantime are dropped, and the
+ * pages left empty by the batch of destroys are given back at the end.
+ *
+ * @param world 	The world struct containing all entities.
+ *
+ * @designer
+ * @author
+ */
+void apply_commands(World *world) {
+	CommandBuffer *buffer = &world->commands;
+	WorldCommand *command;
+	unsigned int entity;
+	bool destroyed = false;
+	unsigned int i;
+	
+	for(i = 0; i < buffer->count; i++) {
+		command = &buffer->commands[i];
+		entity = entity_from_handle(world, command->entity);
+		
+		if (entity == MAX_ENTITIES) {
+			continue;
+		}
+		
+		switch(command->type) {
+			case WORLD_CMD_ENABLE:
+				enable_component(world, entity, command->components);
+				break;
+			case WORLD_CMD_DISABLE:
+				disable_component(world, entity, command->components);
+				break;
+			case WORLD_CMD_DESTROY:
+				destroy_entity(world, entity);
+				destroyed = true;
+				break;
+		}
+	}
+	buffer->count = 0;
+	
+	if (destroyed) {
+		release_empty_pages(world);
+	}
+}
@@ -5,20 +5,42 @@
 #include "Network/Packets.h"
 #include "components.h"
 #include "Gameplay/poweruptypes.h"
+#include "arena.h"
 
 #define WIDTH 1280
 #define HEIGHT 768
 
 #define GAME_SPEED 30
 
+//The simulation runs in fixed steps, this many a second, whatever the frame rate.
+#define STEPS_PER_SECOND 60
+#define STEP_MS (1000.0 / STEPS_PER_SECOND)
+#define STEP_SCALE ((double)GAME_SPEED / STEPS_PER_SECOND)	//what GAME_SPEED / fps was at this frame rate
+#define MAX_STEPS_PER_FRAME 5	//a frame that took longer than this many steps drops the rest of the time
+
 //0 is off, 1 is on. Remember to make clean to get it to work.
 #define DISPLAY_CUTSCENES 1
 
 //max FPS
 #define FPS_MAX 120
 
+//Entities live in pages of ENTITY_PAGE_SIZE slots; pages are allocated as the world grows.
+#define ENTITY_PAGE_SHIFT	6
+#define ENTITY_PAGE_SIZE	(1 << ENTITY_PAGE_SHIFT)
+#define ENTITY_PAGE_MASK	(ENTITY_PAGE_SIZE - 1)
+
+//Maximum pages the world can grow to. Must not exceed 64 (one bit per page in World::free_pages).
+#define MAX_ENTITY_PAGES	64
+
 //Maximum entities that will be used.
-#define MAX_ENTITIES 256
+#define MAX_ENTITIES (ENTITY_PAGE_SIZE * MAX_ENTITY_PAGES)
+
+#define MAX_LEVELS 16 /**< Floor IDs the level registry can hold, 0 to MAX_LEVELS - 1. */
+
+//Entity handles hold the entity number in the low bits and the slot's generation in the high bits.
+#define ENTITY_INDEX_BITS	16
+#define ENTITY_INDEX_MASK	((1u << ENTITY_INDEX_BITS) - 1)
+#define INVALID_HANDLE		0xFFFFFFFF
 
 //Maximum string lengths
 #define MAX_STRING 			15
@@ -26,29 +48,196 @@
 
 #define IN_THIS_COMPONENT(mask, x) (((mask) & (x)) == (x))
 
+//A reference to an entity that goes stale once the entity is destroyed.
+typedef unsigned int EntityHandle;
+
+//The components an entity has, one bit per component. 64 bits leaves room for new components.
+typedef unsigned long long ComponentMask;
+
+//Menu and cutscene entities live on their own pages, apart from the gameplay entities.
+//Components only they use are only given storage on those pages, and gameplay pages
+//don't carry them. Entities created with these components go to the UI pages.
+#define UI_ENTITY_COMPONENTS	(COMPONENT_MENU_ITEM | COMPONENT_CUTSCENE)
+#define UI_COMPONENTS			(COMPONENT_MENU_ITEM | COMPONENT_MOUSE | COMPONENT_TEXTFIELD | COMPONENT_BUTTON | COMPONENT_CUTSCENE)
+#define SHARED_COMPONENTS		(COMPONENT_POSITION | COMPONENT_RENDER_PLAYER | COMPONENT_ANIMATION)
+
+//One component array, split into pages so it only takes memory for pages the world has grown into.
+template <typename T>
+struct ComponentPages {
+	T *pages[MAX_ENTITY_PAGES];
+	
+	T &operator[](unsigned int entity) {
+		return pages[entity >> ENTITY_PAGE_SHIFT][entity & ENTITY_PAGE_MASK];
+	}
+};
+
+//The entities that have one component, packed so systems only visit entities that have it.
+//The order of dense changes as entities are removed.
+typedef struct {
+	unsigned int					*dense;		//the entities that have the component
+	unsigned int					count;		//number of entities in dense
+	unsigned int					version;	//bumped every time an entity joins or leaves the set
+	ComponentPages<unsigned int>	index;		//where each entity sits in dense
+} ComponentSet;
+
+#define BODY_GRID_BUCKETS	1024		//buckets in the collider grid, a power of two
+#define BODY_GRID_END		0xFFFFFFFF	//ends a bucket's list of entries
+
+//One body store row sitting in one grid cell.
+typedef struct {
+	unsigned int	row;	//the body store row
+	unsigned int	next;	//the next entry in the bucket, BODY_GRID_END if none
+} BodyGridEntry;
+
+//A uniform grid over the colliders so a query only looks at the bodies near it.
+//Each row is entered in every cell its box touches; cells are hashed together with
+//the floor into a fixed number of buckets, so the grid doesn't depend on map size.
+typedef struct {
+	unsigned int	head[BODY_GRID_BUCKETS];	//first entry in each bucket
+	BodyGridEntry	*entries;
+	unsigned int	unused;		//first entry on the free list
+	unsigned int	size;		//entries allocated
+	int				*cells;		//four per row: the first and last cell it covers across and down
+	unsigned int	*mark;		//per row, the query that last returned it
+	unsigned int	*found;		//the rows the last query returned
+	unsigned int	query;		//bumped for every query
+	bool			complete;	//whether every row is entered; if not, queries look at every row
+} BodyGrid;
+
+//The fields the collision passes read for every collider, packed one array per field
+//in entity order. The components stay the real data: the store is refreshed once a
+//frame by sync_bodies and the movement pass writes moved entities back with update_body.
+//Colliders baked into a floor's static layer (COMPONENT_STATIC) aren't kept here.
+typedef struct {
+	unsigned int	*entity;	//the collider in each row
+	float			*x;
+	float			*y;
+	int				*width;
+	int				*height;
+	int				*level;
+	bool			*active;
+	unsigned int	count;		//rows in use
+	unsigned int	size;		//rows allocated
+	unsigned int	stamp;		//collider set versions the rows were built at
+	bool			built;		//whether the rows have been built at all
+	BodyGrid		grid;		//where the rows are on each floor
+} BodyStore;
+
+//How the x and y of the boxes tested by overlap_boxes are read.
+#define BOX_CENTRE	0	//x and y are the centre, as the movement and action checks read them
+#define BOX_CORNER	1	//x and y are the top left corner, as the tag check reads them
+
+//A box to test colliders against. A collider overlaps it if its left edge is before
+//right, its right edge is past left, its top is above bottom and its bottom is below
+//top. Any margin the check wants is folded into the edges by the caller.
+typedef struct {
+	float	left;
+	float	top;
+	float	right;
+	float	bottom;
+	int		reading;	//BOX_CENTRE or BOX_CORNER
+} OverlapBox;
+
+//The colliders near one box, moving and static together, packed like the body store
+//in entity order so overlap_boxes can test them in one run.
+typedef struct {
+	unsigned int		*entity;
+	int					*type;
+	float				*x;
+	float				*y;
+	int					*width;
+	int					*height;
+	bool				*active;
+	unsigned long long	*hits;		//one bit per collider, set by the last test
+	unsigned int		count;		//colliders gathered
+	unsigned int		size;		//colliders allocated
+} BodyBatch;
+
+//The movers' velocities packed one array per field, so integrate_movers can step
+//several at a time. Lane i is the i'th entity of the movement system's view.
+typedef struct {
+	unsigned int	*entity;
+	float			*movX;
+	float			*movY;
+	float			*forceX;	//the push from input this step
+	float			*forceY;
+	float			*maxSpeed;	//only enforced on lanes that were pushed
+	float			*friction;	//0 for lanes that don't slow down
+	float			*dx;		//the move this step, before collisions
+	float			*dy;
+	unsigned int	count;		//lanes in use
+	unsigned int	size;		//lanes allocated
+} MoverBatch;
+
+//Kinds of structural change that can be put off until the sync point.
+#define WORLD_CMD_DESTROY	0
+#define WORLD_CMD_ENABLE	1
+#define WORLD_CMD_DISABLE	2
+
+//One structural change a system asked for while it was walking the world.
+typedef struct {
+	int				type;		//one of the WORLD_CMD_ values
+	EntityHandle	entity;		//the command is dropped if the entity is gone by the sync point
+	ComponentMask	components;	//for create, enable and disable
+} WorldCommand;
+
+//The structural changes queued this frame, applied in order by apply_commands.
+typedef struct {
+	WorldCommand	*commands;
+	unsigned int	count;		//commands queued
+	unsigned int	size;		//commands allocated
+} CommandBuffer;
+
 //This contains all of the entities' components and their respective component masks.
+//Only entities below capacity may be accessed, and only components an entity has.
 typedef struct {
-	unsigned int 			mask[MAX_ENTITIES];
-	PositionComponent		position[MAX_ENTITIES];
-	CommandComponent		command[MAX_ENTITIES];
-	MovementComponent		movement[MAX_ENTITIES];
-	CollisionComponent		collision[MAX_ENTITIES];
-	ControllableComponent	controllable[MAX_ENTITIES];
-	LevelComponent			level[MAX_ENTITIES];
-	MouseComponent			mouse[MAX_ENTITIES];
-	TextFieldComponent		text[MAX_ENTITIES];
-	ButtonComponent			button[MAX_ENTITIES];
-	RenderPlayerComponent	renderPlayer[MAX_ENTITIES];
-	PlayerComponent			player[MAX_ENTITIES];
-	TagComponent			tag[MAX_ENTITIES];
-	AnimationComponent		animation[MAX_ENTITIES];
-	WormholeComponent		wormhole[MAX_ENTITIES];
-	ObjectiveComponent		objective[MAX_ENTITIES];
-	TileComponent			tile[MAX_ENTITIES];
-	CutsceneComponent		cutscene[MAX_ENTITIES];
-	PowerUpComponent		powerup[MAX_ENTITIES];
+	ComponentPages<ComponentMask>			mask;
+	ComponentPages<PositionComponent>		position;
+	ComponentPages<CommandComponent>		command;
+	ComponentPages<MovementComponent>		movement;
+	ComponentPages<CollisionComponent>		collision;
+	ComponentPages<ControllableComponent>	controllable;
+	ComponentPages<LevelComponent>			level;
+	ComponentPages<MouseComponent>			mouse;
+	ComponentPages<TextFieldComponent>		text;
+	ComponentPages<ButtonComponent>			button;
+	ComponentPages<RenderPlayerComponent>	renderPlayer;
+	ComponentPages<PlayerComponent>			player;
+	ComponentPages<TagComponent>			tag;
+	ComponentPages<AnimationComponent>		animation;
+	ComponentPages<WormholeComponent>		wormhole;
+	ComponentPages<ObjectiveComponent>		objective;
+	ComponentPages<TileComponent>			tile;
+	ComponentPages<CutsceneComponent>		cutscene;
+	ComponentPages<PowerUpComponent>		powerup;
+
+	ComponentSet			sets[NUM_COMPONENTS];		//one set per component bit, kept in step with mask
+
+	ComponentPages<unsigned int>			generation;	//bumped each time the slot is freed; never released
+	unsigned long long		free_slots[MAX_ENTITY_PAGES];	//a set bit marks a free entity slot
+	unsigned long long		free_pages;					//a set bit marks an allocated page with a free slot
+	unsigned long long		ui_pages;					//a set bit marks a page that holds menu and cutscene entities
+	unsigned int			num_pages;					//pages currently allocated
+	unsigned int			capacity;					//num_pages * ENTITY_PAGE_SIZE
+
+	BodyStore				bodies;						//packed copy of the colliders' hot fields
+	BodyBatch				batch;						//the colliders gathered for the last overlap test
+	MoverBatch				integrator;					//the movers' velocities for the current step
+	unsigned int			levels[MAX_LEVELS];			//the level entity of each floor ID, MAX_ENTITIES if none
+	CommandBuffer			commands;					//structural changes waiting for the sync point
+	Arena					floor_arena;				//the current floor's allocations, released when it is torn down
 } World;
 
+//The entities a view matched the last time it was built. Rebuilt only when one of
+//the sets in the view's mask has changed since.
+typedef struct {
+	World			*world;		//the world the list was built from
+	unsigned int	stamp;		//sum of the set versions the list was built at
+	unsigned int	*entities;	//the matching entities in entity order
+	unsigned int	count;		//number of entities in the list
+	unsigned int	size;		//number of entities the list can hold
+} ViewCache;
+
 class FPS {
 private:
 	float max_frame_ticks;
@@ -115,9 +304,11 @@ public:
 };
 
 void init_world(World* world);
-unsigned int create_entity(World* world, unsigned int attributes);
+void cleanup_world(World* world);
+unsigned int create_entity(World* world, ComponentMask attributes);
+unsigned int create_ui_entity(World* world, ComponentMask attributes);
 unsigned int create_player(World* world, int x, int y, bool controllable, int collisiontype, int playerNo, PKT_GAME_STATUS *status_update);
-unsigned int create_level(World* world, int** map, int width, int height, int tileSize, int floor);
+unsigned int create_level(World* world, const int* map, int width, int height, int tileSize, int floor);
 unsigned int create_stair(World* world, int targetLevel, int targetX, int targetY, int x, int y, int width, int height, int level);
 unsigned int create_objective(World* world, float x, float y, int w, int h, int id, int level);
 unsigned int create_block(World* world, int x, int y, int width, int height, int level);
@@ -126,7 +317,38 @@ void destroy_entity(World* world, const unsigned int entity);
 void destroy_world(World *world);
 void destroy_world_not_player(World *world);
 
-void disable_component(World *world, unsigned int entity, unsigned int component);
-void enable_component(World *world, unsigned int entity, unsigned int component);
+LevelComponent *find_level(World *world, int floor);
+void set_level_floor(World *world, unsigned int entity, int floor);
+
+EntityHandle entity_handle(World *world, unsigned int entity);
+unsigned int entity_from_handle(World *world, EntityHandle handle);
+
+void disable_component(World *world, unsigned int entity, ComponentMask component);
+bool enable_component(World *world, unsigned int entity, ComponentMask component);
+
+void defer_destroy(World *world, unsigned int entity);
+void defer_enable(World *world, unsigned int entity, ComponentMask component);
+void defer_disable(World *world, unsigned int entity, ComponentMask component);
+void apply_commands(World *world);
+
+ComponentSet *component_set(World *world, ComponentMask component);
+ComponentSet *smallest_set(World *world, ComponentMask mask);
+unsigned int match_all(World *world, ComponentMask required, ComponentMask excluded, unsigned long long *matches);
+unsigned int collect_entities(World *world, ComponentMask mask, unsigned int *entities);
+void refresh_view(World *world, ComponentMask mask, ViewCache *cache);
+
+void sync_bodies(World *world);
+BodyStore *collider_bodies(World *world);
+void update_body(World *world, unsigned int entity);
+unsigned int query_bodies_box(World *world, float left, float top, float right, float bottom, int level, unsigned int **rows);
+unsigned int query_bodies_radius(World *world, float x, float y, float radius, int level, unsigned int **rows);
+void bake_static_colliders(World *world, int floor);
+unsigned int query_static_box(World *world, float left, float top, float right, float bottom, int level, unsigned int **entities, int **types);
+BodyBatch *gather_colliders(World *world, float left, float top, float right, float bottom, int level);
+unsigned int overlap_boxes(const OverlapBox *box, const float *x, const float *y, const int *width, const int *height, const bool *active, unsigned int count, unsigned long long *hits);
+unsigned int overlap_batch(BodyBatch *batch, const OverlapBox *box);
+unsigned int scan_colliders(World *world, const OverlapBox *box, int level, unsigned int from, int *type);
+MoverBatch *reserve_movers(World *world, unsigned int count);
+void integrate_movers(MoverBatch *batch);
 
 #endif